@@ -0,0 +1,352 @@
+#include "annotations.h"
+#include <string.h>
+
+// Generated Annotation Tracking
+struct Annotation __ANNOTATIONS[98] = {
+    {"Setup", setup_counter, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "setup_counter", "./tests/simple.c"},
+    {"Teardown", teardown_counter, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "teardown_counter", "./tests/simple.c"},
+    {"NotThreadSafe", test_string_equality, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_string_equality", "./tests/simple.c"},
+#ifdef TARGET_TEST
+    {"Test", test_string_equality, "function", 0, {"Test string equality", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_equality", "./tests/simple.c"},
+#else
+    {"Test", NULL, "function", 1, {"Test string equality", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_equality", "./tests/simple.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_arithmetic, "function", 0, {"Test basic arithmetic", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_arithmetic", "./tests/simple.c"},
+#else
+    {"Test", NULL, "function", 1, {"Test basic arithmetic", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_arithmetic", "./tests/simple.c"},
+#endif
+    {"NotThreadSafe", test_setup_teardown_counts, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_setup_teardown_counts", "./tests/simple.c"},
+#ifdef TARGET_TEST
+    {"Test", test_setup_teardown_counts, "function", 0, {"Verify setup and teardown counts", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_setup_teardown_counts", "./tests/simple.c"},
+#else
+    {"Test", NULL, "function", 1, {"Verify setup and teardown counts", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_setup_teardown_counts", "./tests/simple.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_string_equality_both_null, "function", 0, {"Test string equality with both null", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_equality_both_null", "./tests/simple.c"},
+#else
+    {"Test", NULL, "function", 1, {"Test string equality with both null", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_equality_both_null", "./tests/simple.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_string_equality_expected_null, "function", 0, {"Test string equality with expected null fails", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_equality_expected_null", "./tests/simple.c"},
+#else
+    {"Test", NULL, "function", 1, {"Test string equality with expected null fails", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_equality_expected_null", "./tests/simple.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_string_equality_actual_null, "function", 0, {"Test string equality with actual null fails", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_equality_actual_null", "./tests/simple.c"},
+#else
+    {"Test", NULL, "function", 1, {"Test string equality with actual null fails", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_equality_actual_null", "./tests/simple.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_string_equality_non_null, "function", 0, {"Test string equality with non-null strings", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_equality_non_null", "./tests/simple.c"},
+#else
+    {"Test", NULL, "function", 1, {"Test string equality with non-null strings", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_equality_non_null", "./tests/simple.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_string_inequality_both_null, "function", 0, {"Test string inequality with both null fails", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_inequality_both_null", "./tests/simple.c"},
+#else
+    {"Test", NULL, "function", 1, {"Test string inequality with both null fails", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_inequality_both_null", "./tests/simple.c"},
+#endif
+    {"BeforeAll", complex_before_all, "function", 0, {"file", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "complex_before_all", "./tests/complex.c"},
+    {"AfterAll", complex_after_all, "function", 0, {"file", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "complex_after_all", "./tests/complex.c"},
+#ifdef TARGET_TEST
+    {"Test", test_file_before_all, "function", 0, {"File BeforeAll runs once before the tests of its file", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_file_before_all", "./tests/complex.c"},
+#else
+    {"Test", NULL, "function", 1, {"File BeforeAll runs once before the tests of its file", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_file_before_all", "./tests/complex.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_string_inequality, "function", 0, {"Test string inequality", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_inequality", "./tests/complex.c"},
+#else
+    {"Test", NULL, "function", 1, {"Test string inequality", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_string_inequality", "./tests/complex.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_false_condition, "function", 0, {"Test false condition", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_false_condition", "./tests/complex.c"},
+#else
+    {"Test", NULL, "function", 1, {"Test false condition", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_false_condition", "./tests/complex.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_pointer_comparison, "function", 0, {"Test pointer comparison", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_pointer_comparison", "./tests/complex.c"},
+#else
+    {"Test", NULL, "function", 1, {"Test pointer comparison", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_pointer_comparison", "./tests/complex.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_extract_simple_annotation, "function", 0, {"Extract simple annotation name", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_simple_annotation", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Extract simple annotation name", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_simple_annotation", "./tests/lucy_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_extract_annotation_with_args, "function", 0, {"Extract annotation with arguments", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_annotation_with_args", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Extract annotation with arguments", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_annotation_with_args", "./tests/lucy_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Benchmark", bench_extract_annotation_name, "function", 0, {"Extract annotation name and arguments", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "bench_extract_annotation_name", "./tests/lucy_tests.c"},
+#else
+    {"Benchmark", NULL, "function", 1, {"Extract annotation name and arguments", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "bench_extract_annotation_name", "./tests/lucy_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_extract_annotation_missing_paren, "function", 0, {"Extract annotation with missing closing parenthesis", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_annotation_missing_paren", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Extract annotation with missing closing parenthesis", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_annotation_missing_paren", "./tests/lucy_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_extract_annotation_with_whitespace, "function", 0, {"Extract annotation with whitespace", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_annotation_with_whitespace", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Extract annotation with whitespace", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_annotation_with_whitespace", "./tests/lucy_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_extract_extension, "function", 0, {"Extract extension definition", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_extension", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Extract extension definition", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_extension", "./tests/lucy_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_extract_extension_no_base, "function", 0, {"Extract malformed extension - no base", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_extension_no_base", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Extract malformed extension - no base", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_extract_extension_no_base", "./tests/lucy_tests.c"},
+#endif
+    {"NotThreadSafe", test_lucy_init, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_lucy_init", "./tests/lucy_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_lucy_init, "function", 0, {"lucy_init resets state", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_init", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"lucy_init resets state", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_init", "./tests/lucy_tests.c"},
+#endif
+    {"NotThreadSafe", test_lucy_process_file_when, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_lucy_process_file_when", "./tests/lucy_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_lucy_process_file_when, "function", 0, {"lucy_process_file with @When", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_process_file_when", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"lucy_process_file with @When", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_process_file_when", "./tests/lucy_tests.c"},
+#endif
+    {"NotThreadSafe", test_lucy_process_file_extension, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_lucy_process_file_extension", "./tests/lucy_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_lucy_process_file_extension, "function", 0, {"lucy_process_file with extension", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_process_file_extension", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"lucy_process_file with extension", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_process_file_extension", "./tests/lucy_tests.c"},
+#endif
+    {"NotThreadSafe", test_lucy_generate_annotations_header, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_lucy_generate_annotations_header", "./tests/lucy_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_lucy_generate_annotations_header, "function", 0, {"lucy_generate_annotations_header", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_generate_annotations_header", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"lucy_generate_annotations_header", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_generate_annotations_header", "./tests/lucy_tests.c"},
+#endif
+    {"NotThreadSafe", test_lucy_generate_annotations_source, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_lucy_generate_annotations_source", "./tests/lucy_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_lucy_generate_annotations_source, "function", 0, {"lucy_generate_annotations_source", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_generate_annotations_source", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"lucy_generate_annotations_source", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_generate_annotations_source", "./tests/lucy_tests.c"},
+#endif
+    {"NotThreadSafe", test_lucy_generate_tag_index, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_lucy_generate_tag_index", "./tests/lucy_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_lucy_generate_tag_index, "function", 0, {"lucy_generate_annotations_source emits per-tag index lists", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_generate_tag_index", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"lucy_generate_annotations_source emits per-tag index lists", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_generate_tag_index", "./tests/lucy_tests.c"},
+#endif
+    {"NotThreadSafe", test_find_annotated_blocks, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_find_annotated_blocks", "./tests/lucy_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_find_annotated_blocks, "function", 0, {"find_annotated_blocks finds runtime annotations", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_find_annotated_blocks", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"find_annotated_blocks finds runtime annotations", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_find_annotated_blocks", "./tests/lucy_tests.c"},
+#endif
+    {"NotThreadSafe", test_lucy_cleanup, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_lucy_cleanup", "./tests/lucy_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_lucy_cleanup, "function", 0, {"lucy_cleanup resets state", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_cleanup", "./tests/lucy_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"lucy_cleanup resets state", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_lucy_cleanup", "./tests/lucy_tests.c"},
+#endif
+    {"BeforeAll", test_before_all, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_before_all", "./tests/lucy-test_tests.c"},
+    {"AfterAll", test_after_all, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_after_all", "./tests/lucy-test_tests.c"},
+    {"Setup", test_setup, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_setup", "./tests/lucy-test_tests.c"},
+    {"Teardown", test_teardown, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_teardown", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_basic_test, "function", 0, {"Basic test runs", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_basic_test", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Basic test runs", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_basic_test", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_setup_runs, "function", 0, {"Setup runs before test", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_setup_runs", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Setup runs before test", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_setup_runs", "./tests/lucy-test_tests.c"},
+#endif
+    {"NotThreadSafe", test_teardown_runs, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_teardown_runs", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_teardown_runs, "function", 0, {"Teardown runs after test", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_teardown_runs", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Teardown runs after test", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_teardown_runs", "./tests/lucy-test_tests.c"},
+#endif
+    {"NotThreadSafe", test_multiple_tests, "function", 0, {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 0, NULL, "test_multiple_tests", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_multiple_tests, "function", 0, {"Multiple tests increment counts", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_multiple_tests", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Multiple tests increment counts", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_multiple_tests", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_before_all_runs_once, "function", 0, {"BeforeAll runs once before any test", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_before_all_runs_once", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"BeforeAll runs once before any test", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_before_all_runs_once", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_disabled_not_run, "function", 0, {"Disabled test not run - manual check", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_disabled_not_run", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Disabled test not run - manual check", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_disabled_not_run", "./tests/lucy-test_tests.c"},
+#endif
+    {"Disable", test_disabled, "function", 0, {"Demonstration", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_disabled", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_disabled, "function", 0, {"Disabled test", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_disabled", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Disabled test", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_disabled", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_timings_round_trip, "function", 0, {"Timings cache round-trips through a file", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_timings_round_trip", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Timings cache round-trips through a file", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_timings_round_trip", "./tests/lucy-test_tests.c"},
+#endif
+    {"Tag", test_timings_round_trip, "function", 0, {"fast", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_timings_round_trip", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_timings_failed_flag, "function", 0, {"Timings cache remembers which tests failed last", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_timings_failed_flag", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Timings cache remembers which tests failed last", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_timings_failed_flag", "./tests/lucy-test_tests.c"},
+#endif
+    {"Covers", test_timings_failed_flag, "function", 0, {"src/lucy_test_timings.c", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_timings_failed_flag", "./tests/lucy-test_tests.c"},
+    {"Tag", test_timings_failed_flag, "function", 0, {"fast", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_timings_failed_flag", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_table_load_module, "function", 0, {"Module tables merge with rebased tag indices", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_table_load_module", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Module tables merge with rebased tag indices", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_table_load_module", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_schedule_failed_first, "function", 0, {"Longest-first schedule runs last failures before slow tests", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_schedule_failed_first", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Longest-first schedule runs last failures before slow tests", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_schedule_failed_first", "./tests/lucy-test_tests.c"},
+#endif
+    {"Tag", test_schedule_failed_first, "function", 0, {"fast", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_schedule_failed_first", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_schedule_longest_first, "function", 0, {"Longest-first schedule puts unknown and slow tests first", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_schedule_longest_first", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Longest-first schedule puts unknown and slow tests first", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_schedule_longest_first", "./tests/lucy-test_tests.c"},
+#endif
+    {"Tag", test_schedule_longest_first, "function", 0, {"fast", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_schedule_longest_first", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_report_jsonl, "function", 0, {"JSONL report streams escaped test records and a summary", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_report_jsonl", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"JSONL report streams escaped test records and a summary", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_report_jsonl", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_bench_stats, "function", 0, {"Benchmark stats report median and MAD and p99", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_bench_stats", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Benchmark stats report median and MAD and p99", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_bench_stats", "./tests/lucy-test_tests.c"},
+#endif
+    {"Tag", test_bench_stats, "function", 0, {"fast", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_bench_stats", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_perf_counters, "function", 0, {"Perf counters measure work or degrade to unavailable", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_perf_counters", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Perf counters measure work or degrade to unavailable", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_perf_counters", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_profile_folded_stacks, "function", 0, {"Profiler writes folded stacks naming the sampled function", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_profile_folded_stacks", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Profiler writes folded stacks naming the sampled function", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_profile_folded_stacks", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_alloc_stats, "function", 0, {"Allocation stats count calls and bytes and peak live bytes", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_alloc_stats", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Allocation stats count calls and bytes and peak live bytes", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_alloc_stats", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_alloc_stats_aligned, "function", 0, {"Aligned allocations are counted like malloc", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_alloc_stats_aligned", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Aligned allocations are counted like malloc", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_alloc_stats_aligned", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_zero_alloc_budget, "function", 0, {"Allocation-free code passes a zero budget", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_zero_alloc_budget", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Allocation-free code passes a zero budget", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_zero_alloc_budget", "./tests/lucy-test_tests.c"},
+#endif
+    {"MaxAllocs", test_zero_alloc_budget, "function", 0, {"0", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_zero_alloc_budget", "./tests/lucy-test_tests.c"},
+    {"MaxBytes", test_zero_alloc_budget, "function", 0, {"0", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_zero_alloc_budget", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_watchdog_timeout, "function", 0, {"Watchdog aborts a hung function and lets a quick one finish", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_watchdog_timeout", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Watchdog aborts a hung function and lets a quick one finish", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_watchdog_timeout", "./tests/lucy-test_tests.c"},
+#endif
+    {"Timeout", test_watchdog_timeout, "function", 0, {"5000", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_watchdog_timeout", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_watchdog_nested, "function", 0, {"Nested watchdog keeps the outer limit in force", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_watchdog_nested", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Nested watchdog keeps the outer limit in force", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_watchdog_nested", "./tests/lucy-test_tests.c"},
+#endif
+    {"Timeout", test_watchdog_nested, "function", 0, {"5000", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_watchdog_nested", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_shard_assign, "function", 0, {"Shards partition tests deterministically by hash and by duration", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_shard_assign", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Shards partition tests deterministically by hash and by duration", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_shard_assign", "./tests/lucy-test_tests.c"},
+#endif
+    {"Tag", test_shard_assign, "function", 0, {"fast", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_shard_assign", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_report_merge, "function", 0, {"Merging shard reports concatenates records and sums the summaries", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_report_merge", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Merging shard reports concatenates records and sums the summaries", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_report_merge", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_pool_output_one, "function", 0, {"Pool output one", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_pool_output_one", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Pool output one", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_pool_output_one", "./tests/lucy-test_tests.c"},
+#endif
+    {"Tag", test_pool_output_one, "function", 0, {"pool-output", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_pool_output_one", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_pool_output_two, "function", 0, {"Pool output two", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_pool_output_two", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Pool output two", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_pool_output_two", "./tests/lucy-test_tests.c"},
+#endif
+    {"Tag", test_pool_output_two, "function", 0, {"pool-output", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_pool_output_two", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_pool_output_three, "function", 0, {"Pool output three", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_pool_output_three", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Pool output three", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_pool_output_three", "./tests/lucy-test_tests.c"},
+#endif
+    {"Tag", test_pool_output_three, "function", 0, {"pool-output", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_pool_output_three", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_pool_output_passes, "function", 0, {"Pool output passes", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_pool_output_passes", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Pool output passes", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_pool_output_passes", "./tests/lucy-test_tests.c"},
+#endif
+    {"Tag", test_pool_output_passes, "function", 0, {"pool-output", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_pool_output_passes", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_thread_pool_output_attribution, "function", 0, {"Thread pool keeps each test's failures on its own result line and report record", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_thread_pool_output_attribution", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Thread pool keeps each test's failures on its own result line and report record", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_thread_pool_output_attribution", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_before_all_failure_reported, "function", 0, {"A failing @BeforeAll reports every test it skipped", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_before_all_failure_reported", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"A failing @BeforeAll reports every test it skipped", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_before_all_failure_reported", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_file_before_all_failure_reported, "function", 0, {"A failing file @BeforeAll reports the tests of its file", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_file_before_all_failure_reported", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"A failing file @BeforeAll reports the tests of its file", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_file_before_all_failure_reported", "./tests/lucy-test_tests.c"},
+#endif
+#ifdef TARGET_TEST
+    {"Test", test_budgeted_failure, "function", 0, {"Budgeted failure", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_budgeted_failure", "./tests/lucy-test_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Budgeted failure", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_budgeted_failure", "./tests/lucy-test_tests.c"},
+#endif
+    {"Tag", test_budgeted_failure, "function", 0, {"budget-failure", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_budgeted_failure", "./tests/lucy-test_tests.c"},
+    {"MaxAllocs", test_budgeted_failure, "function", 0, {"0", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_budgeted_failure", "./tests/lucy-test_tests.c"},
+    {"MaxBytes", test_budgeted_failure, "function", 0, {"0", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_budgeted_failure", "./tests/lucy-test_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_failure_outside_alloc_budget, "function", 0, {"Recording a failure does not count against the test's allocation budget", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_failure_outside_alloc_budget", "./tests/lucy-test_tests.c"}
+#else
+    {"Test", NULL, "function", 1, {"Recording a failure does not count against the test's allocation budget", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_failure_outside_alloc_budget", "./tests/lucy-test_tests.c"}
+#endif
+};
+int __ANNOTATION_COUNT = 98;
+
+// Generated Tag Index
+static const int __TAG_0[] = {55, 57, 58, 61, 63, 66, 79};
+static const int __TAG_1[] = {82, 84, 86, 88};
+static const int __TAG_2[] = {93, 95, 96};
+struct TagIndex __TAGS[3] = {
+    {"fast", __TAG_0, 7},
+    {"pool-output", __TAG_1, 4},
+    {"budget-failure", __TAG_2, 3}
+};
+int __TAG_COUNT = 3;
@@ -0,0 +1,116 @@
+#ifndef ANNOTATIONS_H
+#define ANNOTATIONS_H
+
+#include "lucy.h"
+
+// User-defined Annotation Extensions
+// #annotation @Test(condition, description) : @When(condition)
+// #annotation @Benchmark(description) : @When(TARGET_TEST)
+
+// Function Declarations
+extern void setup_counter(void);
+extern void teardown_counter(void);
+extern void test_string_equality(void);
+extern void test_string_equality(void);
+extern void test_arithmetic(void);
+extern void test_setup_teardown_counts(void);
+extern void test_setup_teardown_counts(void);
+extern void test_string_equality_both_null(void);
+extern void test_string_equality_expected_null(void);
+extern void test_string_equality_actual_null(void);
+extern void test_string_equality_non_null(void);
+extern void test_string_inequality_both_null(void);
+extern void complex_before_all(void);
+extern void complex_after_all(void);
+extern void test_file_before_all(void);
+extern void test_string_inequality(void);
+extern void test_false_condition(void);
+extern void test_pointer_comparison(void);
+extern void test_extract_simple_annotation(void);
+extern void test_extract_annotation_with_args(void);
+extern void bench_extract_annotation_name(void);
+extern void test_extract_annotation_missing_paren(void);
+extern void test_extract_annotation_with_whitespace(void);
+extern void test_extract_extension(void);
+extern void test_extract_extension_no_base(void);
+extern void test_lucy_init(void);
+extern void test_lucy_init(void);
+extern void test_lucy_process_file_when(void);
+extern void test_lucy_process_file_when(void);
+extern void test_lucy_process_file_extension(void);
+extern void test_lucy_process_file_extension(void);
+extern void test_lucy_generate_annotations_header(void);
+extern void test_lucy_generate_annotations_header(void);
+extern void test_lucy_generate_annotations_source(void);
+extern void test_lucy_generate_annotations_source(void);
+extern void test_lucy_generate_tag_index(void);
+extern void test_lucy_generate_tag_index(void);
+extern void test_find_annotated_blocks(void);
+extern void test_find_annotated_blocks(void);
+extern void test_lucy_cleanup(void);
+extern void test_lucy_cleanup(void);
+extern void test_before_all(void);
+extern void test_after_all(void);
+extern void test_setup(void);
+extern void test_teardown(void);
+extern void test_basic_test(void);
+extern void test_setup_runs(void);
+extern void test_teardown_runs(void);
+extern void test_teardown_runs(void);
+extern void test_multiple_tests(void);
+extern void test_multiple_tests(void);
+extern void test_before_all_runs_once(void);
+extern void test_disabled_not_run(void);
+extern void test_disabled(void);
+extern void test_disabled(void);
+extern void test_timings_round_trip(void);
+extern void test_timings_round_trip(void);
+extern void test_timings_failed_flag(void);
+extern void test_timings_failed_flag(void);
+extern void test_timings_failed_flag(void);
+extern void test_table_load_module(void);
+extern void test_schedule_failed_first(void);
+extern void test_schedule_failed_first(void);
+extern void test_schedule_longest_first(void);
+extern void test_schedule_longest_first(void);
+extern void test_report_jsonl(void);
+extern void test_bench_stats(void);
+extern void test_bench_stats(void);
+extern void test_perf_counters(void);
+extern void test_profile_folded_stacks(void);
+extern void test_alloc_stats(void);
+extern void test_alloc_stats_aligned(void);
+extern void test_zero_alloc_budget(void);
+extern void test_zero_alloc_budget(void);
+extern void test_zero_alloc_budget(void);
+extern void test_watchdog_timeout(void);
+extern void test_watchdog_timeout(void);
+extern void test_watchdog_nested(void);
+extern void test_watchdog_nested(void);
+extern void test_shard_assign(void);
+extern void test_shard_assign(void);
+extern void test_report_merge(void);
+extern void test_pool_output_one(void);
+extern void test_pool_output_one(void);
+extern void test_pool_output_two(void);
+extern void test_pool_output_two(void);
+extern void test_pool_output_three(void);
+extern void test_pool_output_three(void);
+extern void test_pool_output_passes(void);
+extern void test_pool_output_passes(void);
+extern void test_thread_pool_output_attribution(void);
+extern void test_before_all_failure_reported(void);
+extern void test_file_before_all_failure_reported(void);
+extern void test_budgeted_failure(void);
+extern void test_budgeted_failure(void);
+extern void test_budgeted_failure(void);
+extern void test_budgeted_failure(void);
+extern void test_failure_outside_alloc_budget(void);
+
+// Annotation Tracking Declarations
+extern struct Annotation __ANNOTATIONS[];
+extern int __ANNOTATION_COUNT;
+extern struct TagIndex __TAGS[];
+extern int __TAG_COUNT;
+extern struct Annotation *find_annotated_blocks(const char *name);
+#endif // ANNOTATIONS_H
@@ -0,0 +1,46 @@
+/* More complex unit tests for lucy annotation processing */
+#include "../include/lucy_test.h"
+#include <string.h>
+
+// File fixture state, built once for the tests in this file only
+static int file_fixture_runs = 0;
+static char *file_fixture = NULL;
+
+void complex_before_all() {
+    file_fixture_runs++;
+    file_fixture = strdup("complex fixture");
+    assertFalse(getenv("LUCY_FAIL_FILE_BEFORE_ALL") != NULL, "file before-all failed on purpose");
+}
+
+void complex_after_all() {
+    free(file_fixture);
+    file_fixture = NULL;
+}
+
+#ifdef TARGET_TEST
+void test_file_before_all() {
+    assertEquals(1, file_fixture_runs, "File BeforeAll should have run exactly once");
+    assertStringEquals("complex fixture", file_fixture, "File fixture should be visible to its tests");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_string_inequality() {
+    assertStringNotEquals("hello", "world", "Strings should not match");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_false_condition() {
+    assertFalse(1 == 2, "One should not equal two");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_pointer_comparison() {
+    int x = 42;
+    int *p = &x;
+    int *q = &x;
+    assertEquals(p, q, "Pointers to same address should match");
+}
+#endif
@@ -0,0 +1,661 @@
+/* Unit tests for lucy-test API functionality */
+#include "../include/lucy_test.h"
+#include "../include/lucy_test_runner.h"
+#include "../include/lucy_api.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Static counters for setup/teardown verification
+static int setup_count = 0;
+static int teardown_count = 0;
+
+// Suite fixture state, built once per run
+static int before_all_count = 0;
+static int *shared_fixture = NULL;
+
+void test_before_all() {
+    before_all_count++;
+    shared_fixture = malloc(16 * sizeof(int));
+    for (int i = 0; i < 16; i++) shared_fixture[i] = i * i;
+    assertFalse(getenv("LUCY_FAIL_BEFORE_ALL") != NULL, "before-all failed on purpose");
+}
+
+void test_after_all() {
+    free(shared_fixture);
+    shared_fixture = NULL;
+}
+
+void test_setup() {
+    setup_count++;
+}
+
+void test_teardown() {
+    teardown_count++;
+}
+
+#ifdef TARGET_TEST
+void test_basic_test() {
+    assertTrue(1, "Basic test should pass");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_setup_runs() {
+    assertTrue(setup_count > 0, "Setup should have run once before this test");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_teardown_runs() {
+    assertTrue(teardown_count < setup_count, "Teardown should not have run yet for this test");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_multiple_tests() {
+    assertTrue(setup_count > 1, "Setup should have run for previous tests");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_before_all_runs_once() {
+    assertEquals(1, before_all_count, "BeforeAll should have run exactly once");
+    assertTrue(shared_fixture != NULL, "Fixture should be built before tests run");
+    assertEquals(49, shared_fixture[7], "Fixture contents should be visible to tests");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_disabled_not_run() {
+    assertTrue(1, "Check disabled tests in output; this should run");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_disabled() {
+    assertTrue(0, "This should not run");
+}
+#endif
+#ifdef TARGET_TEST
+void test_timings_round_trip() {
+    const char *path = "test_timings.txt";
+    TimingCache cache = {0};
+    lucy_timings_record(&cache, "test_slow", 120.5);
+    lucy_timings_record(&cache, "test_fast", 0.25);
+    lucy_timings_record(&cache, "test_slow", 80.0);
+    assertEquals(2, cache.count, "Recording an existing test should replace its entry");
+    assertEquals(0, lucy_timings_save(&cache, path), "Saving the cache should succeed");
+    lucy_timings_free(&cache);
+
+    TimingCache loaded = {0};
+    assertEquals(0, lucy_timings_load(&loaded, path), "Loading the cache should succeed");
+    assertTrue(lucy_timings_lookup(&loaded, "test_slow") == 80.0, "Slow test should keep its latest time");
+    assertTrue(lucy_timings_lookup(&loaded, "test_fast") == 0.25, "Fast test should be cached");
+    assertTrue(lucy_timings_lookup(&loaded, "test_missing") < 0, "Unknown tests should have no history");
+    lucy_timings_free(&loaded);
+    remove(path);
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_timings_failed_flag() {
+    const char *path = "test_timings_failed.txt";
+    TimingCache cache = {0};
+    lucy_timings_record(&cache, "test_broken", 3.0);
+    lucy_timings_set_failed(&cache, "test_broken", 1);
+    lucy_timings_record(&cache, "test_fine", 2.0);
+    lucy_timings_record(&cache, "test_broken", 4.0);
+    assertEquals(1, lucy_timings_failed(&cache, "test_broken"), "Recording a time should keep the failure");
+    assertEquals(0, lucy_timings_save(&cache, path), "Saving the cache should succeed");
+    lucy_timings_free(&cache);
+
+    TimingCache loaded = {0};
+    assertEquals(0, lucy_timings_load(&loaded, path), "Loading the cache should succeed");
+    assertEquals(1, lucy_timings_failed(&loaded, "test_broken"), "Failure should survive a round trip");
+    assertEquals(0, lucy_timings_failed(&loaded, "test_fine"), "Passing tests should not be marked");
+    assertTrue(lucy_timings_lookup(&loaded, "test_broken") == 4.0, "Failed tests should keep their time");
+    lucy_timings_free(&loaded);
+    remove(path);
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_table_load_module() {
+    struct Annotation runner[1] = {0};
+    runner[0].name = "Test";
+    runner[0].target_name = "runner_test";
+    AnnotationTable table;
+    assertEquals(0, lucy_table_init(&table, runner, 1, NULL, 0), "Table should start from the runner's annotations");
+    /* Keep the load error off this test's result line and check what it says */
+    fflush(stderr);
+    FILE *errors = tmpfile();
+    int saved_stderr = dup(STDERR_FILENO);
+    assertTrue(errors != NULL && saved_stderr >= 0, "Stderr should be capturable");
+    if (!errors || saved_stderr < 0) return;
+    dup2(fileno(errors), STDERR_FILENO);
+    int missing = lucy_table_load_module(&table, "missing_module.so");
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    char message[512] = {0};
+    rewind(errors);
+    size_t length = fread(message, 1, sizeof(message) - 1, errors);
+    message[length] = '\0';
+    fclose(errors);
+    assertEquals(1, missing, "A missing module should fail to load");
+    assertTrue(strstr(message, "Cannot load module ./missing_module.so") != NULL,
+               "The load error should name the module");
+    assertEquals(0, lucy_table_load_module(&table, "test_module.so"), "The test module should load");
+    assertEquals(1, table.failed_modules, "Only the missing module should count as failed");
+    assertTrue(table.count > 1, "Module annotations should follow the runner's");
+
+    struct Annotation *tests = lucy_table_find(&table, "Test");
+    assertStringEquals("runner_test", tests[0].target_name, "Runner tests should come first");
+    assertStringEquals("test_module_loaded", tests[1].target_name, "Module tests should follow");
+    free(tests);
+
+    int found = 0;
+    for (int t = 0; t < table.tag_count; t++) {
+        if (strcmp(table.tags[t].tag, "module") != 0) continue;
+        found = 1;
+        const char *target = table.annotations[table.tags[t].annotations[0]].target_name;
+        assertStringEquals("test_module_loaded", target, "Tag indices should point into the merged table");
+    }
+    assertTrue(found, "Module tags should be merged");
+    lucy_table_free(&table);
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_schedule_failed_first() {
+    TestCase cases[3] = {0};
+    cases[0].expected_ms = 50.0;
+    cases[1].expected_ms = 1.0;
+    cases[1].last_failed = 1;
+    cases[2].expected_ms = -1;
+    int order[3];
+    lucy_schedule_longest_first(cases, 3, order);
+    assertEquals(1, order[0], "The last failure should run first");
+    assertEquals(2, order[1], "Tests without history should follow");
+    assertEquals(0, order[2], "Then the slowest test");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_schedule_longest_first() {
+    TestCase cases[5] = {0};
+    cases[0].expected_ms = 1.0;
+    cases[1].expected_ms = 50.0;
+    cases[2].expected_ms = -1;
+    cases[3].expected_ms = 50.0;
+    cases[4].expected_ms = 10.0;
+    int order[5];
+    lucy_schedule_longest_first(cases, 5, order);
+    assertEquals(2, order[0], "Tests without history should run first");
+    assertEquals(1, order[1], "Slowest test should follow");
+    assertEquals(3, order[2], "Ties should keep declaration order");
+    assertEquals(4, order[3], "Medium test should run next");
+    assertEquals(0, order[4], "Fastest test should run last");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_report_jsonl() {
+    const char *path = "test_report.jsonl";
+    Report report;
+    assertEquals(0, lucy_report_open(&report, path), "Opening the report should succeed");
+    assertEquals((int)REPORT_JSONL, (int)report.format, "Non-.xml paths should produce JSON Lines");
+
+    TestCase test = {0};
+    test.description = "Quotes \"here\"";
+    test.target_name = "test_quotes";
+    test.wall_ms = 1.5;
+    test.failed = 1;
+    test.output = "FAIL: line\n";
+    lucy_report_test(&report, &test);
+    lucy_report_close(&report, 0, 1, 0, 2.0);
+
+    FILE *f = fopen(path, "r");
+    char line[MAX_LINE_LENGTH];
+    assertTrue(fgets(line, sizeof(line), f) != NULL, "Should read the test record");
+    assertTrue(strstr(line, "\"name\":\"test_quotes\"") != NULL, "Record should carry target_name");
+    assertTrue(strstr(line, "\"description\":\"Quotes \\\"here\\\"\"") != NULL, "Quotes should be escaped");
+    assertTrue(strstr(line, "\"status\":\"failed\"") != NULL, "Record should carry the status");
+    assertTrue(strstr(line, "\"output\":\"FAIL: line\\n\"") != NULL, "Newlines should be escaped");
+    assertTrue(fgets(line, sizeof(line), f) != NULL, "Should read the summary record");
+    assertTrue(strstr(line, "\"type\":\"summary\"") != NULL, "Summary should close the report");
+    fclose(f);
+    remove(path);
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_bench_stats() {
+    double samples[] = {5.0, 1.0, 3.0, 2.0, 4.0};
+    double median, mad, p99;
+    lucy_bench_stats(samples, 5, &median, &mad, &p99);
+    assertTrue(median == 3.0, "Median of 1..5 should be 3");
+    assertTrue(mad == 1.0, "MAD of 1..5 should be 1");
+    assertTrue(p99 == 5.0, "p99 of five samples should be the maximum");
+    assertTrue(samples[0] == 1.0 && samples[4] == 5.0, "Samples should be sorted in place");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_perf_counters() {
+    PerfCounters perf;
+    PerfCounts counts;
+    int opened = lucy_perf_open(&perf);
+    lucy_perf_start(&perf);
+    volatile int sum = 0;
+    for (int i = 0; i < 100000; i++) sum += i;
+    lucy_perf_stop(&perf, &counts);
+    lucy_perf_close(&perf);
+
+    if (opened == 0) {
+        assertTrue(perf.error != 0, "Refused counters should record errno");
+        assertEquals(0, counts.valid, "No counter should read as valid");
+        assertTrue(counts.values[PERF_CYCLES] == -1, "Unavailable counters should read -1");
+    } else if (counts.values[PERF_INSTRUCTIONS] >= 0) {
+        assertTrue(counts.values[PERF_INSTRUCTIONS] > 100000, "Loop should retire over 100k instructions");
+    }
+    assertStringEquals("l1d_misses", lucy_perf_event_name(PERF_L1D_MISSES), "Event names should match reports");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_profile_folded_stacks() {
+    const char *path = "test_profile.folded";
+    Profiler profiler;
+    assertEquals(0, lucy_profile_init(&profiler, 200), "Profiler should initialize");
+    lucy_profile_start(&profiler);
+    volatile double x = 0;
+    for (long i = 0; i < 20000000 && profiler.count < 20; i++) x += i * 0.5;
+    lucy_profile_stop(&profiler);
+    assertTrue(profiler.count > 0, "CPU-bound loop should be sampled");
+    assertEquals(0, lucy_profile_write_folded(&profiler, path), "Writing the profile should succeed");
+    lucy_profile_free(&profiler);
+
+    FILE *f = fopen(path, "r");
+    char line[MAX_PROFILE_STACK_LENGTH];
+    assertTrue(f && fgets(line, sizeof(line), f) != NULL, "Profile should contain a stack");
+    assertTrue(strstr(line, "test_profile_folded_stacks") != NULL, "Stack should name the test function");
+    assertTrue(strstr(line, "on_sigprof") == NULL, "Signal handler frames should be dropped");
+    if (f) fclose(f);
+    remove(path);
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_alloc_stats() {
+    AllocStats stats;
+    lucy_alloc_start(&stats);
+    char *a = malloc(100);
+    doNotOptimize(a);
+    char *b = calloc(2, 50);
+    doNotOptimize(b);
+    a = realloc(a, 1000);
+    doNotOptimize(a);
+    free(b);
+    free(a);
+    lucy_alloc_stop();
+
+    assertEquals(3, stats.allocs, "malloc, calloc and realloc should each count once");
+    assertEquals(3, stats.frees, "realloc and two frees should release three blocks");
+    assertEquals(1200, stats.bytes, "Requested bytes should add up");
+    assertTrue(stats.peak_bytes >= 1100, "Peak should cover both live blocks");
+    assertEquals(0, stats.live_bytes, "Everything allocated was freed");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_alloc_stats_aligned() {
+    AllocStats stats;
+    lucy_alloc_start(&stats);
+    void *a = NULL;
+    int result = posix_memalign(&a, 64, 200);
+    doNotOptimize(a);
+    void *b = aligned_alloc(128, 256);
+    doNotOptimize(b);
+    free(a);
+    free(b);
+    lucy_alloc_stop();
+
+    assertEquals(0, result, "posix_memalign should succeed");
+    assertTrue(((uintptr_t)a % 64) == 0 && ((uintptr_t)b % 128) == 0, "Blocks should be aligned");
+    assertEquals(2, stats.allocs, "Both aligned allocations should count");
+    assertEquals(2, stats.frees, "Both frees should count");
+    assertEquals(456, stats.bytes, "Requested bytes should add up");
+    assertEquals(0, stats.live_bytes, "Freeing aligned blocks should not drive live bytes below zero");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_zero_alloc_budget() {
+    char buffer[32];
+    memcpy(buffer, "lucy", 5);
+    assertStringEquals("lucy", buffer, "Stack buffers don't allocate");
+}
+#endif
+
+static volatile int watchdog_spins = 0;
+
+static void spin_forever(void) {
+    for (;;) watchdog_spins++;
+}
+
+static void return_immediately(void) {
+}
+
+#ifdef TARGET_TEST
+void test_watchdog_timeout() {
+    Watchdog watchdog;
+    assertEquals(0, lucy_watchdog_init(&watchdog), "Watchdog should initialize");
+    double start = (double)clock() / CLOCKS_PER_SEC;
+    assertEquals(1, lucy_watchdog_run(&watchdog, spin_forever, 20), "Hung function should be aborted");
+    assertTrue((double)clock() / CLOCKS_PER_SEC - start < 2.0, "Abort should come near the limit");
+    assertEquals(0, lucy_watchdog_run(&watchdog, return_immediately, 1000), "Quick function should finish");
+    assertEquals(0, lucy_watchdog_run(&watchdog, return_immediately, 0), "Zero means no limit");
+    lucy_watchdog_free(&watchdog);
+}
+#endif
+
+static Watchdog inner_watchdog;
+
+static void spin_under_long_limit(void) {
+    lucy_watchdog_run(&inner_watchdog, spin_forever, 10000);
+}
+
+#ifdef TARGET_TEST
+void test_watchdog_nested() {
+    Watchdog outer;
+    assertEquals(0, lucy_watchdog_init(&outer), "Outer watchdog should initialize");
+    assertEquals(0, lucy_watchdog_init(&inner_watchdog), "Inner watchdog should initialize");
+    double start = (double)clock() / CLOCKS_PER_SEC;
+    assertEquals(1, lucy_watchdog_run(&outer, spin_under_long_limit, 20), "Outer limit should abort the inner run");
+    assertTrue((double)clock() / CLOCKS_PER_SEC - start < 2.0, "Abort should come at the outer limit");
+    assertEquals(1, outer.timed_out, "Outer watchdog should record the timeout");
+    assertEquals(0, lucy_watchdog_run(&outer, return_immediately, 1000), "Outer watchdog should be reusable");
+    assertEquals(0, outer.timed_out, "Arming should clear the last timeout");
+    lucy_watchdog_free(&inner_watchdog);
+    lucy_watchdog_free(&outer);
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_shard_assign() {
+    TestCase cases[4] = {0};
+    const char *names[4] = {"test_a", "test_b", "test_c", "test_d"};
+    double durations[4] = {40.0, 30.0, 20.0, 10.0};
+    for (int i = 0; i < 4; i++) {
+        cases[i].target_name = names[i];
+        cases[i].expected_ms = durations[i];
+    }
+
+    int first[4], second[4];
+    lucy_shard_assign(cases, 4, 3, SHARD_BY_HASH, first);
+    lucy_shard_assign(cases, 4, 3, SHARD_BY_HASH, second);
+    for (int i = 0; i < 4; i++) {
+        assertTrue(first[i] >= 0 && first[i] < 3, "Every test should land on a valid shard");
+        assertEquals(first[i], second[i], "Hash sharding should be deterministic");
+    }
+    assertEquals((int)(lucy_shard_hash("test_a") % 3), first[0], "Hash shard should follow the name hash");
+
+    lucy_shard_assign(cases, 4, 2, SHARD_BY_DURATION, first);
+    assertEquals(0, first[0], "Longest test goes to the first shard");
+    assertEquals(1, first[1], "Next longest goes to the emptier shard");
+    assertEquals(1, first[2], "Shard 2 is still lighter (30 < 40)");
+    assertEquals(0, first[3], "Both shards end up at 50 ms");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_report_merge() {
+    const char *inputs[2] = {"test_shard_1.jsonl", "test_shard_2.jsonl"};
+    FILE *f = fopen(inputs[0], "w");
+    fprintf(f, "{\"type\":\"test\",\"name\":\"test_a\",\"status\":\"passed\"}\n");
+    fprintf(f, "{\"type\":\"summary\",\"passed\":1,\"failed\":0,\"disabled\":2,\"wall_ms\":5.000}\n");
+    fclose(f);
+    f = fopen(inputs[1], "w");
+    fprintf(f, "{\"type\":\"test\",\"name\":\"test_b\",\"status\":\"failed\"}\n");
+    fprintf(f, "{\"type\":\"summary\",\"passed\":3,\"failed\":1,\"disabled\":2,\"wall_ms\":7.500}\n");
+    fclose(f);
+
+    ReportTotals totals;
+    assertEquals(0, lucy_report_merge("test_merged.jsonl", inputs, 2, &totals), "Merge should succeed");
+    assertEquals(4, totals.passed, "Passed counts should add up");
+    assertEquals(1, totals.failed, "Failed counts should add up");
+    assertEquals(2, totals.disabled, "Disabled tests are the same on every shard");
+    assertTrue(totals.wall_ms == 7.5, "Wall time is the longest shard");
+    assertEquals(0, totals.incomplete, "Both inputs have summaries");
+
+    f = fopen("test_merged.jsonl", "r");
+    char line[MAX_LINE_LENGTH];
+    int lines = 0, summaries = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lines++;
+        if (strstr(line, "\"type\":\"summary\"")) summaries++;
+    }
+    fclose(f);
+    assertEquals(3, lines, "Two records and one summary");
+    assertEquals(1, summaries, "Only the merged summary remains");
+    remove(inputs[0]);
+    remove(inputs[1]);
+    remove("test_merged.jsonl");
+}
+#endif
+
+/* Tests for the thread-pool run below. They only fail when the suite runs
+ * itself again with LUCY_POOL_OUTPUT set; in a normal run they pass silently.
+ * The pauses keep all three failing at the same time on different threads. */
+static void fail_repeatedly(const char *who) {
+    if (!getenv("LUCY_POOL_OUTPUT")) return;
+    for (int i = 0; i < 20; i++) {
+        assertTrue(0, who);
+        usleep(500);
+    }
+}
+
+#ifdef TARGET_TEST
+void test_pool_output_one() {
+    fail_repeatedly("pool-output-one");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_pool_output_two() {
+    fail_repeatedly("pool-output-two");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_pool_output_three() {
+    fail_repeatedly("pool-output-three");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_pool_output_passes() {
+}
+#endif
+
+/* Returns: occurrences of needle in text[0, length) */
+static int count_between(const char *text, size_t length, const char *needle) {
+    int count = 0;
+    size_t needle_length = strlen(needle);
+    for (size_t i = 0; i + needle_length <= length; i++) {
+        if (strncmp(text + i, needle, needle_length) == 0) count++;
+    }
+    return count;
+}
+
+/* Runs this test binary again as `env <binary> args`, capturing its stdout
+ * into output (NUL-terminated, truncated to size)
+ * Returns: its exit status, or -1 if it could not be run
+ */
+static int run_self(const char *env, const char *args, char *output, size_t size) {
+    char self[512];
+    ssize_t self_length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (self_length <= 0) return -1;
+    self[self_length] = '\0';
+
+    char command[1024];
+    snprintf(command, sizeof(command), "%s %s %s", env, self, args);
+    FILE *run = popen(command, "r");
+    if (!run) return -1;
+    size_t length = fread(output, 1, size - 1, run);
+    output[length] = '\0';
+    int status = pclose(run);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+#ifdef TARGET_TEST
+void test_thread_pool_output_attribution() {
+    const char *names[4] = {"one", "two", "three", "passes"};
+    static char output[65536];
+    int status = run_self("LUCY_POOL_OUTPUT=1", "--threads=4 --tag=pool-output --no-timings "
+                          "--report=test_pool_output.jsonl", output, sizeof(output));
+    assertEquals(1, status, "Three failing tests should fail the run");
+
+    /* Each result line, up to the next one, holds the 20 failures of its own test only */
+    for (int t = 0; t < 4; t++) {
+        char heading[64];
+        snprintf(heading, sizeof(heading), "Running: Pool output %s ", names[t]);
+        const char *line = strstr(output, heading);
+        assertTrue(line != NULL, "Every pool test should print a result line");
+        if (!line) continue;
+        const char *next = strstr(line + 1, "Running: ");
+        size_t span = next ? (size_t)(next - line) : strlen(line);
+        for (int other = 0; other < 3; other++) {
+            char message[64];
+            snprintf(message, sizeof(message), "pool-output-%s ", names[other]);
+            assertEquals(other == t ? 20 : 0, count_between(line, span, message),
+                         "A result line should carry exactly its own test's failures");
+        }
+    }
+
+    /* So does each test's record in the report */
+    FILE *f = fopen("test_pool_output.jsonl", "r");
+    assertTrue(f != NULL, "The run should write its report");
+    if (!f) return;
+    static char record[65536];
+    int records = 0;
+    while (fgets(record, sizeof(record), f)) {
+        for (int t = 0; t < 4; t++) {
+            char name[64];
+            snprintf(name, sizeof(name), "\"name\":\"test_pool_output_%s\"", names[t]);
+            if (!strstr(record, name)) continue;
+            records++;
+            for (int other = 0; other < 3; other++) {
+                char message[64];
+                snprintf(message, sizeof(message), "pool-output-%s ", names[other]);
+                assertEquals(other == t ? 20 : 0, count_between(record, strlen(record), message),
+                             "A report record should carry exactly its own test's failures");
+            }
+        }
+    }
+    fclose(f);
+    remove("test_pool_output.jsonl");
+    assertEquals(4, records, "Every pool test should have a report record");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_before_all_failure_reported() {
+    const char *names[4] = {"one", "two", "three", "passes"};
+    static char output[65536];
+    int status = run_self("LUCY_FAIL_BEFORE_ALL=1", "--tag=pool-output --no-timings "
+                          "--report=test_before_all.jsonl", output, sizeof(output));
+    assertEquals(1, status, "A failing @BeforeAll should fail the run");
+    for (int t = 0; t < 4; t++) {
+        char expected[128];
+        snprintf(expected, sizeof(expected), "Running: Pool output %s FAIL: test_pool_output_%s not run: "
+                 "@BeforeAll failed\n", names[t], names[t]);
+        const char *line = strstr(output, expected);
+        assertTrue(line != NULL, "Every skipped test should print a result line with the reason");
+        if (line) {
+            const char *next = strstr(line + 1, "Running: ");
+            size_t span = next ? (size_t)(next - line) : strlen(line);
+            assertEquals(1, count_between(line, span, "before-all failed on purpose"),
+                         "The result should carry the fixture's failure");
+        }
+    }
+
+    FILE *f = fopen("test_before_all.jsonl", "r");
+    assertTrue(f != NULL, "The run should write its report");
+    if (!f) return;
+    static char record[65536];
+    int records = 0, summaries = 0;
+    while (fgets(record, sizeof(record), f)) {
+        if (strstr(record, "\"type\":\"test\"")) {
+            records++;
+            assertTrue(strstr(record, "\"status\":\"failed\"") != NULL, "Skipped tests should be reported failed");
+            assertTrue(strstr(record, "before-all failed on purpose") != NULL, "Records should carry the fixture's failure");
+        } else if (strstr(record, "\"failed\":4,")) {
+            summaries++;
+        }
+    }
+    fclose(f);
+    remove("test_before_all.jsonl");
+    assertEquals(4, records, "The report should list every skipped test");
+    assertEquals(1, summaries, "The summary should count the same four failures");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_file_before_all_failure_reported() {
+    static char output[65536];
+    int status = run_self("LUCY_FAIL_FILE_BEFORE_ALL=1", "--filter=test_file_before_all --no-timings "
+                          "--report=test_file_before_all.jsonl", output, sizeof(output));
+    assertEquals(1, status, "A failing file @BeforeAll should fail the run");
+    const char *line = strstr(output, "Running: File BeforeAll runs once before the tests of its file "
+                              "FAIL: test_file_before_all not run: @BeforeAll of ");
+    assertTrue(line != NULL, "The skipped test should print a result line with the reason");
+    if (line) {
+        assertEquals(1, count_between(line, strlen(line), "file before-all failed on purpose"),
+                     "The result should carry the fixture's failure");
+    }
+
+    FILE *f = fopen("test_file_before_all.jsonl", "r");
+    assertTrue(f != NULL, "The run should write its report");
+    if (!f) return;
+    static char record[65536];
+    int records = 0;
+    while (fgets(record, sizeof(record), f)) {
+        if (strstr(record, "\"type\":\"test\"")) {
+            records++;
+            assertTrue(strstr(record, "\"status\":\"failed\"") != NULL, "The skipped test should be reported failed");
+            assertTrue(strstr(record, "file before-all failed on purpose") != NULL,
+                       "The record should carry the fixture's failure");
+        }
+    }
+    fclose(f);
+    remove("test_file_before_all.jsonl");
+    assertEquals(1, records, "The report should list the skipped test");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_budgeted_failure() {
+    if (!getenv("LUCY_BUDGET_FAILURE")) return;
+    assertTrue(0, "budgeted failure on purpose");
+}
+#endif
+
+#ifdef TARGET_TEST
+void test_failure_outside_alloc_budget() {
+    static char output[65536];
+    const char *executors[3] = {"--no-timings", "--no-timings --threads=2", "--no-timings --jobs=2"};
+    for (int e = 0; e < 3; e++) {
+        char args[128];
+        snprintf(args, sizeof(args), "--tag=budget-failure %s", executors[e]);
+        assertEquals(1, run_self("LUCY_BUDGET_FAILURE=1", args, output, sizeof(output)), "The failure should fail the run");
+        assertTrue(strstr(output, "budgeted failure on purpose") != NULL, "The assertion should be reported");
+        assertTrue(strstr(output, "@MaxAllocs") == NULL, "Recording it should not use up @MaxAllocs(0)");
+        assertTrue(strstr(output, "@MaxBytes") == NULL, "Recording it should not use up @MaxBytes(0)");
+    }
+}
+#endif
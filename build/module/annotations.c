@@ -0,0 +1,26 @@
+#include "annotations.h"
+#include <string.h>
+
+// Generated Annotation Tracking
+struct Annotation __ANNOTATIONS[4] = {
+    {"BeforeAll", module_before_all, "function", 0, {"file", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "module_before_all", "./tests/module_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_module_loaded, "function", 0, {"Module tests run from a dlopen'd table", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_module_loaded", "./tests/module_tests.c"},
+#else
+    {"Test", NULL, "function", 1, {"Module tests run from a dlopen'd table", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_module_loaded", "./tests/module_tests.c"},
+#endif
+    {"Tag", test_module_loaded, "function", 0, {"module", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, NULL, "test_module_loaded", "./tests/module_tests.c"},
+#ifdef TARGET_TEST
+    {"Test", test_module_assertions, "function", 0, {"Module tests share the runner's assertions", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_module_assertions", "./tests/module_tests.c"}
+#else
+    {"Test", NULL, "function", 1, {"Module tests share the runner's assertions", NULL, NULL, NULL, NULL, NULL, NULL, NULL}, 1, "TARGET_TEST", "test_module_assertions", "./tests/module_tests.c"}
+#endif
+};
+int __ANNOTATION_COUNT = 4;
+
+// Generated Tag Index
+static const int __TAG_0[] = {1};
+struct TagIndex __TAGS[1] = {
+    {"module", __TAG_0, 1}
+};
+int __TAG_COUNT = 1;
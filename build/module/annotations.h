@@ -0,0 +1,22 @@
+#ifndef ANNOTATIONS_H
+#define ANNOTATIONS_H
+
+#include "lucy.h"
+
+// User-defined Annotation Extensions
+// #annotation @Test(condition, description) : @When(condition)
+// #annotation @Benchmark(description) : @When(TARGET_TEST)
+
+// Function Declarations
+extern void module_before_all(void);
+extern void test_module_loaded(void);
+extern void test_module_loaded(void);
+extern void test_module_assertions(void);
+
+// Annotation Tracking Declarations
+extern struct Annotation __ANNOTATIONS[];
+extern int __ANNOTATION_COUNT;
+extern struct TagIndex __TAGS[];
+extern int __TAG_COUNT;
+extern struct Annotation *find_annotated_blocks(const char *name);
+#endif // ANNOTATIONS_H
@@ -5,5 +5,6 @@
 
 // User-defined annotation extensions
 // #annotation @Test(condition, description) : @When(condition)
+// #annotation @Benchmark(description) : @When(TARGET_TEST)
 
 #endif // ANNOTATIONS_H
\ No newline at end of file
@@ -11,11 +11,22 @@ struct Annotation {
     int arg_count;         // Number of arguments
     const char *condition; // Condition for @When or derived annotations (e.g., "TARGET_TEST")
     const char *target_name; // Name of the target function (e.g., "test_string_equality")
+    const char *file;        // Input file the annotation was read from (e.g., "tests/simple.c")
+};
+
+/* Per-tag index generated alongside __ANNOTATIONS: every annotation of every
+ * function carrying @Tag(tag), so selecting a tag never scans the whole table */
+struct TagIndex {
+    const char *tag;         // Tag value (e.g., "fast")
+    const int *annotations;  // Indices into __ANNOTATIONS, excluding the @Tag entries themselves
+    int count;               // Number of indices
 };
 
 /* External declarations for annotation tracking */
 extern struct Annotation __ANNOTATIONS[];
 extern int __ANNOTATION_COUNT;
+extern struct TagIndex __TAGS[];
+extern int __TAG_COUNT;
 extern struct Annotation *find_annotated_blocks(const char *name);
 
 /* Internal functions exposed for testing */
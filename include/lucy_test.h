@@ -4,6 +4,9 @@
 /* Predefined @Test annotation for unit tests with optional description */
 #define TEST_ANNOTATION "// #annotation @Test(description) : @When(TARGET_TEST)"
 
+/* Predefined @Benchmark annotation for microbenchmarks: the function performs one operation per call */
+#define BENCHMARK_ANNOTATION "// #annotation @Benchmark(description) : @When(TARGET_TEST)"
+
 /* Predefined @Disable annotation to mark tests as disabled with an optional reason */
 #define DISABLE_ANNOTATION "// #annotation @Disable(reason) : @When(__LUCY_TEST_DISABLE__)"
 
@@ -13,22 +16,51 @@
 /* Predefined @Teardown annotation for teardown function after each test */
 #define TEARDOWN_ANNOTATION "// #annotation @Teardown : @When(TARGET_TEST)"
 
+/* Predefined @BeforeAll annotation for setup run once, before any test; @BeforeAll("file")
+ * runs it once before the tests of its own source file instead */
+#define BEFORE_ALL_ANNOTATION "// #annotation @BeforeAll(scope) : @When(TARGET_TEST)"
+
+/* Predefined @AfterAll annotation for teardown run once, after every test; @AfterAll("file")
+ * runs it once after the tests of its own source file instead */
+#define AFTER_ALL_ANNOTATION "// #annotation @AfterAll(scope) : @When(TARGET_TEST)"
+
+/* Predefined @NotThreadSafe annotation to run a test alone in the runner process, never concurrently */
+#define NOT_THREAD_SAFE_ANNOTATION "// #annotation @NotThreadSafe : @When(TARGET_TEST)"
+
+/* Predefined @MaxAllocs annotation failing a test whose body makes more than n allocations */
+#define MAX_ALLOCS_ANNOTATION "// #annotation @MaxAllocs(n) : @When(TARGET_TEST)"
+
+/* Predefined @MaxBytes annotation failing a test whose body requests more than n heap bytes in total */
+#define MAX_BYTES_ANNOTATION "// #annotation @MaxBytes(n) : @When(TARGET_TEST)"
+
+/* Predefined @Timeout annotation aborting a test that runs longer than ms milliseconds (0 for no limit) */
+#define TIMEOUT_ANNOTATION "// #annotation @Timeout(ms) : @When(TARGET_TEST)"
+
+/* Predefined @Tag annotation grouping tests for --tag selection; takes one or more tag names */
+#define TAG_ANNOTATION "// #annotation @Tag(names) : @When(TARGET_TEST)"
+
+/* Predefined @Covers annotation linking a test to the source files it exercises, for --changed */
+#define COVERS_ANNOTATION "// #annotation @Covers(files) : @When(TARGET_TEST)"
+
 // Standard C includes for assertion macros
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Global flag to track test failure within a single test function
-extern int __test_failed;
+// Per-thread flag to track test failure within a single test function
+extern __thread int __test_failed;
+
+/* Marks the current thread's test as failed and reports the message; the runner
+ * either prints it immediately or buffers it until the test's report is flushed */
+void __lucy_test_fail(const char *format, ...) __attribute__((format(printf, 1, 2)));
 
 // Assertion macros
 #define assertTrue(actual, message) \
     do { \
         int _actual = (actual); \
         if (!_actual) { \
-            printf("FAIL: %s:%d - %s (expected true, got false)\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Assertion failed"); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected true, got false)\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Assertion failed"); \
         } \
     } while (0)
 
@@ -36,9 +68,8 @@ extern int __test_failed;
     do { \
         int _actual = (actual); \
         if (_actual) { \
-            printf("FAIL: %s:%d - %s (expected false, got true)\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Assertion failed"); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected false, got true)\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Assertion failed"); \
         } \
     } while (0)
 
@@ -47,10 +78,9 @@ extern int __test_failed;
         typeof(expected) _exp = (expected); \
         typeof(actual) _act = (actual); \
         if (_exp != _act) { \
-            printf("FAIL: %s:%d - %s (expected %ld, got %ld)\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Values not equal", \
-                   (long)_exp, (long)_act); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected %ld, got %ld)\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Values not equal", \
+                             (long)_exp, (long)_act); \
         } \
     } while (0)
 
@@ -59,10 +89,9 @@ extern int __test_failed;
         typeof(expected) _exp = (expected); \
         typeof(actual) _act = (actual); \
         if (_exp == _act) { \
-            printf("FAIL: %s:%d - %s (expected different values, both %ld)\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Values equal", \
-                   (long)_exp); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected different values, both %ld)\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Values equal", \
+                             (long)_exp); \
         } \
     } while (0)
 
@@ -73,15 +102,13 @@ extern int __test_failed;
         if (_exp == NULL && _act == NULL) { \
             /* Both null, considered equal, do nothing */ \
         } else if (_exp == NULL || _act == NULL) { \
-            printf("FAIL: %s:%d - %s (expected '%s', got '%s')\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Strings not equal", \
-                   _exp ? _exp : "(null)", _act ? _act : "(null)"); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected '%s', got '%s')\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Strings not equal", \
+                             _exp ? _exp : "(null)", _act ? _act : "(null)"); \
         } else if (strcmp(_exp, _act) != 0) { \
-            printf("FAIL: %s:%d - %s (expected '%s', got '%s')\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Strings not equal", \
-                   _exp, _act); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected '%s', got '%s')\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Strings not equal", \
+                             _exp, _act); \
         } \
     } while (0)
 
@@ -90,16 +117,21 @@ extern int __test_failed;
         const char *_exp = (const char *)(expected); \
         const char *_act = (const char *)(actual); \
         if (_exp == NULL && _act == NULL) { \
-            printf("FAIL: %s:%d - %s (expected '%s', got '%s')\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Strings equal", \
-                   "(null)", "(null)"); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected '%s', got '%s')\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Strings equal", \
+                             "(null)", "(null)"); \
         } else if (_exp != NULL && _act != NULL && strcmp(_exp, _act) == 0) { \
-            printf("FAIL: %s:%d - %s (expected '%s', got '%s')\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Strings equal", \
-                   _exp, _act); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected '%s', got '%s')\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Strings equal", \
+                             _exp, _act); \
         } \
     } while (0)
 
+/* Keeps a benchmark result alive so the compiler can't optimize its computation away */
+#define doNotOptimize(value) \
+    do { \
+        typeof(value) _value = (value); \
+        __asm__ volatile("" : : "g"(_value) : "memory"); \
+    } while (0)
+
 #endif // LUCY_TEST_H
\ No newline at end of file
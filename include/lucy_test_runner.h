@@ -0,0 +1,363 @@
+#ifndef LUCY_TEST_RUNNER_H
+#define LUCY_TEST_RUNNER_H
+
+#include <stdio.h>
+#include <setjmp.h> // For sigjmp_buf
+#include <signal.h> // For sig_atomic_t
+#include <stdint.h>
+#include <time.h>   // For timer_t
+#include "lucy.h"  // For struct Annotation
+
+/* Default location of the per-test wall time cache, relative to the working directory */
+#define LUCY_TIMINGS_PATH ".lucy-test-timings"
+
+/* Default location of saved benchmark medians, relative to the working directory */
+#define LUCY_BENCH_BASELINE_PATH ".lucy-bench-baseline"
+
+/* Maximum number of --report outputs per run */
+#define MAX_REPORTS 8
+
+/* Default directory for --profile folded stacks, and the default sampling interval */
+#define LUCY_PROFILE_DIR "lucy-profile"
+#define LUCY_PROFILE_INTERVAL_US 1000
+
+/* Per-test profiler limits: samples kept, frames per sample, rendered stack length */
+#define MAX_PROFILE_SAMPLES 8192
+#define MAX_PROFILE_DEPTH 64
+#define MAX_PROFILE_STACK_LENGTH 8192
+
+/* Upper bound on --module shared objects loaded by one run */
+#define MAX_MODULES 64
+
+/* Signature shared by @Test, @Setup and @Teardown targets */
+typedef void (*TestFunc)(void);
+
+/* Hardware events sampled by --perf, in report order */
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,    // L1 data cache read misses
+    PERF_LLC_MISSES,    // Last-level cache read misses
+    PERF_BRANCH_MISSES,
+    PERF_EVENT_COUNT
+} PerfEvent;
+
+/* Counter values of one measurement, indexed by PerfEvent; -1 where unavailable */
+typedef struct {
+    double values[PERF_EVENT_COUNT];
+    int valid;  // 1 if at least one counter was read
+} PerfCounts;
+
+/* Counters opened on one thread; a slot is -1 when the kernel refused the event */
+typedef struct {
+    int fds[PERF_EVENT_COUNT];
+    uint64_t start[PERF_EVENT_COUNT][3];  // value, time_enabled, time_running at start
+    int error;                            // errno of the first refused event
+} PerfCounters;
+
+/* Heap activity of one test body, counted on the test's thread */
+typedef struct {
+    long allocs;      // malloc/calloc/realloc calls that returned a block
+    long frees;       // Blocks released by free/realloc
+    long bytes;       // Total bytes requested
+    long live_bytes;  // Usable bytes still allocated (may go negative if the test frees older blocks)
+    long peak_bytes;  // Highest live_bytes seen
+} AllocStats;
+
+/* SIGPROF sampler bound to the thread that called lucy_profile_init */
+typedef struct {
+    void **frames;     // MAX_PROFILE_SAMPLES x MAX_PROFILE_DEPTH return addresses
+    int *depths;       // Frames captured per sample
+    int count;         // Samples taken since lucy_profile_start
+    int dropped;       // Samples lost because the buffer was full
+    long interval_us;  // Thread CPU time between samples
+    timer_t timer;
+    int has_timer;
+} Profiler;
+
+/* Timer that aborts an in-process test running past its @Timeout */
+typedef struct Watchdog {
+    timer_t timer;
+    int has_timer;
+    sigjmp_buf jump;                // Where SIGALRM returns to when the test overruns
+    volatile sig_atomic_t timed_out;  // Set by the handler; cleared whenever the timer is armed
+    struct Watchdog *previous;      // Watchdog this one's run is nested in, restored when it ends
+    const char *name;               // Test named if a timeout has to exit the process, or NULL
+    char exit_message[256];         // Prepared when armed; the handler may only write(2)
+} Watchdog;
+
+/* A single enabled test resolved from the annotation table */
+typedef struct {
+    const char *description; // @Test description, or target_name when absent
+    const char *target_name; // Name of the test function (e.g., "test_arithmetic")
+    TestFunc func;           // Test function
+    double expected_ms;      // Wall time from the timings cache, or -1 if unknown
+    double wall_ms;          // Measured wall time of this run (CLOCK_MONOTONIC)
+    double cpu_ms;           // User + system CPU time of this run (getrusage)
+    int failed;              // 1 if the test failed in this run
+    char *output;            // Assertion messages (and, when forked, all output), or NULL
+    int not_thread_safe;     // 1 if marked @NotThreadSafe: never run concurrently
+    PerfCounts perf;         // Counters around the test body (--perf)
+    AllocStats allocs;       // Heap activity of the test body
+    long max_allocs;         // @MaxAllocs budget, or -1 for none
+    long max_bytes;          // @MaxBytes budget, or -1 for none
+    long timeout_ms;         // @Timeout, else --timeout; 0 for none
+    int timed_out;           // 1 if the runner aborted the test at timeout_ms
+    const char *file;        // Source file lucy recorded for the @Test annotation
+    int last_failed;         // 1 if it failed last run and --failed-first is on
+    int ran;                 // 1 once the test completed (--fail-fast may skip the rest)
+} TestCase;
+
+/* A @Benchmark function and its latest measurement */
+typedef struct {
+    const char *description; // @Benchmark description, or target_name when absent
+    const char *target_name; // Name of the benchmark function
+    TestFunc func;           // Performs one operation per call
+    long iterations;         // Calls per timed batch, after calibration
+    int samples;             // Number of timed batches
+    double median_ns;        // Median ns/op over all batches
+    double mad_ns;           // Median absolute deviation of ns/op
+    double p99_ns;           // 99th percentile ns/op
+    double baseline_ns;      // Saved median ns/op, or -1 without a baseline
+    int failed;              // 1 if an assertion in the body failed
+    int regressed;           // 1 if median_ns exceeds the baseline by more than the threshold
+    PerfCounts perf;         // Counters per operation over the timed batches (--perf)
+} Benchmark;
+
+/* Tuning for lucy_bench_run */
+typedef struct {
+    double batch_ms;         // Minimum duration of one timed batch
+    int samples;             // Timed batches per benchmark
+    double threshold_pct;    // Allowed slowdown over the baseline, in percent
+} BenchOptions;
+
+/* One measurement from a previous run, keyed by target_name */
+typedef struct {
+    char *target_name;
+    double value;  // Wall time in ms (timings cache) or median ns/op (benchmark baselines)
+    int failed;    // 1 if the test failed the last time it ran
+} TimingEntry;
+
+/* In-memory copy of the timings cache or of the benchmark baselines */
+typedef struct {
+    TimingEntry *entries;
+    int count;
+    int capacity;
+} TimingCache;
+
+/* Loads the timings cache at path; a missing file yields an empty cache
+ * Returns: 0 on success, 1 on allocation failure
+ */
+int lucy_timings_load(TimingCache *cache, const char *path);
+
+/* Looks up the cached value of a test
+ * Returns: the value, or -1 if the test has no history
+ */
+double lucy_timings_lookup(const TimingCache *cache, const char *target_name);
+
+/* Records (or replaces) the value of a test
+ * Returns: 0 on success, 1 on allocation failure
+ */
+int lucy_timings_record(TimingCache *cache, const char *target_name, double value);
+
+/* Records whether a test failed in this run
+ * Returns: 0 on success, 1 on allocation failure
+ */
+int lucy_timings_set_failed(TimingCache *cache, const char *target_name, int failed);
+
+/* Returns: 1 if the test failed the last time it ran, 0 otherwise or without history */
+int lucy_timings_failed(const TimingCache *cache, const char *target_name);
+
+/* Writes the cache back to path, one "target_name value" pair per line (plus " 1" after failures)
+ * Returns: 0 on success, 1 on I/O error
+ */
+int lucy_timings_save(const TimingCache *cache, const char *path);
+
+/* Frees all entries held by the cache */
+void lucy_timings_free(TimingCache *cache);
+
+/* Fills order with test indices sorted longest-expected-first (LPT scheduling)
+ * - Tests with last_failed set run before everything else
+ * - Tests without history run before all others, in declaration order
+ * - Ties keep declaration order so the schedule is deterministic
+ */
+void lucy_schedule_longest_first(const TestCase *tests, int count, int *order);
+
+/* How --shard splits the enabled tests */
+typedef enum {
+    SHARD_BY_HASH,     // Stable hash of target_name
+    SHARD_BY_DURATION  // Greedy longest-first packing using cached timings
+} ShardStrategy;
+
+/* FNV-1a hash of text, stable across runs, builds and machines */
+uint32_t lucy_shard_hash(const char *text);
+
+/* Fills shard_of[i] with the 0-based shard of tests[i]; every shard computes the same result
+ * Returns: 0 on success, 1 on allocation failure
+ */
+int lucy_shard_assign(const TestCase *tests, int count, int shard_count,
+                      ShardStrategy strategy, int *shard_of);
+
+/* Annotations of the runner and of every --module shared object, copied into one
+ * table owned by the runner (so later sync_annotations calls can't disturb it)
+ */
+typedef struct {
+    struct Annotation *annotations;  // Runner entries first, then each module's in load order
+    int count;
+    struct TagIndex *tags;           // Every table's tag lists, indices rebased onto annotations
+    int tag_count;
+    void *modules[MAX_MODULES];      // dlopen handles, kept open while tests may run
+    int module_count;
+    int failed_modules;              // Modules that could not be loaded
+} AnnotationTable;
+
+/* Starts a table with a copy of the runner's own annotations and tag index
+ * Returns: 0 on success, 1 on allocation failure
+ */
+int lucy_table_init(AnnotationTable *table, const struct Annotation *annotations, int count,
+                    const struct TagIndex *tags, int tag_count);
+
+/* dlopens a test module and appends its __ANNOTATIONS and __TAGS to the table.
+ * A module that fails to load is reported and counted; the table is left as it was.
+ * Returns: 0 on success, 1 on failure
+ */
+int lucy_table_load_module(AnnotationTable *table, const char *path);
+
+/* Returns: the table's annotations named name, terminated by an entry with a NULL
+ * name (caller frees), or NULL on allocation failure
+ */
+struct Annotation *lucy_table_find(const AnnotationTable *table, const char *name);
+
+/* Frees the table; module handles stay open because fixtures and tests point into them */
+void lucy_table_free(AnnotationTable *table);
+
+/* Computes median, median absolute deviation and nearest-rank p99 of samples
+ * Note: Sorts samples in place
+ */
+void lucy_bench_stats(double *samples, int count, double *median, double *mad, double *p99);
+
+/* Calibrates, warms up and samples one benchmark, then flags regressions
+ * against bench->baseline_ns. Setup/teardown are the caller's job.
+ * - perf: counters to run around the timed batches, or NULL
+ */
+void lucy_bench_run(Benchmark *bench, const BenchOptions *opts, PerfCounters *perf);
+
+/* Opens every PerfEvent counter for the calling thread, initially disabled
+ * Returns: number of counters opened; 0 means counters are unavailable (see perf->error)
+ */
+int lucy_perf_open(PerfCounters *perf);
+
+/* Starts counting on the calling thread */
+void lucy_perf_start(PerfCounters *perf);
+
+/* Stops counting and stores the counts since lucy_perf_start, scaled for multiplexing */
+void lucy_perf_stop(PerfCounters *perf, PerfCounts *counts);
+
+/* Closes every counter opened by lucy_perf_open */
+void lucy_perf_close(PerfCounters *perf);
+
+/* Returns: report name of a PerfEvent (e.g., "l1d_misses") */
+const char *lucy_perf_event_name(int event);
+
+/* Starts counting this thread's allocations into stats (zeroed first) */
+void lucy_alloc_start(AllocStats *stats);
+
+/* Stops counting this thread's allocations */
+void lucy_alloc_stop(void);
+
+/* Returns: 1 if the calling thread is inside malloc, free or another wrapped allocator;
+ * async-signal-safe */
+int lucy_alloc_busy(void);
+
+/* Suspends counting on this thread, for the runner's own allocations in a test body
+ * Returns: the stats being counted into, or NULL, for lucy_alloc_resume
+ */
+AllocStats *lucy_alloc_pause(void);
+
+/* Resumes counting into stats as returned by lucy_alloc_pause */
+void lucy_alloc_resume(AllocStats *stats);
+
+/* Creates the watchdog timer of the calling thread and installs the SIGALRM handler
+ * Returns: 0 on success, 1 on failure (tests then run without a time limit)
+ */
+int lucy_watchdog_init(Watchdog *watchdog);
+
+/* Calls func, jumping out of it if it is still running after timeout_ms.
+ * A timeout_ms of 0 (or a watchdog without timer) runs func unguarded. Runs
+ * nest: an inner run keeps the outer one's limit in force. A timeout that
+ * lands inside the allocator can't be jumped out of without leaving its
+ * locks held, so it reports the timeout on stderr and exits the process.
+ * Returns: 1 if func was aborted, 0 if it returned normally
+ */
+int lucy_watchdog_run(Watchdog *watchdog, TestFunc func, long timeout_ms);
+
+/* Deletes the watchdog timer */
+void lucy_watchdog_free(Watchdog *watchdog);
+
+/* Allocates sample buffers and creates a CPU-time timer for the calling thread
+ * Returns: 0 on success, 1 on failure
+ */
+int lucy_profile_init(Profiler *profiler, long interval_us);
+
+/* Clears previous samples and starts sampling the calling thread */
+void lucy_profile_start(Profiler *profiler);
+
+/* Stops sampling; the samples stay available for lucy_profile_write_folded */
+void lucy_profile_stop(Profiler *profiler);
+
+/* Writes the samples as folded stacks, one "frame;frame;frame count" line per stack.
+ * Nothing is written when there are no samples.
+ * Returns: 0 on success, 1 on I/O or allocation failure
+ */
+int lucy_profile_write_folded(const Profiler *profiler, const char *path);
+
+/* Deletes the timer and frees the sample buffers */
+void lucy_profile_free(Profiler *profiler);
+
+/* Output formats for --report, chosen by file extension */
+typedef enum {
+    REPORT_JSONL,  // One JSON object per test, then a summary object
+    REPORT_JUNIT   // JUnit XML (".xml")
+} ReportFormat;
+
+/* A report file that receives each test as soon as it completes */
+typedef struct {
+    const char *path;
+    ReportFormat format;
+    FILE *out;
+} Report;
+
+/* Opens a report and writes its preamble; the format follows the extension of path
+ * Returns: 0 on success, 1 on I/O error
+ */
+int lucy_report_open(Report *report, const char *path);
+
+/* Appends one completed test to the report and flushes it */
+void lucy_report_test(Report *report, const TestCase *test);
+
+/* Appends one completed benchmark to the report and flushes it */
+void lucy_report_benchmark(Report *report, const Benchmark *bench);
+
+/* Writes run totals (JSONL) or closing tags (JUnit) and closes the report */
+void lucy_report_close(Report *report, int passed, int failed, int disabled, double wall_ms);
+
+/* Run totals of JSONL reports combined by lucy_report_merge */
+typedef struct {
+    int reports;     // Inputs read
+    int incomplete;  // Inputs without a summary line (runner crashed or still running)
+    int passed;
+    int failed;
+    int disabled;    // Largest count of any input; every shard sees all disabled tests
+    double wall_ms;  // Longest input, since shards run side by side
+} ReportTotals;
+
+/* Concatenates the records of JSONL reports into out_path, followed by one
+ * summary line with the combined totals
+ * Returns: 0 on success, 1 if an input or the output could not be opened
+ */
+int lucy_report_merge(const char *out_path, const char *const *inputs, int count, ReportTotals *totals);
+
+/* Prints a table of the `limit` slowest tests by wall time */
+void lucy_print_slowest(const TestCase *tests, int count, int limit);
+
+#endif // LUCY_TEST_RUNNER_H
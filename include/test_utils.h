@@ -5,16 +5,19 @@
 #include <stdlib.h>
 #include <string.h>
 
-// Global flag to track test failure within a single test function
-extern int __test_failed;
+// Per-thread flag to track test failure within a single test function
+extern __thread int __test_failed;
+
+/* Marks the current thread's test as failed and reports the message, buffered
+ * like lucy_test.h's assertions so -t output doesn't interleave */
+void __lucy_test_fail(const char *format, ...) __attribute__((format(printf, 1, 2)));
 
 #define assertTrue(actual, message) \
     do { \
         int _actual = (actual); \
         if (!_actual) { \
-            printf("FAIL: %s:%d - %s (expected true, got false)\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Assertion failed"); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected true, got false)\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Assertion failed"); \
         } \
     } while (0)
 
@@ -22,9 +25,8 @@ extern int __test_failed;
     do { \
         int _actual = (actual); \
         if (_actual) { \
-            printf("FAIL: %s:%d - %s (expected false, got true)\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Assertion failed"); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected false, got true)\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Assertion failed"); \
         } \
     } while (0)
 
@@ -33,10 +35,9 @@ extern int __test_failed;
         typeof(expected) _exp = (expected); \
         typeof(actual) _act = (actual); \
         if (_exp != _act) { \
-            printf("FAIL: %s:%d - %s (expected %ld, got %ld)\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Values not equal", \
-                   (long)_exp, (long)_act); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected %ld, got %ld)\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Values not equal", \
+                             (long)_exp, (long)_act); \
         } \
     } while (0)
 
@@ -45,30 +46,27 @@ extern int __test_failed;
         typeof(expected) _exp = (expected); \
         typeof(actual) _act = (actual); \
         if (_exp == _act) { \
-            printf("FAIL: %s:%d - %s (expected different values, both %ld)\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Values equal", \
-                   (long)_exp); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected different values, both %ld)\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Values equal", \
+                             (long)_exp); \
         } \
     } while (0)
 
 #define assertStringEquals(expected, actual, message) \
     do { \
         if (strcmp((const char *)(expected), (const char *)(actual)) != 0) { \
-            printf("FAIL: %s:%d - %s (expected '%s', got '%s')\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Strings not equal", \
-                   (const char *)(expected), (const char *)(actual)); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected '%s', got '%s')\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Strings not equal", \
+                             (const char *)(expected), (const char *)(actual)); \
         } \
     } while (0)
 
 #define assertStringNotEquals(expected, actual, message) \
     do { \
         if (strcmp((const char *)(expected), (const char *)(actual)) == 0) { \
-            printf("FAIL: %s:%d - %s (expected different strings, both '%s')\n", \
-                   __FILE__, __LINE__, (message) ? (message) : "Strings equal", \
-                   (const char *)(expected)); \
-            __test_failed = 1; \
+            __lucy_test_fail("FAIL: %s:%d - %s (expected different strings, both '%s')\n", \
+                             __FILE__, __LINE__, (message) ? (message) : "Strings equal", \
+                             (const char *)(expected)); \
         } \
     } while (0)
 
@@ -1,37 +1,90 @@
 #include "lucy_test.h"
 #include "toyvm.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/wait.h>
+
+/* Encodes rows of {opcode, operands...} into a padded buffer the caller
+ * owns (or hands to vm_set_program) */
+static char *assemble(const int32_t (*program)[4], int count, int *size) {
+    char *code = malloc(count * 16 + VM_CODE_PADDING);
+    *size = 0;
+    for (int i = 0; i < count; i++) {
+        *size += vm_encode(code + *size, (unsigned char)program[i][0], &program[i][1]);
+    }
+    memset(code + *size, 0, VM_CODE_PADDING);
+    return code;
+}
+
+/* Copies a token's text out of its source for assertStringEquals */
+static const char *token_text(const char *source, const Token *token) {
+    static char text[64];
+    snprintf(text, sizeof(text), "%.*s", token->length, source + token->offset);
+    return text;
+}
 
 // @Test("Tokenize a number")
 void test_tokenize_number() {
+    Arena arena;
+    arena_init(&arena);
     int token_count;
-    Token *tokens = tokenize("42", &token_count);
+    Token *tokens = tokenize(&arena, "42", &token_count);
     assertEquals(TOKEN_NUMBER, tokens[0].type, "First token should be a number");
-    assertStringEquals("42", tokens[0].value, "Number value should be 42");
+    assertStringEquals("42", token_text("42", &tokens[0]), "Number value should be 42");
     assertEquals(TOKEN_EOF, tokens[1].type, "Second token should be EOF");
     assertEquals(2, token_count, "Should have 2 tokens");
-    free_tokens(tokens, token_count);
+    arena_release(&arena);
 }
 
 // @Test("Tokenize an identifier")
 void test_tokenize_identifier() {
+    Arena arena;
+    arena_init(&arena);
     int token_count;
-    Token *tokens = tokenize("x", &token_count);
+    Token *tokens = tokenize(&arena, "x", &token_count);
     assertEquals(TOKEN_IDENTIFIER, tokens[0].type, "First token should be an identifier");
-    assertStringEquals("x", tokens[0].value, "Identifier value should be x");
+    assertStringEquals("x", token_text("x", &tokens[0]), "Identifier value should be x");
     assertEquals(TOKEN_EOF, tokens[1].type, "Second token should be EOF");
-    free_tokens(tokens, token_count);
+    arena_release(&arena);
 }
 
 // @Test("Tokenize print statement")
 void test_tokenize_print() {
+    Arena arena;
+    arena_init(&arena);
     int token_count;
-    Token *tokens = tokenize("print(x)", &token_count);
+    Token *tokens = tokenize(&arena, "print(x)", &token_count);
     assertEquals(TOKEN_PRINT, tokens[0].type, "First token should be print");
-    assertEquals(TOKEN_IDENTIFIER, tokens[1].type, "Second token should be identifier");
-    assertStringEquals("x", tokens[1].value, "Identifier should be x");
-    assertEquals(TOKEN_EOF, tokens[2].type, "Third token should be EOF");
-    free_tokens(tokens, token_count);
+    assertEquals(TOKEN_LPAREN, tokens[1].type, "Second token should be (");
+    assertEquals(TOKEN_IDENTIFIER, tokens[2].type, "Third token should be identifier");
+    assertStringEquals("x", token_text("print(x)", &tokens[2]), "Identifier should be x");
+    assertEquals(TOKEN_RPAREN, tokens[3].type, "Fourth token should be )");
+    assertEquals(TOKEN_EOF, tokens[4].type, "Fifth token should be EOF");
+    arena_release(&arena);
+}
+
+// @Test("Tokenize long input into views across arena blocks")
+void test_tokenize_long_input() {
+    const int lines = 20000;  // 60000 tokens: far more than one arena block holds
+    char *source = malloc(lines * 8 + 1);
+    char *p = source;
+    for (int i = 0; i < lines; i++) p += sprintf(p, "%c = %d\n", 'a' + i % 26, i % 100);
+
+    Arena arena;
+    arena_init(&arena);
+    int token_count;
+    Token *tokens = tokenize(&arena, source, &token_count);
+    assertEquals(lines * 3 + 1, token_count, "Every line should give three tokens plus EOF");
+    const Token *last = &tokens[token_count - 2];
+    assertEquals((int)TOKEN_NUMBER, (int)last->type, "Last token before EOF should be a number");
+    assertStringEquals("99", token_text(source, last), "Last number should be 99");
+    assertEquals(lines, last->line, "Line numbers should survive buffer growth");
+    assertEquals((int)TOKEN_EQUALS, (int)tokens[lines * 3 / 2 + 1].type, "Tokens should stay in order");
+    arena_release(&arena);
+    free(source);
 }
 
 // @Test("Interpret assignment")
@@ -88,6 +141,59 @@ void test_interpret_var_to_var_addition() {
     vm_free(vm);
 }
 
+// @Test("Compile expressions with precedence and parentheses")
+void test_compile_expressions() {
+    ToyVM *vm = vm_new();
+    interpret(vm, "a = 2 + 3 * 4\nb = (2 + 3) * 4\nc = 20 - 6 - 4\nd = -(a - b) * 2");
+    assertEquals(14, vm->vars['a' - 'a'], "* should bind tighter than +");
+    assertEquals(20, vm->vars['b' - 'a'], "Parentheses should group");
+    assertEquals(10, vm->vars['c' - 'a'], "- should be left-associative");
+    assertEquals(12, vm->vars['d' - 'a'], "Unary minus should negate");
+    interpret(vm, "e = 1000 * 3\nf = -7");
+    assertEquals(3000, vm->vars['e' - 'a'], "Constants above 255 should survive");
+    assertEquals(-7, vm->vars['f' - 'a'], "Negative constants should survive");
+    interpret(vm, "a * 2 + 1");
+    assertEquals(29, vm->vars['a' - 'a'], "x op ... should update x with the whole expression");
+    vm_free(vm);
+}
+
+// @Test("Compile folds constant expressions")
+void test_compile_folds_constants() {
+    ToyVM *vm = vm_new();
+    assertEquals(0, toy_compile(vm, "x = (2 + 3) * 4 - 1"), "Program should compile");
+    assertEquals(4, vm->code_size, "Folded assignment should be STORE_IMM plus HALT");
+    VmInstruction insn;
+    vm_decode(vm->code, vm->code_size, 0, &insn);
+    assertEquals(OP_STORE_IMM, insn.op, "Constant should be stored directly");
+    assertEquals(19, insn.args[1], "Folded value should be 19");
+    assertEquals(0, toy_compile(vm, "x = 1 / 0"), "Division by zero should compile");
+    assertEquals(OP_DIV, vm->code[4], "Division by zero should be left to the VM");
+    vm_free(vm);
+}
+
+// @Test("Compile once and run many times")
+void test_compile_once_run_many() {
+    ToyVM *vm = vm_new();
+    assertEquals(0, toy_compile(vm, "x + 2"), "Program should compile");
+    assertEquals(0, vm->vars['x' - 'a'], "Compiling should not run the program");
+    for (int i = 0; i < 3; i++) vm_execute(vm);
+    assertEquals(6, vm->vars['x' - 'a'], "Three runs should add 2 three times");
+    vm_free(vm);
+}
+
+// @Test("Compile rejects syntax errors")
+void test_compile_syntax_errors() {
+    ToyVM *vm = vm_new();
+    interpret(vm, "x = 5");
+    assertEquals(1, toy_compile(vm, "x = (1 + 2"), "Unclosed parenthesis should fail");
+    assertEquals(1, toy_compile(vm, "x = 3 +"), "Missing operand should fail");
+    assertEquals(1, toy_compile(vm, "Foo = 3"), "Multi-letter variables should fail");
+    assertEquals(1, toy_compile(vm, "x y"), "A bare variable is not a statement");
+    interpret(vm, "x = 9\ny = 2 $ 3");
+    assertEquals(5, vm->vars['x' - 'a'], "A program with an error should not run at all");
+    vm_free(vm);
+}
+
 // @Test("VM push and print")
 void test_vm_push_print() {
     ToyVM *vm = vm_new();
@@ -97,6 +203,718 @@ void test_vm_push_print() {
     vm_free(vm);
 }
 
+// @Test("Switch and threaded dispatch agree")
+void test_dispatch_variants_agree() {
+    ToyVM *vm = vm_new();
+    interpret(vm, "a = 7\nb = 3\nc = a * b\nd = c - a\nd / 2\ne = d + b");
+    int expected[26];
+    memcpy(expected, vm->vars, sizeof(expected));
+    memset(vm->vars, 0, sizeof(vm->vars));
+    vm_execute_with(vm, VM_DISPATCH_SWITCH);
+    assertTrue(memcmp(expected, vm->vars, sizeof(expected)) == 0, "Switch loop should match vm_execute");
+    memset(vm->vars, 0, sizeof(vm->vars));
+    vm_execute_with(vm, VM_DISPATCH_THREADED);
+    assertTrue(memcmp(expected, vm->vars, sizeof(expected)) == 0, "Threaded loop should match vm_execute");
+    assertEquals(10, vm->vars['e' - 'a'], "e should be (7 * 3 - 7) / 2 + 3");
+    assertEquals(0, vm->sp, "Stack should be balanced after the run");
+    vm_free(vm);
+}
+
+// @Test("Peephole fuses statement patterns into superinstructions")
+void test_peephole_fuses_patterns() {
+    static const int32_t program[][4] = {
+        {OP_LOAD, 0}, {OP_LOAD, 1}, {OP_ADD}, {OP_STORE, 2},
+        {OP_LOAD, 2}, {OP_PUSH, 3}, {OP_SUB}, {OP_STORE, 2},
+        {OP_LOAD, 3}, {OP_PUSH, 2}, {OP_MUL}, {OP_STORE, 3},
+        {OP_HALT},
+    };
+    int count = sizeof(program) / sizeof(program[0]);
+    int original_size, size;
+    char *original = assemble(program, count, &original_size);
+    char *code = assemble(program, count, &size);
+    size = peephole_optimize(&code, size, NULL, 0);
+    assertEquals(11, size, "Three statements should shrink to 11 bytes");
+    assertEquals(OP_ADD_VV_STORE, code[0], "LOAD LOAD ADD STORE should fuse");
+    assertEquals(OP_DEC_VAR_IMM, code[4], "LOAD PUSH SUB STORE on one variable should fuse");
+    assertEquals(OP_MUL_VAR_IMM, code[7], "LOAD PUSH MUL STORE on one variable should fuse");
+    assertEquals(OP_HALT, code[size - 1], "HALT should stay last");
+
+    /* Unknown inputs: both versions must leave the same variables behind */
+    ToyVM *vm = vm_new();
+    vm_set_program(vm, original, original_size, NULL, 0);
+    vm->vars[0] = 40;
+    vm->vars[1] = 2;
+    vm->vars[3] = 5;
+    vm_execute(vm);
+    int expected[26];
+    memcpy(expected, vm->vars, sizeof(expected));
+    vm_set_program(vm, code, size, NULL, 0);
+    memset(vm->vars, 0, sizeof(vm->vars));
+    vm->vars[0] = 40;
+    vm->vars[1] = 2;
+    vm->vars[3] = 5;
+    vm_execute(vm);
+    assertTrue(memcmp(expected, vm->vars, sizeof(expected)) == 0, "Optimized code should match the original");
+    assertEquals(39, vm->vars[2], "c should be 40 + 2 - 3");
+    vm_free(vm);
+}
+
+// @Test("Peephole folds constants and drops dead stores")
+void test_peephole_folds_constants() {
+    ToyVM *vm = vm_new();
+    interpret(vm, "a = 2\nb = 3\nc = a + b\nc * 4\na = 9\nprint(c)");
+    assertEquals(9, vm->vars['a' - 'a'], "a should be 9");
+    assertEquals(20, vm->vars['c' - 'a'], "c should be (2 + 3) * 4");
+    assertEquals(OP_STORE_IMM, vm->code[0], "b = 3 should be a single STORE_IMM");
+    VmInstruction insn;
+    vm_decode(vm->code, vm->code_size, 3, &insn);
+    assertEquals(OP_STORE_IMM, insn.op, "c should fold to STORE_IMM 20");
+    assertEquals(20, insn.args[1], "Folded value of c should be 20");
+    assertEquals(OP_STORE_IMM, vm->code[6], "a = 2 is dead; a = 9 should follow");
+    assertEquals(OP_LOAD_PRINT, vm->code[9], "print should fuse into LOAD_PRINT");
+    assertEquals(12, vm->code_size, "Program should shrink to 12 bytes");
+    vm_free(vm);
+}
+
+// @Test("Peephole keeps a division that can fail")
+void test_peephole_keeps_faulting_division() {
+    ToyVM *vm = vm_new();
+    interpret(vm, "a = 4\nb = 0\nc = a / b\na = 1");
+    assertEquals(OP_DIV_VV_STORE, vm->code[6], "Division by a known zero should not fold");
+    assertEquals(4, vm->vars['a' - 'a'], "Execution should stop before a = 1");
+    assertEquals(0, vm->vars['c' - 'a'], "c should be untouched");
+    vm_free(vm);
+}
+
+// @Test("Register backend matches the stack backend")
+void test_register_backend_matches_stack() {
+    const char *program = "c = a + b\nd = c * b\nd - 4\ne = d / a\nprint(e)";
+    ToyVM *stack_vm = vm_new();
+    ToyVM *register_vm = vm_new();
+    register_vm->backend = VM_BACKEND_REGISTER;
+    for (int i = 0; i < 26; i++) {
+        stack_vm->vars[i] = i + 3;  // Unknown to the compiler; nothing folds
+        register_vm->vars[i] = i + 3;
+    }
+    interpret(stack_vm, program);
+    interpret(register_vm, program);
+    assertTrue(register_vm->rcode != NULL, "Program should translate to register code");
+    assertEquals(6, register_vm->rcode_count, "Five statements plus HALT");
+    assertEquals(ROP_ADD, register_vm->rcode[0].op, "c = a + b should be one ADD");
+    assertEquals(ROP_SUBI, register_vm->rcode[2].op, "d - 4 should be one SUBI");
+    assertTrue(memcmp(stack_vm->vars, register_vm->vars, sizeof(stack_vm->vars)) == 0,
+               "Both backends should leave the same variables");
+    vm_free(stack_vm);
+    vm_free(register_vm);
+}
+
+// @Test("Register translation uses temporaries and keeps pending reads")
+void test_register_translation_temporaries() {
+    /* b = 100 - a, then a = 1 while the old a is still on the stack for c */
+    static const int32_t program[][4] = {
+        {OP_PUSH, 100}, {OP_LOAD, 0}, {OP_SUB}, {OP_STORE, 1},
+        {OP_LOAD, 0}, {OP_PUSH, 1}, {OP_STORE, 0}, {OP_STORE, 2},
+        {OP_HALT},
+    };
+    int size;
+    char *bytecode = assemble(program, sizeof(program) / sizeof(program[0]), &size);
+    RegInsn *rcode;
+    int reg_count;
+    int count = reg_translate(bytecode, size, NULL, 0, &rcode, &reg_count);
+    free(bytecode);
+    assertTrue(count > 0, "Bytecode should translate");
+    assertTrue(reg_count > 26, "100 - a needs a temporary register");
+
+    ToyVM *vm = vm_new();
+    vm->backend = VM_BACKEND_REGISTER;
+    vm->rcode = rcode;
+    vm->rcode_count = count;
+    vm->reg_count = reg_count;
+    vm->vars[0] = 30;
+    vm_execute(vm);
+    assertEquals(70, vm->vars[1], "b should be 100 - 30");
+    assertEquals(1, vm->vars[0], "a should be 1");
+    assertEquals(30, vm->vars[2], "c should get a from before the store");
+    vm_free(vm);
+}
+
+// @Test("Wide constants load from the constant pool")
+void test_wide_constants() {
+    ToyVM *vm = vm_new();
+    interpret(vm, "a = 100000\nb = -70000\nc = b * 3 + a");
+    assertEquals(100000, vm->vars['a' - 'a'], "a should hold a constant wider than PUSH");
+    assertEquals(-70000, vm->vars['b' - 'a'], "b should hold a wide negative constant");
+    assertEquals(-110000, vm->vars['c' - 'a'], "c should be -70000 * 3 + 100000");
+
+    vm->vars['x' - 'a'] = 2;
+    assertEquals(0, toy_compile(vm, "d = x * 100000 + 100000"), "Program should compile");
+    assertEquals(1, vm->const_count, "A repeated constant should be pooled once");
+    VmInstruction insn;
+    vm_decode(vm->code, vm->code_size, 2, &insn);
+    assertEquals(OP_CONST, insn.op, "Wide constants should load with CONST");
+    vm_execute(vm);
+    assertEquals(300000, vm->vars['d' - 'a'], "d should be 2 * 100000 + 100000");
+
+    vm->backend = VM_BACKEND_REGISTER;
+    interpret(vm, "e = x * 100000 - 1");
+    assertEquals(199999, vm->vars['e' - 'a'], "The register backend should read pooled constants");
+    vm_free(vm);
+}
+
+// @Test("Varint operands round trip at width boundaries")
+void test_varint_boundaries() {
+    static const int32_t values[] = {0, -1, 1, 63, -64, 64, 8191, -8192, 8192,
+                                     2147483647, -2147483647 - 1};
+    static const int lengths[] = {1, 1, 1, 1, 1, 2, 2, 2, 3, 5, 5};
+    for (int i = 0; i < (int)(sizeof(values) / sizeof(values[0])); i++) {
+        char code[16 + VM_CODE_PADDING] = {0};
+        int32_t args[3] = {25, values[i], 0};
+        int size = vm_encode(code, OP_STORE_IMM, args);
+        assertEquals(2 + lengths[i], size, "Immediate should take the expected number of bytes");
+
+        VmInstruction insn;
+        assertEquals(size, vm_decode(code, size, 0, &insn), "Checked decoder should read the whole instruction");
+        assertEquals(values[i], insn.args[1], "Checked decoder should return the immediate");
+
+        int ip = 1;
+        assertEquals(25, (int)vm_read_uint(code, &ip), "VM decoder should read the slot");
+        assertEquals(values[i], vm_read_int(code, &ip), "VM decoder should read the immediate");
+        assertEquals(size, ip, "VM decoder should step past the instruction");
+    }
+}
+
+// @Test("Saved bytecode loads and runs the same")
+void test_bytecode_round_trip() {
+    const char *program = "a = 7\nb = a * 100000\nc = b - 123456 / a\nprint c";
+    ToyVM *compiled = vm_new();
+    assertEquals(0, toy_compile(compiled, program), "Program should compile");
+    char *image;
+    int image_size;
+    assertEquals(0, vm_save_bytecode(compiled, &image, &image_size), "Bytecode should save");
+    assertTrue(memcmp(image, TOYVM_BYTECODE_MAGIC, 4) == 0, "Image should start with the magic");
+
+    ToyVM *loaded = vm_new();
+    loaded->backend = VM_BACKEND_REGISTER;
+    assertEquals(0, vm_load_bytecode(loaded, image, image_size), "Bytecode should load");
+    assertEquals(compiled->code_size, loaded->code_size, "Code should load unchanged");
+    assertEquals(compiled->const_count, loaded->const_count, "Pool should load unchanged");
+    assertTrue(loaded->rcode != NULL, "Loaded code should translate for the register backend");
+    vm_execute(compiled);
+    vm_execute(loaded);
+    assertTrue(memcmp(compiled->vars, loaded->vars, sizeof(compiled->vars)) == 0,
+               "Loaded bytecode should leave the same variables");
+    assertEquals(682364, loaded->vars['c' - 'a'], "c should be 700000 - 123456 / 7");
+    free(image);
+    vm_free(compiled);
+    vm_free(loaded);
+}
+
+// @Test("Bytecode loader rejects bad images")
+void test_bytecode_rejects_bad_images() {
+    ToyVM *vm = vm_new();
+    interpret(vm, "a = 5");
+    char *image;
+    int image_size;
+    vm_save_bytecode(vm, &image, &image_size);
+
+    image[0] = 'X';
+    assertEquals(1, vm_load_bytecode(vm, image, image_size), "Wrong magic should be rejected");
+    image[0] = 'T';
+    image[4] = 1;
+    assertEquals(1, vm_load_bytecode(vm, image, image_size), "Old versions should be rejected");
+    image[4] = TOYVM_BYTECODE_VERSION;
+    assertEquals(1, vm_load_bytecode(vm, image, image_size - 1), "Truncated code should be rejected");
+    image[TOYVM_BYTECODE_HEADER_SIZE] ^= 1;
+    assertEquals(1, vm_load_bytecode(vm, image, image_size), "A flipped bit should fail the checksum");
+    free(image);
+
+    /* LOAD of slot 30 is well-formed but unsafe */
+    static const int32_t program[][4] = {{OP_LOAD, 30}, {OP_PRINT}, {OP_HALT}};
+    int size;
+    char *code = assemble(program, 3, &size);
+    assertEquals(1, vm_verify(code, size, 0), "Out-of-range slots should fail verification");
+    vm_set_program(vm, code, size, NULL, 0);
+    vm_save_bytecode(vm, &image, &image_size);
+    assertEquals(1, vm_load_bytecode(vm, image, image_size), "Unverifiable code should be rejected");
+    free(image);
+
+    static const int32_t underflow[][4] = {{OP_ADD}, {OP_HALT}};
+    code = assemble(underflow, 2, &size);
+    assertEquals(1, vm_verify(code, size, 0), "Stack underflow should fail verification");
+    free(code);
+    vm_free(vm);
+}
+
+// @Test("Compiled bytecode files run in place from a mapping")
+void test_bytecode_file_mapping() {
+    char path[] = "/tmp/toyvm_test_XXXXXX";
+    int fd = mkstemp(path);
+    assertTrue(fd >= 0, "Should create a temporary file");
+    close(fd);
+
+    ToyVM *compiled = vm_new();
+    interpret(compiled, "a = 250000\nb = a / 3 - 7\nprint b");
+    assertEquals(0, vm_save_bytecode_file(compiled, path), "Bytecode file should save");
+    assertTrue(vm_is_bytecode_file(path), "Saved file should be recognized as bytecode");
+
+    ToyVM *mapped = vm_new();
+    assertEquals(0, vm_map_bytecode_file(mapped, path), "Bytecode file should map");
+    assertTrue(mapped->mapping != NULL, "Program should run from the mapping");
+    assertTrue(mapped->code > (char *)mapped->mapping &&
+               mapped->code < (char *)mapped->mapping + mapped->mapping_size,
+               "Code should point into the mapped file");
+    vm_execute(mapped);
+    assertTrue(memcmp(compiled->vars, mapped->vars, sizeof(compiled->vars)) == 0,
+               "Mapped bytecode should leave the same variables");
+    interpret(mapped, "c = b + 1");
+    assertTrue(mapped->mapping == NULL, "Compiling a new program should unmap the file");
+    assertEquals(83327, mapped->vars['c' - 'a'], "c should be 250000 / 3 - 7 + 1");
+
+    FILE *file = fopen(path, "r+b");
+    fseek(file, -VM_CODE_PADDING - 1, SEEK_END);  // The final HALT
+    fputc(OP_PRINT, file);
+    fclose(file);
+    assertEquals(1, vm_map_bytecode_file(mapped, path), "A modified file should fail the checksum");
+    file = fopen(path, "w");
+    fputs("a = 1\n", file);
+    fclose(file);
+    assertEquals(0, vm_is_bytecode_file(path), "Source files are not bytecode");
+    remove(path);
+    vm_free(compiled);
+    vm_free(mapped);
+}
+
+/* Writes source to a temporary file and streams it into vm */
+static int stream_source(ToyVM *vm, const char *source) {
+    FILE *input = tmpfile();
+    fputs(source, input);
+    rewind(input);
+    int result = interpret_stream(vm, input);
+    fclose(input);
+    return result;
+}
+
+// @Test("Streaming matches whole-file execution across chunk boundaries")
+void test_stream_matches_whole_file() {
+    /* About four chunks; statements span lines and comments get cut */
+    size_t capacity = 4 * STREAM_CHUNK_SIZE + 256;
+    char *source = malloc(capacity);
+    size_t length = 0;
+    for (int i = 0; length < 4 * STREAM_CHUNK_SIZE; i++) {
+        length += sprintf(source + length, "%c = %c +\n  (%d * 3)\n# comment %d\n%c - 1000000 / 7\n",
+                          'a' + i % 26, 'a' + (i + 1) % 26, i % 1000, i, 'a' + (i + 5) % 26);
+    }
+
+    ToyVM *whole = vm_new();
+    ToyVM *streamed = vm_new();
+    interpret(whole, source);
+    assertEquals(0, stream_source(streamed, source), "Streaming should succeed");
+    assertTrue(memcmp(whole->vars, streamed->vars, sizeof(whole->vars)) == 0,
+               "Streaming should leave the same variables");
+    vm_free(whole);
+    vm_free(streamed);
+    free(source);
+}
+
+// @Test("Streaming stops at errors")
+void test_stream_stops_at_errors() {
+    size_t capacity = 2 * STREAM_CHUNK_SIZE + 256;
+    char *source = malloc(capacity);
+    size_t length = 0;
+    while (length < 2 * STREAM_CHUNK_SIZE) length += sprintf(source + length, "a + 1\n");
+    strcpy(source + length, "b = (a\nc = 1\n");
+
+    ToyVM *vm = vm_new();
+    assertEquals(1, stream_source(vm, source), "A syntax error in a later chunk should fail");
+    assertTrue(vm->vars['a' - 'a'] > 0, "Chunks before the error should have run");
+    assertEquals(0, vm->vars['c' - 'a'], "Nothing after the error should run");
+
+    memset(vm->vars, 0, sizeof(vm->vars));
+    assertEquals(1, stream_source(vm, "a = 5\nb = a / c\nd = 1\n"), "Division by zero should fail");
+    assertEquals(5, vm->vars['a' - 'a'], "a should be set before the division");
+    assertEquals(0, vm->vars['d' - 'a'], "Nothing after the division should run");
+    assertEquals(0, stream_source(vm, ""), "Empty input should succeed");
+    vm_free(vm);
+    free(source);
+}
+
+/* Runs source on a fresh VM with the given backend, starting from vars
+ * (26 values), and leaves its variables there; stdout is captured into
+ * output (NUL-terminated, truncated to size) */
+static void run_captured(const char *source, VmBackend backend, int *vars, char *output, size_t size) {
+    ToyVM *vm = vm_new();
+    vm->backend = backend;
+    memcpy(vm->vars, vars, sizeof(vm->vars));
+
+    fflush(stdout);
+    FILE *capture = tmpfile();
+    int saved_stdout = dup(STDOUT_FILENO);
+    dup2(fileno(capture), STDOUT_FILENO);
+    interpret(vm, source);
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    rewind(capture);
+    size_t length = fread(output, 1, size - 1, capture);
+    output[length] = '\0';
+    fclose(capture);
+    memcpy(vars, vm->vars, sizeof(vm->vars));
+    vm_free(vm);
+}
+
+/* Runs source through every backend and asserts they agree with the stack VM */
+static void assert_backends_agree(const char *source, const int *initial, const char *name) {
+    static char expected_output[65536], output[65536];
+    int expected[26], vars[26];
+    memcpy(expected, initial, sizeof(expected));
+    run_captured(source, VM_BACKEND_STACK, expected, expected_output, sizeof(expected_output));
+
+    const VmBackend backends[] = {VM_BACKEND_REGISTER, VM_BACKEND_JIT};
+    for (int b = 0; b < 2; b++) {
+        memcpy(vars, initial, sizeof(vars));
+        run_captured(source, backends[b], vars, output, sizeof(output));
+        if (memcmp(expected, vars, sizeof(vars)) != 0 || strcmp(expected_output, output) != 0) {
+            fprintf(stderr, "%s: %s backend differs from the stack VM\n", name,
+                    backends[b] == VM_BACKEND_JIT ? "jit" : "register");
+        }
+        assertTrue(memcmp(expected, vars, sizeof(vars)) == 0, "Backends should leave the same variables");
+        assertStringEquals(expected_output, output, "Backends should print the same output");
+    }
+}
+
+// @Test("Division of INT_MIN by -1 wraps")
+void test_division_overflow_wraps() {
+    /* a = INT_MIN and b = -1 are unknown to the compiler, so every division
+     * form runs: DIV_VV_STORE, DIV and DIV_VAR_IMM (ROP_DIV and ROP_DIVI) */
+    const char *program = "c = a / b\nprint(a / b)\nd = a\nd / (0 - 1)\ne = 0 - 7\ne = e / b";
+    const VmBackend backends[] = {VM_BACKEND_STACK, VM_BACKEND_REGISTER, VM_BACKEND_JIT};
+    for (int b = 0; b < 3; b++) {
+        int vars[26] = {INT32_MIN, -1};
+        char output[256];
+        run_captured(program, backends[b], vars, output, sizeof(output));
+        assertEquals(INT32_MIN, vars['c' - 'a'], "c = INT_MIN / -1 should wrap to INT_MIN");
+        assertEquals(INT32_MIN, vars['d' - 'a'], "d / -1 should wrap to INT_MIN");
+        assertEquals(7, vars['e' - 'a'], "-7 / -1 should still be 7");
+        assertTrue(strstr(output, "-2147483648") != NULL, "print(a / b) should print INT_MIN");
+    }
+}
+
+/* Parentheses in "x = (a + (a + ... a))" that leave a value held on every
+ * stack slot but one while the innermost a loads */
+#define MAX_HELD ((int)(sizeof(((ToyVM *)0)->stack) / sizeof(int)) - 1)
+
+/* Writes "x = (a + (a + ... a))" with levels parentheses into source */
+static void nested_sum(char *source, int levels) {
+    char *at = source + sprintf(source, "x = ");
+    for (int i = 0; i < levels; i++) at += sprintf(at, "(a + ");
+    at += sprintf(at, "a");
+    for (int i = 0; i < levels; i++) *at++ = ')';
+    *at = '\0';
+}
+
+// @Test("Compile rejects expressions nested deeper than the VM stack")
+void test_compile_nesting_limit() {
+    static char source[4096];
+    const VmBackend backends[] = {VM_BACKEND_STACK, VM_BACKEND_REGISTER, VM_BACKEND_JIT};
+    nested_sum(source, MAX_HELD);
+    for (int b = 0; b < 3; b++) {
+        int vars[26] = {1};
+        char output[64];
+        run_captured(source, backends[b], vars, output, sizeof(output));
+        assertEquals(MAX_HELD + 1, vars['x' - 'a'], "Nesting that fills the stack should run on every backend");
+    }
+    ToyVM *vm = vm_new();
+    nested_sum(source, MAX_HELD + 1);
+    fflush(stderr);
+    FILE *capture = tmpfile();
+    int saved_stderr = dup(STDERR_FILENO);
+    dup2(fileno(capture), STDERR_FILENO);
+    int status = toy_compile(vm, source);
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    char message[256];
+    rewind(capture);
+    size_t length = fread(message, 1, sizeof(message) - 1, capture);
+    message[length] = '\0';
+    fclose(capture);
+    assertEquals(1, status, "One more level should overflow the stack and be a syntax error");
+    assertTrue(strstr(message, "expression too deep") != NULL, "The error should say the expression is too deep");
+    vm_free(vm);
+}
+
+// @Test("Negating INT_MIN folds to the value it has at run time")
+void test_negate_int_min_fold() {
+    const VmBackend backends[] = {VM_BACKEND_STACK, VM_BACKEND_REGISTER, VM_BACKEND_JIT};
+    for (int b = 0; b < 3; b++) {
+        int vars[26] = {INT32_MIN};
+        char folded[64], runtime[64];
+        run_captured("print -(0 - 2147483647 - 1) / 2", backends[b], vars, folded, sizeof(folded));
+        run_captured("print -a / 2", backends[b], vars, runtime, sizeof(runtime));
+        assertTrue(strstr(folded, "-1073741824") != NULL, "-(INT_MIN) should wrap to INT_MIN before halving");
+        assertStringEquals(runtime, folded, "Constant and variable operands should agree");
+    }
+}
+
+// @Test("Addition subtraction and multiplication overflow wraps")
+void test_arithmetic_overflow_wraps() {
+    /* a = INT_MAX and b = INT_MIN are unknown to the compiler: the statements
+     * run as ADD/SUB_VV_STORE, MUL, INC/DEC_VAR_IMM and MUL_VAR_IMM */
+    const char *program = "c = a + a\nd = b - a\nprint(a * b)\ne = a\ne + 1\nf = b\nf - 2\ng = a\ng * 3";
+    const VmBackend backends[] = {VM_BACKEND_STACK, VM_BACKEND_REGISTER, VM_BACKEND_JIT};
+    for (int b = 0; b < 3; b++) {
+        int vars[26] = {INT32_MAX, INT32_MIN};
+        char output[256];
+        run_captured(program, backends[b], vars, output, sizeof(output));
+        assertEquals(-2, vars['c' - 'a'], "INT_MAX + INT_MAX should wrap to -2");
+        assertEquals(1, vars['d' - 'a'], "INT_MIN - INT_MAX should wrap to 1");
+        assertEquals(INT32_MIN, vars['e' - 'a'], "INT_MAX + 1 should wrap to INT_MIN");
+        assertEquals(INT32_MAX - 1, vars['f' - 'a'], "INT_MIN - 2 should wrap to INT_MAX - 1");
+        assertEquals(INT32_MAX - 2, vars['g' - 'a'], "INT_MAX * 3 should wrap to INT_MAX - 2");
+        assertTrue(strstr(output, "-2147483648") != NULL, "print(a * b) should print INT_MIN");
+    }
+}
+
+// @Test("JIT compiles bytecode to native code")
+void test_jit_compiles_bytecode() {
+    ToyVM *vm = vm_new();
+    vm->backend = VM_BACKEND_JIT;
+    const int32_t program[][4] = {
+        {OP_PUSH, 40}, {OP_STORE, 0}, {OP_LOAD, 0}, {OP_PUSH, 2}, {OP_ADD}, {OP_STORE, 1},
+        {OP_LOAD, 1}, {OP_LOAD, 0}, {OP_SUB}, {OP_PUSH, -3}, {OP_MUL}, {OP_STORE, 2},
+        {OP_CONST, 0}, {OP_LOAD, 0}, {OP_DIV}, {OP_STORE, 3}, {OP_PUSH, 9}, {OP_HALT},
+    };
+    int size;
+    char *code = assemble(program, 18, &size);
+    int32_t *consts = malloc(sizeof(int32_t));
+    consts[0] = 1 << 20;
+    vm_set_program(vm, code, size, consts, 1);
+    assertEquals(vm_has_jit(), vm->jit_code != NULL, "Supported platforms should compile to native code");
+
+    vm_execute(vm);
+    assertEquals(40, vm->vars[0], "a = 40");
+    assertEquals(42, vm->vars[1], "b = a + 2");
+    assertEquals(-6, vm->vars[2], "c = (b - a) * -3");
+    assertEquals((1 << 20) / 40, vm->vars[3], "d = 1048576 / a from the constant pool");
+    assertEquals(size, vm->ip, "A finished run should stop at the end of the bytecode");
+    assertEquals(0, vm->sp, "The operand stack should be dropped");
+
+    vm_execute(vm);  // Native code reruns like bytecode
+    assertEquals(42, vm->vars[1], "A second run should give the same result");
+    vm_free(vm);
+}
+
+// @Test("JIT stops at division by zero")
+void test_jit_division_by_zero() {
+    const char *programs[] = {"a = 5\nb = a / c\nd = 1", "a = 5\na = a / 0\nd = 1", "a = 5\nb = a - 5\nc = 7 / (a - 5)\nd = 1"};
+    for (int i = 0; i < 3; i++) {
+        ToyVM *vm = vm_new();
+        vm->backend = VM_BACKEND_JIT;
+        interpret(vm, programs[i]);
+        assertEquals(5, vm->vars['a' - 'a'], "Statements before the division should run");
+        assertEquals(0, vm->vars['d' - 'a'], "Nothing after the division should run");
+        assertTrue(vm->ip != vm->code_size, "The run should not count as reaching HALT");
+
+        interpret(vm, "d = 6 / 3");  // The VM stays usable
+        assertEquals(2, vm->vars['d' - 'a'], "Division should work after an error");
+        vm_free(vm);
+    }
+}
+
+/* Calls check with the path and source of every .toy sample in tests/
+ * Returns: number of samples
+ */
+static int for_each_sample(void (*check)(const char *path, const char *source)) {
+    DIR *dir = opendir("tests");
+    if (!dir) return 0;
+    int samples = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (length < 4 || strcmp(entry->d_name + length - 4, ".toy") != 0) continue;
+
+        char path[512];
+        snprintf(path, sizeof(path), "tests/%s", entry->d_name);
+        FILE *file = fopen(path, "rb");
+        if (!file) continue;
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        rewind(file);
+        char *source = malloc(size + 1);
+        source[fread(source, 1, size, file)] = '\0';
+        fclose(file);
+
+        check(path, source);
+        free(source);
+        samples++;
+    }
+    closedir(dir);
+    return samples;
+}
+
+static void check_backends_agree(const char *path, const char *source) {
+    int initial[26] = {0};
+    assert_backends_agree(source, initial, path);
+}
+
+// @Test("Every sample program runs the same on every backend")
+void test_samples_differential() {
+    assertTrue(for_each_sample(check_backends_agree) > 0, "There should be sample programs to compare");
+}
+
+// @Test("Random programs run the same on every backend")
+void test_random_differential() {
+    static char source[8192];
+    unsigned int seed = 12345;  // Fixed, so failures reproduce
+    for (int round = 0; round < 200; round++) {
+        int initial[26];
+        for (int v = 0; v < 26; v++) {
+            seed = seed * 1103515245 + 12345;
+            initial[v] = (seed >> 16) % 8 == 0 ? INT32_MIN : (int)(seed >> 16) % 2001 - 1000;
+        }
+
+        size_t length = 0;
+        for (int line = 0; line < 40; line++) {
+            seed = seed * 1103515245 + 12345;
+            unsigned int r = seed >> 8;  // 24 bits: operands
+            seed = seed * 1103515245 + 12345;
+            unsigned int form = seed >> 16;  // 16 bits: statement shape and divisor
+            char dest = 'a' + r % 26, lhs = 'a' + (r >> 5) % 26, rhs = 'a' + (r >> 10) % 26;
+            int k = (int)((r >> 15) % 19) - 9;
+            /* Divisors are non-zero constants, so no program stops early; -1
+             * meets the INT_MIN values and must wrap the same everywhere */
+            int divisor = (form >> 3) % 9 == 0 ? -1 : 2 + (int)((form >> 3) % 8);
+            switch (form % 8) {
+                case 0: length += sprintf(source + length, "%c = %d\n", dest, k); break;
+                case 1: length += sprintf(source + length, "%c = %c + %c\n", dest, lhs, rhs); break;
+                case 2: length += sprintf(source + length, "%c = %c - %c * %d\n", dest, lhs, rhs, k); break;
+                case 3: length += sprintf(source + length, "%c = %c / %d\n", dest, dest, divisor); break;
+                case 4: length += sprintf(source + length, "%c = (%c + %d) * (%c - %c)\n", dest, lhs, k, rhs, dest); break;
+                case 5: length += sprintf(source + length, "print(%c)\n", lhs); break;
+                case 6: length += sprintf(source + length, "print(%c * %d + %c / %d)\n", lhs, k, rhs, divisor); break;
+                default: length += sprintf(source + length, "%c - %c\n", lhs, rhs); break;
+            }
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "random program %d", round);
+        assert_backends_agree(source, initial, name);
+    }
+}
+
+// @Test("Emitted C is straight-line code over vars")
+void test_emit_c_output() {
+    ToyVM *vm = vm_new();
+    toy_compile(vm, "c = a + b\nd = c / e\nf = 2147483647 * -1 - 1\nprint(f)");
+    char text[4096];
+    FILE *out = fmemopen(text, sizeof(text), "w");
+    assertEquals(0, vm_emit_c(vm, "run_it", out), "Verified bytecode should emit");
+    fclose(out);
+
+    assertTrue(strstr(text, "int run_it(int vars[26]) {") != NULL, "The function should take the variables");
+    assertTrue(strstr(text, "vars[2] = TOY_ADD(vars[0], vars[1]);") != NULL, "c = a + b should be one statement");
+    assertTrue(strstr(text, "if (vars[4] == 0) goto division_by_zero;") != NULL, "d = c / e should check e");
+    assertTrue(strstr(text, "vars[3] = TOY_DIV(vars[2], vars[4]);") != NULL, "d = c / e should wrap on INT_MIN / -1");
+    assertTrue(strstr(text, "vars[5] = (-2147483647 - 1);") != NULL, "INT_MIN should be written as an expression");
+    assertTrue(strstr(text, "#ifdef TOY_MAIN") != NULL, "A standalone main should be available");
+
+    vm->code[vm->code_size - 1] = OP_ADD;  // No HALT, and a stack underflow
+    out = fmemopen(text, sizeof(text), "w");
+    assertEquals(-1, vm_emit_c(vm, "run_it", out), "Bytecode that fails vm_verify should not emit");
+    fclose(out);
+    vm_free(vm);
+}
+
+/* Emits source as C, builds it with gcc -O2 and a driver that starts it
+ * from initial (26 values) and prints the variables after the program's own
+ * output, and runs it. The driver is a separate translation unit, so gcc
+ * can't fold the initial values into the program.
+ * Returns: the program's exit status, or -1 if it could not be built
+ */
+static int run_emitted_c(const char *source, const int *initial, char *output, size_t size) {
+    char dir[] = "/tmp/toyvm_emit_XXXXXX";
+    if (!mkdtemp(dir)) return -1;
+    char program_path[64], driver_path[64], binary_path[64], command[256];
+    snprintf(program_path, sizeof(program_path), "%s/program.c", dir);
+    snprintf(driver_path, sizeof(driver_path), "%s/driver.c", dir);
+    snprintf(binary_path, sizeof(binary_path), "%s/program", dir);
+
+    ToyVM *vm = vm_new();
+    int status = toy_compile(vm, source) == 0 ? 0 : -1;
+    FILE *program = fopen(program_path, "w");
+    if (status == 0 && vm_emit_c(vm, "toy_program", program) != 0) status = -1;
+    fclose(program);
+    vm_free(vm);
+
+    FILE *driver = fopen(driver_path, "w");
+    fputs("#include <stdio.h>\n"
+          "int toy_program(int vars[26]);\n"
+          "int main(void) {\n"
+          "    int vars[26] = {", driver);
+    for (int i = 0; i < 26; i++) fprintf(driver, "%s%d", i ? ", " : "", initial[i]);
+    fputs("};\n"
+          "    int status = toy_program(vars);\n"
+          "    for (int i = 0; i < 26; i++) printf(\"%d \", vars[i]);\n"
+          "    return status;\n"
+          "}\n", driver);
+    fclose(driver);
+
+    snprintf(command, sizeof(command), "gcc -O2 -Wall -Werror -o %s %s %s", binary_path, program_path, driver_path);
+    if (status == 0 && system(command) != 0) status = -1;
+    if (status == 0) {
+        FILE *run = popen(binary_path, "r");
+        size_t length = fread(output, 1, size - 1, run);
+        output[length] = '\0';
+        int exit_status = pclose(run);
+        status = WIFEXITED(exit_status) ? WEXITSTATUS(exit_status) : -1;
+    }
+
+    remove(program_path);
+    remove(driver_path);
+    remove(binary_path);
+    rmdir(dir);
+    return status;
+}
+
+/* What run_emitted_c should print: the VM's output, then its variables */
+static void expected_emitted_output(const char *source, const int *initial, char *output, size_t size) {
+    int vars[26];
+    memcpy(vars, initial, sizeof(vars));
+    run_captured(source, VM_BACKEND_STACK, vars, output, size);
+    size_t length = strlen(output);
+    for (int i = 0; i < 26; i++) length += snprintf(output + length, size - length, "%d ", vars[i]);
+}
+
+static void check_emitted_c(const char *path, const char *source) {
+    static char expected[65536], output[65536];
+    int initial[26] = {0};
+    expected_emitted_output(source, initial, expected, sizeof(expected));
+    int status = run_emitted_c(source, initial, output, sizeof(output));
+    if (status != 0 || strcmp(expected, output) != 0) fprintf(stderr, "%s: emitted C differs from vm_execute\n", path);
+    assertEquals(0, status, "Emitted C should build and run");
+    assertStringEquals(expected, output, "Emitted C should print and store what vm_execute does");
+}
+
+// @Test("Every sample program compiled to C matches vm_execute")
+void test_emit_c_samples() {
+    assertTrue(for_each_sample(check_emitted_c) > 0, "There should be sample programs to compare");
+
+    /* Wrapping arithmetic, pooled constants and a division by zero that stops the program */
+    static char expected[4096], output[4096];
+    int zeroed[26] = {0};
+    const char *program = "a = 2147483647\nb = a + 1\nc = b * 3 - a\nd = 100000000 / 7\nprint(d)\ne = d / f\ng = 1";
+    expected_emitted_output(program, zeroed, expected, sizeof(expected));
+    assertEquals(1, run_emitted_c(program, zeroed, output, sizeof(output)), "Division by zero should return 1");
+    assertStringEquals(expected, output, "Stores before the division should match vm_execute");
+
+    /* INT_MIN / -1 through DIV_VV_STORE, DIV and DIV_VAR_IMM, on values gcc can't see */
+    int overflowing[26] = {INT32_MIN, -1};
+    program = "c = a / b\nprint(a / b)\nd = a\nd / -1";
+    expected_emitted_output(program, overflowing, expected, sizeof(expected));
+    assertEquals(0, run_emitted_c(program, overflowing, output, sizeof(output)), "INT_MIN / -1 should not stop the program");
+    assertStringEquals(expected, output, "INT_MIN / -1 should wrap as in vm_execute");
+}
+
 // @Disable("Test VM failure case not implemented yet")
 // @Test("VM invalid opcode")
 void test_vm_invalid_opcode() {
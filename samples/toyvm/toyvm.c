@@ -1,14 +1,20 @@
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "toyvm.h"
 
 // Global debug flag
 static int debug = 0;
 
-// ANSI color codes
-#define COLOR_GREY "\033[90m"  // Bright black (grey-ish)
-#define COLOR_RESET "\033[0m"
+// Peephole optimization of compiled bytecode (--no-opt turns it off)
+static int optimize = 1;
 
 // Debugging helper to print tokens
 static const char *token_type_str(TokenType type) {
@@ -20,6 +26,8 @@ static const char *token_type_str(TokenType type) {
         case TOKEN_MINUS: return "MINUS";
         case TOKEN_MULTIPLY: return "MULTIPLY";
         case TOKEN_DIVIDE: return "DIVIDE";
+        case TOKEN_LPAREN: return "LPAREN";
+        case TOKEN_RPAREN: return "RPAREN";
         case TOKEN_PRINT: return "PRINT";
         case TOKEN_EOF: return "EOF";
         case TOKEN_ERROR: return "ERROR";
@@ -27,77 +35,84 @@ static const char *token_type_str(TokenType type) {
     }
 }
 
-/* Tokenizer implementation */
-Token *tokenize(const char *source, int *token_count) {
-    Token *tokens = malloc(sizeof(Token) * 256);  // Max 256 tokens for simplicity
+/* Character classes for the tokenizer, one table lookup per character */
+#define CHAR_SPACE 1
+#define CHAR_NEWLINE 2
+#define CHAR_DIGIT 4
+#define CHAR_LETTER 8
+
+static unsigned char char_class[256];
+
+static void init_char_classes(void) {
+    char_class[' '] = char_class['\t'] = char_class['\r'] = CHAR_SPACE;
+    char_class['\n'] = CHAR_SPACE | CHAR_NEWLINE;
+    for (int c = '0'; c <= '9'; c++) char_class[c] = CHAR_DIGIT;
+    for (int c = 'a'; c <= 'z'; c++) char_class[c] = CHAR_LETTER;
+    for (int c = 'A'; c <= 'Z'; c++) char_class[c] = CHAR_LETTER;
+}
+
+#define CLASS_OF(c) char_class[(unsigned char)(c)]
+
+/* Tokenizer implementation; line numbers start at first_line */
+static Token *tokenize_from(Arena *arena, const char *source, int first_line, int *token_count) {
+    if (!CLASS_OF(' ')) init_char_classes();
+    int capacity = 64;
+    Token *tokens = arena_alloc(arena, sizeof(Token) * capacity);
     int count = 0;
+    int line = first_line;
     const char *p = source;
 
     if (debug) printf("Tokenizing: '%s'\n", source);
-    while (*p && count < 256) {
-        while (*p == ' ' || *p == '\n' || *p == '\t') p++;  // Skip whitespace
+    for (;;) {
+        while (CLASS_OF(*p) & CHAR_SPACE) {  // Skip whitespace
+            if (*p == '\n') line++;
+            p++;
+        }
         if (*p == '\0') break;
+        if (*p == '#') {
+            while (*p && *p != '\n') p++;  // Skip comments
+            continue;
+        }
+        if (count + 1 == capacity) {  // Keep room for EOF
+            tokens = arena_grow(arena, tokens, sizeof(Token) * capacity, sizeof(Token) * capacity * 2);
+            capacity *= 2;
+        }
 
-        tokens[count].value = NULL;
-        if (*p >= '0' && *p <= '9') {
-            const char *start = p;
-            while (*p >= '0' && *p <= '9') p++;
-            int len = p - start;
-            tokens[count].type = TOKEN_NUMBER;
-            tokens[count].value = strndup(start, len);
-            tokens[count].length = len;
-        } else if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) {
-            const char *start = p;
-            while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) p++;
-            int len = p - start;
-            if (len == 5 && strncmp(start, "print", 5) == 0) {
-                tokens[count].type = TOKEN_PRINT;
+        const char *start = p;
+        Token *token = &tokens[count];
+        if (CLASS_OF(*p) & CHAR_DIGIT) {
+            while (CLASS_OF(*p) & CHAR_DIGIT) p++;
+            token->type = TOKEN_NUMBER;
+        } else if (CLASS_OF(*p) & CHAR_LETTER) {
+            while (CLASS_OF(*p) & CHAR_LETTER) p++;
+            if (p - start == 5 && memcmp(start, "print", 5) == 0) {
+                token->type = TOKEN_PRINT;
             } else {
-                tokens[count].type = TOKEN_IDENTIFIER;
+                token->type = TOKEN_IDENTIFIER;
             }
-            tokens[count].value = strndup(start, len);
-            tokens[count].length = len;
-            // Skip optional parentheses
-            if (*p == '(' || *p == ')') p++;
-        } else if (*p == '=') {
-            tokens[count].type = TOKEN_EQUALS;
-            tokens[count].value = strndup(p, 1);
-            tokens[count].length = 1;
-            p++;
-        } else if (*p == '+') {
-            tokens[count].type = TOKEN_PLUS;
-            tokens[count].value = strndup(p, 1);
-            tokens[count].length = 1;
-            p++;
-        } else if (*p == '-') {
-            tokens[count].type = TOKEN_MINUS;
-            tokens[count].value = strndup(p, 1);
-            tokens[count].length = 1;
-            p++;
-        } else if (*p == '*') {
-            tokens[count].type = TOKEN_MULTIPLY;
-            tokens[count].value = strndup(p, 1);
-            tokens[count].length = 1;
-            p++;
-        } else if (*p == '/') {
-            tokens[count].type = TOKEN_DIVIDE;
-            tokens[count].value = strndup(p, 1);
-            tokens[count].length = 1;
-            p++;
-        } else if (*p == '#') {
-            while (*p && *p != '\n') p++;  // Skip comments
-            continue;
         } else {
-            p++;  // Skip unrecognized characters
-            continue;
+            switch (*p++) {
+                case '=': token->type = TOKEN_EQUALS; break;
+                case '+': token->type = TOKEN_PLUS; break;
+                case '-': token->type = TOKEN_MINUS; break;
+                case '*': token->type = TOKEN_MULTIPLY; break;
+                case '/': token->type = TOKEN_DIVIDE; break;
+                case '(': token->type = TOKEN_LPAREN; break;
+                case ')': token->type = TOKEN_RPAREN; break;
+                default: token->type = TOKEN_ERROR; break;  // The compiler reports it
+            }
         }
-        if (debug) printf("Token %d: type=%s, value='%s'\n", count, token_type_str(tokens[count].type), tokens[count].value ? tokens[count].value : "");
+        token->offset = (int)(start - source);
+        token->length = (int)(p - start);
+        token->line = line;
+        if (debug) printf("Token %d: type=%s, value='%.*s'\n", count, token_type_str(token->type), token->length, start);
         count++;
     }
 
     tokens[count].type = TOKEN_EOF;
-    tokens[count].value = NULL;
+    tokens[count].offset = (int)(p - source);
     tokens[count].length = 0;
+    tokens[count].line = line;
     if (debug) printf("Token %d: type=TOKEN_EOF\n", count);
     count++;
 
@@ -105,131 +120,419 @@ Token *tokenize(const char *source, int *token_count) {
     return tokens;
 }
 
-void free_tokens(Token *tokens, int token_count) {
-    for (int i = 0; i < token_count; i++) {
-        if (tokens[i].value) {
-            free(tokens[i].value);
+Token *tokenize(Arena *arena, const char *source, int *token_count) {
+    return tokenize_from(arena, source, 1, token_count);
+}
+
+/* Compiler: a Pratt parser from tokens straight to stack bytecode
+ *
+ * Grammar (newlines are not significant; a statement ends where its
+ * expression cannot continue):
+ *   statement  := 'print' expression
+ *               | variable '=' expression
+ *               | variable operator ...   (`x * 2 + 1` means x = x * 2 + 1)
+ *   expression := number | variable | '(' expression ')' | '-' expression
+ *               | expression ('+' | '-' | '*' | '/') expression
+ *
+ * '*' and '/' bind tighter than '+' and '-'; all four are left-associative.
+ * A constant operand is not emitted until an operator needs it, so
+ * operators on two constants fold at compile time. Division by zero is
+ * left for the VM to report; nesting that would need more values than the
+ * VM's stack holds is a syntax error. Small constants are PUSH immediates;
+ * the rest go into the program's constant pool once each and load with CONST.
+ */
+
+/* Constants PUSH carries in a one- or two-byte operand */
+#define PUSH_MIN (-8192)
+#define PUSH_MAX 8191
+
+/* Values an expression may keep on the VM's stack at once */
+#define MAX_STACK_VALUES ((int)(sizeof(((ToyVM *)0)->stack) / sizeof(int)))
+
+/* Binding power of infix operators and of unary minus */
+#define PREC_NONE 0
+#define PREC_TERM 1    // + -
+#define PREC_FACTOR 2  // * /
+#define PREC_UNARY 3   // -x
+
+typedef struct {
+    const char *source;
+    const Token *tokens;
+    int pos;
+    char *code;
+    int size;
+    int capacity;
+    int32_t *consts;
+    int const_count;
+    int const_capacity;
+    int held;  // Values enclosing expressions keep on the stack while an operand runs
+    int failed;
+    const Token *error_token;  // Set with failed; reported by report_error
+    const char *error_message;
+} Compiler;
+
+/* Where to roll back to when a provisionally emitted constant folds */
+typedef struct {
+    int size;
+    int const_count;
+} CodeMark;
+
+/* Result of compiling an expression: either code already emitted, or a
+ * constant still waiting to be emitted */
+typedef struct {
+    int is_const;
+    long long value;
+} ExprResult;
+
+/* Emits op with at most one operand; the buffer always keeps room for
+ * VM_CODE_PADDING after the largest instruction */
+static void emit(Compiler *c, Opcode op, int32_t operand) {
+    if (c->size + 16 + VM_CODE_PADDING > c->capacity) {
+        c->capacity *= 2;
+        c->code = realloc(c->code, c->capacity);
+    }
+    int32_t args[3] = {operand, 0, 0};
+    c->size += vm_encode(c->code + c->size, op, args);
+}
+
+/* Returns: pool index of value, adding it if needed */
+static int add_constant(Compiler *c, int32_t value) {
+    for (int i = 0; i < c->const_count; i++) {
+        if (c->consts[i] == value) return i;
+    }
+    if (c->const_count == c->const_capacity) {
+        c->const_capacity = c->const_capacity ? c->const_capacity * 2 : 8;
+        c->consts = realloc(c->consts, sizeof(int32_t) * c->const_capacity);
+    }
+    c->consts[c->const_count] = value;
+    return c->const_count++;
+}
+
+static void emit_constant(Compiler *c, long long value) {
+    if (value >= PUSH_MIN && value <= PUSH_MAX) {
+        emit(c, OP_PUSH, (int32_t)value);
+    } else {
+        emit(c, OP_CONST, add_constant(c, (int32_t)value));
+    }
+}
+
+static CodeMark code_mark(const Compiler *c) {
+    return (CodeMark){c->size, c->const_count};
+}
+
+/* Drops code, and constants only that code used, emitted since mark */
+static void rollback(Compiler *c, CodeMark mark) {
+    c->size = mark.size;
+    c->const_count = mark.const_count;
+}
+
+static void materialize(Compiler *c, ExprResult result) {
+    if (result.is_const) emit_constant(c, result.value);
+}
+
+/* Records the first error; compile_source decides whether to report it */
+static void syntax_error(Compiler *c, const Token *token, const char *message) {
+    if (c->failed) return;
+    c->failed = 1;
+    c->error_token = token;
+    c->error_message = message;
+}
+
+static void report_error(const Compiler *c) {
+    const Token *token = c->error_token;
+    const char *message = c->error_message;
+    if (token->type == TOKEN_ERROR) message = "unexpected character";
+    if (token->type == TOKEN_EOF) {
+        fprintf(stderr, "Error: line %d: %s at end of input\n", token->line, message);
+    } else {
+        fprintf(stderr, "Error: line %d: %s at '%.*s'\n", token->line, message, token->length, c->source + token->offset);
+    }
+}
+
+static int infix_precedence(TokenType type) {
+    switch (type) {
+        case TOKEN_PLUS: case TOKEN_MINUS: return PREC_TERM;
+        case TOKEN_MULTIPLY: case TOKEN_DIVIDE: return PREC_FACTOR;
+        default: return PREC_NONE;
+    }
+}
+
+static Opcode infix_opcode(TokenType type) {
+    switch (type) {
+        case TOKEN_PLUS: return OP_ADD;
+        case TOKEN_MINUS: return OP_SUB;
+        case TOKEN_MULTIPLY: return OP_MUL;
+        default: return OP_DIV;
+    }
+}
+
+/* Returns: 1 with *result set when a op b is defined and fits an int */
+static int fold_constants(Opcode op, long long a, long long b, long long *result) {
+    switch (op) {
+        case OP_ADD: *result = a + b; break;
+        case OP_SUB: *result = a - b; break;
+        case OP_MUL: *result = a * b; break;
+        default:
+            if (b == 0) return 0;
+            *result = a / b;
+            break;
+    }
+    return *result >= INT_MIN && *result <= INT_MAX;
+}
+
+/* Returns: slot of a single-letter variable, or -1 after reporting an error */
+static int variable_slot(Compiler *c, const Token *token) {
+    char name = c->source[token->offset];
+    if (token->length != 1 || name < 'a' || name > 'z') {
+        syntax_error(c, token, "variables are single letters a-z");
+        return -1;
+    }
+    return name - 'a';
+}
+
+static ExprResult compile_expression(Compiler *c, int min_precedence);
+
+static ExprResult compile_prefix(Compiler *c) {
+    const Token *token = &c->tokens[c->pos];
+    ExprResult result = {0, 0};
+    switch (token->type) {
+        case TOKEN_NUMBER: {
+            c->pos++;
+            errno = 0;
+            long long value = strtoll(c->source + token->offset, NULL, 10);  // Stops at the token's end
+            if (errno == ERANGE || value > INT_MAX) {
+                syntax_error(c, token, "number too large");
+            }
+            result.is_const = 1;
+            result.value = value;
+            return result;
+        }
+        case TOKEN_IDENTIFIER: {
+            c->pos++;
+            int slot = variable_slot(c, token);
+            emit(c, OP_LOAD, slot < 0 ? 0 : slot);
+            return result;
         }
+        case TOKEN_LPAREN:
+            c->pos++;
+            result = compile_expression(c, PREC_TERM);
+            if (c->tokens[c->pos].type != TOKEN_RPAREN) {
+                syntax_error(c, &c->tokens[c->pos], "expected ')'");
+                return result;
+            }
+            c->pos++;
+            return result;
+        case TOKEN_MINUS: {
+            c->pos++;
+            CodeMark mark = code_mark(c);
+            emit(c, OP_PUSH, 0);
+            c->held++;
+            ExprResult operand = compile_expression(c, PREC_UNARY);
+            c->held--;
+            if (operand.is_const && -operand.value <= INT_MAX) {
+                rollback(c, mark);
+                operand.value = -operand.value;
+                return operand;
+            }
+            materialize(c, operand);
+            emit(c, OP_SUB, 0);
+            return result;
+        }
+        default:
+            syntax_error(c, token, "expected an expression");
+            return result;
     }
-    free(tokens);
 }
 
-/* Interpreter implementation */
-void interpret(ToyVM *vm, const char *source) {
+static ExprResult compile_expression(Compiler *c, int min_precedence) {
+    if (c->held == MAX_STACK_VALUES) {
+        syntax_error(c, &c->tokens[c->pos], "expression too deep");
+        return (ExprResult){0, 0};
+    }
+    ExprResult lhs = compile_prefix(c);
+    while (!c->failed) {
+        TokenType type = c->tokens[c->pos].type;
+        int precedence = infix_precedence(type);
+        if (precedence == PREC_NONE || precedence < min_precedence) break;
+        c->pos++;
+
+        /* Emit a constant left operand provisionally; drop it again if the
+         * right one is constant too and the operator folds */
+        CodeMark mark = code_mark(c);
+        materialize(c, lhs);
+        c->held++;
+        ExprResult rhs = compile_expression(c, precedence + 1);
+        c->held--;
+        long long folded;
+        if (lhs.is_const && rhs.is_const && fold_constants(infix_opcode(type), lhs.value, rhs.value, &folded)) {
+            rollback(c, mark);
+            lhs.value = folded;
+            continue;
+        }
+        materialize(c, rhs);
+        emit(c, infix_opcode(type), 0);
+        lhs.is_const = 0;
+    }
+    return lhs;
+}
+
+static void compile_statement(Compiler *c) {
+    const Token *token = &c->tokens[c->pos];
+    if (token->type == TOKEN_PRINT) {
+        c->pos++;
+        materialize(c, compile_expression(c, PREC_TERM));
+        emit(c, OP_PRINT, 0);
+    } else if (token->type == TOKEN_IDENTIFIER) {
+        int slot = variable_slot(c, token);
+        TokenType next = c->tokens[c->pos + 1].type;
+        if (next == TOKEN_EQUALS) {
+            c->pos += 2;
+        } else if (infix_precedence(next) == PREC_NONE) {
+            syntax_error(c, &c->tokens[c->pos + 1], "expected '=' or an operator");
+            return;
+        }
+        /* For `x op ...` the expression starts at x itself */
+        materialize(c, compile_expression(c, PREC_TERM));
+        emit(c, OP_STORE, slot < 0 ? 0 : slot);
+    } else {
+        syntax_error(c, token, "expected a statement");
+    }
+}
+
+/* Debugging helper to print bytecode, one instruction per line */
+static void print_bytecode(const char *title, const char *code, int size, const int32_t *consts, int const_count) {
+    printf("%s (%d bytes, %d constants):\n", title, size, const_count);
+    VmInstruction insn;
+    for (int ip = 0; ip < size; ip += insn.length) {
+        if (!vm_decode(code, size, ip, &insn)) {
+            printf("  %4d  INVALID %d\n", ip, (unsigned char)code[ip]);
+            insn.length = 1;
+            continue;
+        }
+        printf("  %4d  %s", ip, vm_opcode_name(insn.op));
+        for (int i = 0; i < insn.operand_count; i++) printf(" %d", insn.args[i]);
+        if (insn.op == OP_CONST && insn.args[0] < const_count) printf(" (%d)", consts[insn.args[0]]);
+        printf("\n");
+    }
+}
+
+/* Compiles source into vm. Unless final, source is a chunk of a longer
+ * script, and its last statement may continue past the chunk: a statement
+ * ends only where the next token cannot extend it, and that token has not
+ * been read yet. That statement is left out, and so is an error at the
+ * chunk's last token, which may have been cut in two. *consumed is then where compiling must
+ * resume, always at a token or line start, and *next_line its line number.
+ * Returns: 0, or 1 after printing a syntax error */
+static int compile_source(ToyVM *vm, const char *source, int first_line, int final,
+                          int *consumed, int *next_line) {
     int token_count;
-    Token *tokens = tokenize(source, &token_count);
-    int i = 0;
-
-    char *bytecode = malloc(256);  // Dynamically allocate bytecode
-    int bytecode_pos = 0;
-
-    if (debug) printf("Interpreting %d tokens:\n", token_count);
-    while (i < token_count && tokens[i].type != TOKEN_EOF) {
-        if (tokens[i].type == TOKEN_IDENTIFIER) {
-            if (i + 1 < token_count && tokens[i + 1].type == TOKEN_EQUALS) {
-                if (i + 2 < token_count && tokens[i + 2].type == TOKEN_NUMBER) {
-                    // Case: x = 5
-                    int value = atoi(tokens[i + 2].value);
-                    char var = tokens[i].value[0];  // Assume single-letter variable
-                    bytecode[bytecode_pos++] = OP_PUSH;
-                    bytecode[bytecode_pos++] = value;
-                    bytecode[bytecode_pos++] = OP_STORE;
-                    bytecode[bytecode_pos++] = var - 'a';  // Index for a-z
-                    if (debug) printf("Generated: PUSH %d, STORE %c\n", value, var);
-                    i += 3;
-                } else if (i + 4 < token_count && tokens[i + 2].type == TOKEN_IDENTIFIER &&
-                           (tokens[i + 3].type == TOKEN_PLUS || tokens[i + 3].type == TOKEN_MINUS ||
-                            tokens[i + 3].type == TOKEN_MULTIPLY || tokens[i + 3].type == TOKEN_DIVIDE) &&
-                           tokens[i + 4].type == TOKEN_IDENTIFIER) {
-                    // Case: z = x + y
-                    char dest_var = tokens[i].value[0];
-                    char var1 = tokens[i + 2].value[0];
-                    char var2 = tokens[i + 4].value[0];
-                    bytecode[bytecode_pos++] = OP_LOAD;
-                    bytecode[bytecode_pos++] = var1 - 'a';
-                    bytecode[bytecode_pos++] = OP_LOAD;
-                    bytecode[bytecode_pos++] = var2 - 'a';
-                    switch (tokens[i + 3].type) {
-                        case TOKEN_PLUS:
-                            bytecode[bytecode_pos++] = OP_ADD;
-                            if (debug) printf("Generated: LOAD %c, LOAD %c, ADD, STORE %c\n", var1, var2, dest_var);
-                            break;
-                        case TOKEN_MINUS:
-                            bytecode[bytecode_pos++] = OP_SUB;
-                            if (debug) printf("Generated: LOAD %c, LOAD %c, SUB, STORE %c\n", var1, var2, dest_var);
-                            break;
-                        case TOKEN_MULTIPLY:
-                            bytecode[bytecode_pos++] = OP_MUL;
-                            if (debug) printf("Generated: LOAD %c, LOAD %c, MUL, STORE %c\n", var1, var2, dest_var);
-                            break;
-                        case TOKEN_DIVIDE:
-                            bytecode[bytecode_pos++] = OP_DIV;
-                            if (debug) printf("Generated: LOAD %c, LOAD %c, DIV, STORE %c\n", var1, var2, dest_var);
-                            break;
-                        default:
-                            i += 5;
-                            continue;
-                    }
-                    bytecode[bytecode_pos++] = OP_STORE;
-                    bytecode[bytecode_pos++] = dest_var - 'a';
-                    i += 5;
-                } else {
-                    i += 2;  // Skip past equals if no valid expression follows
-                }
-            } else if (i + 1 < token_count && i + 2 < token_count && tokens[i + 2].type == TOKEN_NUMBER) {
-                // Case: x + 3
-                char var = tokens[i].value[0];
-                int value = atoi(tokens[i + 2].value);
-                bytecode[bytecode_pos++] = OP_LOAD;
-                bytecode[bytecode_pos++] = var - 'a';
-                bytecode[bytecode_pos++] = OP_PUSH;
-                bytecode[bytecode_pos++] = value;
-                switch (tokens[i + 1].type) {
-                    case TOKEN_PLUS:
-                        bytecode[bytecode_pos++] = OP_ADD;
-                        if (debug) printf("Generated: LOAD %c, PUSH %d, ADD, STORE %c\n", var, value, var);
-                        break;
-                    case TOKEN_MINUS:
-                        bytecode[bytecode_pos++] = OP_SUB;
-                        if (debug) printf("Generated: LOAD %c, PUSH %d, SUB, STORE %c\n", var, value, var);
-                        break;
-                    case TOKEN_MULTIPLY:
-                        bytecode[bytecode_pos++] = OP_MUL;
-                        if (debug) printf("Generated: LOAD %c, PUSH %d, MUL, STORE %c\n", var, value, var);
-                        break;
-                    case TOKEN_DIVIDE:
-                        bytecode[bytecode_pos++] = OP_DIV;
-                        if (debug) printf("Generated: LOAD %c, PUSH %d, DIV, STORE %c\n", var, value, var);
-                        break;
-                    default:
-                        i += 3;
-                        continue;
-                }
-                bytecode[bytecode_pos++] = OP_STORE;
-                bytecode[bytecode_pos++] = var - 'a';
-                i += 3;
+    Arena arena;
+    arena_init(&arena);
+    Token *tokens = tokenize_from(&arena, source, first_line, &token_count);
+    Compiler c = {.source = source, .tokens = tokens, .code = malloc(64), .capacity = 64};
+    const Token *eof = &tokens[token_count - 1];
+    const Token *resume = NULL;
+
+    while (!c.failed && tokens[c.pos].type != TOKEN_EOF) {
+        CodeMark mark = code_mark(&c);
+        int start = c.pos;
+        compile_statement(&c);
+        int reached_end = c.failed ? c.error_token >= eof - 1 : c.pos == token_count - 1;
+        if (!final && reached_end) {
+            rollback(&c, mark);
+            c.failed = 0;
+            resume = &tokens[start];
+            break;
+        }
+    }
+    if (c.failed) report_error(&c);
+    if (consumed) {
+        if (resume) {
+            *consumed = resume->offset;
+            *next_line = resume->line;
+        } else {
+            /* Only whitespace and comments left; a comment may be cut, so
+             * resume at the start of the last line */
+            const char *line_start = strrchr(source, '\n');
+            if (final) {
+                *consumed = eof->offset;
             } else {
-                i++;
+                *consumed = line_start ? (int)(line_start + 1 - source) : 0;
             }
-        } else if (tokens[i].type == TOKEN_PRINT && i + 1 < token_count &&
-                   tokens[i + 1].type == TOKEN_IDENTIFIER) {
-            char var = tokens[i + 1].value[0];
-            bytecode[bytecode_pos++] = OP_LOAD;
-            bytecode[bytecode_pos++] = var - 'a';
-            bytecode[bytecode_pos++] = OP_PRINT;
-            if (debug) printf("Generated: LOAD %c, PRINT\n", var);
-            i += 2;
-        } else {
-            i++;
+            *next_line = eof->line;
         }
     }
+    arena_release(&arena);
+    if (c.failed) {
+        free(c.code);
+        free(c.consts);
+        return 1;
+    }
+
+    emit(&c, OP_HALT, 0);
+    memset(c.code + c.size, 0, VM_CODE_PADDING);
+    if (debug) print_bytecode("Generated", c.code, c.size, c.consts, c.const_count);
+    if (optimize) {
+        c.size = peephole_optimize(&c.code, c.size, c.consts, c.const_count);
+        if (debug) print_bytecode("Peephole", c.code, c.size, c.consts, c.const_count);
+    }
+    vm_set_program(vm, c.code, c.size, c.consts, c.const_count);
+    return 0;
+}
+
+int toy_compile(ToyVM *vm, const char *source) {
+    return compile_source(vm, source, 1, 1, NULL, NULL);
+}
+
+/* Interpreter implementation */
+void interpret(ToyVM *vm, const char *source) {
+    if (toy_compile(vm, source) == 0) vm_execute(vm);
+}
+
+/* Whether the last run reached HALT rather than stopping on an error */
+static int vm_reached_halt(const ToyVM *vm) {
+    if (vm->backend == VM_BACKEND_REGISTER && vm->rcode) return vm->ip == vm->rcode_count - 1;
+    return vm->ip == vm->code_size;
+}
+
+int interpret_stream(ToyVM *vm, FILE *input) {
+    size_t capacity = STREAM_CHUNK_SIZE;
+    char *buffer = malloc(capacity + 1);
+    size_t length = 0;
+    int line = 1;
+    int result = 0;
 
-    bytecode[bytecode_pos++] = OP_HALT;
-    if (debug) printf("Generated: HALT\n");
-    if (vm->code) free(vm->code);  // Free previous bytecode if exists
-    vm->code = bytecode;
-    vm->code_size = bytecode_pos;
-    vm_execute(vm);
+    for (;;) {
+        if (length == capacity) {  // One statement or comment line fills the buffer
+            capacity *= 2;
+            buffer = realloc(buffer, capacity + 1);
+        }
+        length += fread(buffer + length, 1, capacity - length, input);
+        int final = length < capacity;  // fread only comes up short at end of input
+        buffer[length] = '\0';
+
+        int consumed;
+        if (compile_source(vm, buffer, line, final, &consumed, &line) != 0) {
+            result = 1;
+            break;
+        }
+        if (consumed > 0 || final) {
+            vm_execute(vm);
+            if (!vm_reached_halt(vm)) {
+                result = 1;
+                break;
+            }
+        }
+        if (final) break;
+        length -= consumed;
+        memmove(buffer, buffer + consumed, length);
+    }
+    free(buffer);
+    if (ferror(input)) {
+        perror("Error reading input");
+        result = 1;
+    }
+    return result;
 }
 
 /* VM implementation */
@@ -239,100 +542,417 @@ ToyVM *vm_new() {
     vm->ip = 0;
     vm->code = NULL;
     vm->code_size = 0;
+    vm->consts = NULL;
+    vm->const_count = 0;
     memset(vm->vars, 0, sizeof(vm->vars));  // Initialize variables to 0
+    vm->backend = VM_BACKEND_STACK;
+    vm->rcode = NULL;
+    vm->rcode_count = 0;
+    vm->reg_count = 0;
+    vm->jit_code = NULL;
+    vm->jit_size = 0;
+    vm->mapping = NULL;
+    vm->mapping_size = 0;
     return vm;
 }
 
+/* Frees the current program, or unmaps it if it runs from a .toyc file */
+static void release_program(ToyVM *vm) {
+    if (vm->mapping) {
+        munmap(vm->mapping, vm->mapping_size);
+        vm->mapping = NULL;
+        vm->mapping_size = 0;
+    } else {
+        free(vm->code);
+        free(vm->consts);
+    }
+}
+
 void vm_free(ToyVM *vm) {
-    if (vm->code) free(vm->code);
+    release_program(vm);
+    free(vm->rcode);
+    jit_free(vm);
     free(vm);
 }
 
-void vm_execute(ToyVM *vm) {
-    vm->ip = 0;
-    if (debug) printf("Executing %d bytes of bytecode:\n", vm->code_size);
-    while (vm->ip < vm->code_size) {
-        Opcode op = (Opcode)vm->code[vm->ip++];
-        switch (op) {
-            case OP_PUSH:
-                vm->stack[vm->sp++] = (unsigned char)vm->code[vm->ip++];
-                if (debug) printf("PUSH %d (sp=%d)\n", vm->stack[vm->sp - 1], vm->sp);
-                break;
-            case OP_STORE: {
-                unsigned char var_idx = (unsigned char)vm->code[vm->ip++];
-                vm->vars[var_idx] = vm->stack[--vm->sp];
-                if (debug) printf("STORE %c = %d (sp=%d)\n", 'a' + var_idx, vm->vars[var_idx], vm->sp);
-                break;
-            }
-            case OP_LOAD: {
-                unsigned char var_idx = (unsigned char)vm->code[vm->ip++];
-                vm->stack[vm->sp++] = vm->vars[var_idx];
-                if (debug) printf("LOAD %c = %d (sp=%d)\n", 'a' + var_idx, vm->stack[vm->sp - 1], vm->sp);
-                break;
-            }
-            case OP_ADD:
-                vm->stack[vm->sp - 2] = vm->stack[vm->sp - 2] + vm->stack[vm->sp - 1];
-                vm->sp--;
-                if (debug) printf("ADD %d + %d = %d (sp=%d)\n", vm->stack[vm->sp], vm->stack[vm->sp + 1], vm->stack[vm->sp], vm->sp);
-                break;
-            case OP_SUB:
-                vm->stack[vm->sp - 2] = vm->stack[vm->sp - 2] - vm->stack[vm->sp - 1];
-                vm->sp--;
-                if (debug) printf("SUB %d - %d = %d (sp=%d)\n", vm->stack[vm->sp], vm->stack[vm->sp + 1], vm->stack[vm->sp], vm->sp);
-                break;
-            case OP_MUL:
-                vm->stack[vm->sp - 2] = vm->stack[vm->sp - 2] * vm->stack[vm->sp - 1];
-                vm->sp--;
-                if (debug) printf("MUL %d * %d = %d (sp=%d)\n", vm->stack[vm->sp], vm->stack[vm->sp + 1], vm->stack[vm->sp], vm->sp);
-                break;
-            case OP_DIV:
-                if (vm->stack[vm->sp - 1] == 0) {
-                    fprintf(stderr, "Error: Division by zero\n");
-                    return;
-                }
-                vm->stack[vm->sp - 2] = vm->stack[vm->sp - 2] / vm->stack[vm->sp - 1];
-                vm->sp--;
-                if (debug) printf("DIV %d / %d = %d (sp=%d)\n", vm->stack[vm->sp], vm->stack[vm->sp + 1], vm->stack[vm->sp], vm->sp);
-                break;
-            case OP_PRINT:
-                printf(COLOR_GREY "%d" COLOR_RESET "\n", vm->stack[--vm->sp]);
-                if (debug) printf("PRINT %d (sp=%d)\n", vm->stack[vm->sp], vm->sp);
-                break;
-            case OP_HALT:
-                if (debug) printf("HALT\n");
-                return;
+void vm_set_program(ToyVM *vm, char *code, int code_size, int32_t *consts, int const_count) {
+    release_program(vm);  // Free previous bytecode if exists
+    vm->code = code;
+    vm->code_size = code_size;
+    vm->consts = consts;
+    vm->const_count = const_count;
+
+    free(vm->rcode);
+    vm->rcode = NULL;
+    vm->rcode_count = 0;
+    if (vm->backend == VM_BACKEND_REGISTER) {
+        vm->rcode_count = reg_translate(code, code_size, consts, const_count, &vm->rcode, &vm->reg_count);
+        if (vm->rcode_count < 0) {
+            /* Only hand-made bytecode fails; vm_execute then runs the stack code */
+            fprintf(stderr, "Warning: Cannot translate to register code; using the stack VM\n");
+            vm->rcode = NULL;
+            vm->rcode_count = 0;
+        } else if (debug) {
+            printf("Register code: %d instructions, %d registers\n", vm->rcode_count, vm->reg_count);
         }
     }
+
+    jit_free(vm);
+    if (vm->backend == VM_BACKEND_JIT && vm_has_jit() && jit_compile(vm) != 0) {
+        /* As with the register backend, vm_execute then runs the stack code */
+        fprintf(stderr, "Warning: Cannot compile to native code; using the stack VM\n");
+    }
+}
+
+/* Loop variants; see toyvm_loop.h */
+#define VM_LOOP_NAME run_switch
+#define VM_LOOP_THREADED 0
+#define VM_LOOP_TRACE 0
+#include "toyvm_loop.h"
+#undef VM_LOOP_NAME
+#undef VM_LOOP_THREADED
+#undef VM_LOOP_TRACE
+
+#if TOYVM_THREADED
+#define VM_LOOP_NAME run_threaded
+#define VM_LOOP_THREADED 1
+#define VM_LOOP_TRACE 0
+#include "toyvm_loop.h"
+#undef VM_LOOP_NAME
+#undef VM_LOOP_THREADED
+#undef VM_LOOP_TRACE
+#endif
+
+#define VM_LOOP_NAME run_traced
+#define VM_LOOP_THREADED 0
+#define VM_LOOP_TRACE 1
+#include "toyvm_loop.h"
+#undef VM_LOOP_NAME
+#undef VM_LOOP_THREADED
+#undef VM_LOOP_TRACE
+
+int vm_has_threaded_dispatch(void) {
+    return TOYVM_THREADED;
+}
+
+void vm_execute_with(ToyVM *vm, VmDispatch dispatch) {
+    if (vm->backend == VM_BACKEND_REGISTER && vm->rcode) {
+        reg_execute(vm, dispatch, debug);
+        return;
+    }
+    /* Native code has no trace, so --debug interprets */
+    if (vm->backend == VM_BACKEND_JIT && vm->jit_code && !debug) {
+        jit_execute(vm);
+        return;
+    }
+    /* Checked once per run, never per instruction */
+    if (debug) {
+        run_traced(vm);
+        return;
+    }
+#if TOYVM_THREADED
+    if (dispatch == VM_DISPATCH_THREADED) {
+        run_threaded(vm);
+        return;
+    }
+#endif
+    (void)dispatch;
+    run_switch(vm);
+}
+
+void vm_execute(ToyVM *vm) {
+    vm_execute_with(vm, VM_DISPATCH_THREADED);
 }
 
 /* Main entry point for the toyvm executable */
 #ifndef TARGET_TEST
+
+/* Straight-line program for --bench without a file: every variable is reset
+ * first, so repeated runs never overflow */
+static const char *BENCH_PROGRAM =
+    "a = 3\nb = 4\nc = 5\nd = a + b\ne = d * c\nf = e - a\ng = f / b\n"
+    "a + 7\nb * 3\nc - 1\nd / 2\nh = a + g\ni = h - b\nj = i * c\n"
+    "k = j / d\nl = k + a\nm = l - c\nn = m * b\no = n / a\np = o + e\n"
+    "q = p - f\nr = q + g\ns = r - h\nt = s + i\nu = t - j\nv = u + k\n";
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Returns: instructions one run of the stack bytecode executes (programs are straight-line) */
+static long count_instructions(const ToyVM *vm) {
+    long count = 0;
+    VmInstruction insn;
+    for (int ip = 0; ip < vm->code_size; ip += insn.length, count++) {
+        if (!vm_decode(vm->code, vm->code_size, ip, &insn)) insn.length = 1;
+    }
+    return count;
+}
+
+/* Reruns the compiled program for at least 200 ms
+ * Returns: seconds per run
+ */
+static double bench_dispatch(ToyVM *vm, VmDispatch dispatch) {
+    long runs = 0;
+    double start = now_seconds();
+    double elapsed;
+    do {
+        for (int i = 0; i < 1000; i++) vm_execute_with(vm, dispatch);
+        runs += 1000;
+        elapsed = now_seconds() - start;
+    } while (elapsed < 0.2);
+    return elapsed / runs;
+}
+
+/* Compiles source for one backend and prints its row of the --bench table;
+ * the program's own output is discarded while timing */
+static void bench_row(const char *label, const char *source, VmBackend backend, int peephole) {
+    ToyVM *vm = vm_new();
+    vm->backend = backend;
+    int saved_optimize = optimize;
+    optimize = peephole;
+    toy_compile(vm, source);
+    optimize = saved_optimize;
+    if ((backend == VM_BACKEND_REGISTER && !vm->rcode) || (backend == VM_BACKEND_JIT && !vm->jit_code)) {
+        printf("  %-22s (program does not translate)\n", label);
+        vm_free(vm);
+        return;
+    }
+    long count = backend == VM_BACKEND_REGISTER ? vm->rcode_count : count_instructions(vm);
+
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) dup2(null_fd, STDOUT_FILENO);
+
+    /* Native code has no dispatch to vary, so it is timed once */
+    int native = backend == VM_BACKEND_JIT;
+    double switch_time = native ? 0 : bench_dispatch(vm, VM_DISPATCH_SWITCH);
+    double threaded_time = native || vm_has_threaded_dispatch() ? bench_dispatch(vm, VM_DISPATCH_THREADED) : 0;
+
+    fflush(stdout);
+    if (null_fd >= 0) {
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(null_fd);
+    }
+    close(saved_stdout);
+
+    if (native) {
+        printf("  %-22s %12ld %14s %16.1f %12.1f\n", label, count, "n/a", threaded_time * 1e9,
+               count / threaded_time / 1e6);
+        vm_free(vm);
+        return;
+    }
+    printf("  %-22s %12ld %14.1f", label, count, switch_time * 1e9);
+    if (vm_has_threaded_dispatch()) {
+        printf(" %16.1f %12.1f\n", threaded_time * 1e9, count / threaded_time / 1e6);
+    } else {
+        printf(" %16s %12.1f\n", "n/a", count / switch_time / 1e6);
+    }
+    vm_free(vm);
+}
+
+/* --bench [FILE...]: instruction count and time per run for each backend,
+ * with and without the peephole pass (--no-opt keeps only the former) */
+static void run_bench(const char *name, const char *source) {
+    printf("%s\n", name);
+    printf("  %-22s %12s %14s %16s %12s\n", "backend", "instructions", "switch ns/run",
+           "threaded ns/run", "M ops/s");
+    bench_row("stack, no peephole", source, VM_BACKEND_STACK, 0);
+    bench_row("register, no peephole", source, VM_BACKEND_REGISTER, 0);
+    if (vm_has_jit()) bench_row("jit, no peephole", source, VM_BACKEND_JIT, 0);
+    if (!optimize) return;
+    bench_row("stack", source, VM_BACKEND_STACK, 1);
+    bench_row("register", source, VM_BACKEND_REGISTER, 1);
+    if (vm_has_jit()) bench_row("jit", source, VM_BACKEND_JIT, 1);
+}
+
+/* --bench-tokens FILE...: tokenizer throughput, rerunning for at least 200 ms */
+static void bench_tokenizer(const char *name, const char *source) {
+    long runs = 0;
+    int token_count = 0;
+    double start = now_seconds();
+    double elapsed;
+    do {
+        Arena arena;
+        arena_init(&arena);
+        tokenize(&arena, source, &token_count);
+        arena_release(&arena);
+        runs++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < 0.2);
+    double megabytes = strlen(source) / 1e6;
+    printf("%s: %d tokens, %.1f MB, %.1f M tokens/s, %.0f MB/s\n", name, token_count, megabytes,
+           token_count * runs / elapsed / 1e6, megabytes * runs / elapsed);
+}
+
+/* Reads a whole file into a NUL-terminated buffer (caller frees), or NULL on error */
+static char *read_file(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror("Error opening file");
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *source = malloc(size + 1);
+    fread(source, 1, size, file);
+    source[size] = '\0';
+    fclose(file);
+    return source;
+}
+
+/* --compile FILE [-o OUT]: writes the compiled program as a .toyc image,
+ * by default next to FILE with its extension replaced */
+static int compile_file(const char *file, const char *output) {
+    if (!file) {
+        fprintf(stderr, "Usage: toyvm --compile FILE.toy [-o FILE.toyc]\n");
+        return 1;
+    }
+    char *source = read_file(file);
+    if (!source) return 1;
+    ToyVM *vm = vm_new();
+    int result = toy_compile(vm, source);
+    free(source);
+
+    char *default_output = NULL;
+    if (!output) {
+        const char *dot = strrchr(file, '.');
+        size_t stem = dot && !strchr(dot, '/') ? (size_t)(dot - file) : strlen(file);
+        default_output = malloc(stem + 6);
+        memcpy(default_output, file, stem);
+        strcpy(default_output + stem, ".toyc");
+        output = default_output;
+    }
+    if (result == 0) result = vm_save_bytecode_file(vm, output);
+    free(default_output);
+    vm_free(vm);
+    return result;
+}
+
+/* --emit-c FILE [-o FILE.c]: writes the program (source or .toyc) as a C
+ * function, to stdout unless -o is given */
+static int emit_c_file(const char *file, const char *output) {
+    if (!file) {
+        fprintf(stderr, "Usage: toyvm --emit-c FILE [-o FILE.c]\n");
+        return 1;
+    }
+    ToyVM *vm = vm_new();
+    int result;
+    if (vm_is_bytecode_file(file)) {
+        result = vm_map_bytecode_file(vm, file);
+    } else {
+        char *source = read_file(file);
+        result = source ? toy_compile(vm, source) : 1;
+        free(source);
+    }
+
+    FILE *out = stdout;
+    if (result == 0 && output && !(out = fopen(output, "w"))) {
+        perror("Error opening output file");
+        result = 1;
+    }
+    if (result == 0 && vm_emit_c(vm, "toy_program", out) != 0) {
+        fprintf(stderr, "Error: Bytecode failed verification\n");
+        result = 1;
+    }
+    if (out && out != stdout && fclose(out) != 0) {
+        perror("Error writing output file");
+        result = 1;
+    }
+    vm_free(vm);
+    return result;
+}
+
 int main(int argc, char *argv[]) {
-    // Parse command-line arguments for --debug or -d
+    // Parse command-line arguments for --debug or -d, --no-opt, --register, --jit, --compile, --emit-c and --stream
+    const char *file = NULL;
+    const char *output = NULL;
+    int compile = 0;
+    int emit_c = 0;
+    int stream = 0;
+    VmBackend backend = VM_BACKEND_STACK;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--debug") == 0 || strcmp(argv[i], "-d") == 0) {
             debug = 1;
-            break;
+        } else if (strcmp(argv[i], "--no-opt") == 0) {
+            optimize = 0;
+        } else if (strcmp(argv[i], "--register") == 0) {
+            backend = VM_BACKEND_REGISTER;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            if (!vm_has_jit()) fprintf(stderr, "Warning: No native code backend on this platform; using the stack VM\n");
+            backend = VM_BACKEND_JIT;
+        } else if (strcmp(argv[i], "--compile") == 0) {
+            compile = 1;
+        } else if (strcmp(argv[i], "--emit-c") == 0) {
+            emit_c = 1;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (argv[i][0] != '-' && !file) {
+            file = argv[i];
         }
     }
 
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        if (!file) {
+            run_bench("built-in program", BENCH_PROGRAM);
+            return 0;
+        }
+        for (int i = 2; i < argc; i++) {
+            if (argv[i][0] == '-') continue;
+            char *source = read_file(argv[i]);
+            if (!source) return 1;
+            run_bench(argv[i], source);
+            free(source);
+        }
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-tokens") == 0) {
+        for (int i = 2; i < argc; i++) {
+            char *source = read_file(argv[i]);
+            if (!source) return 1;
+            bench_tokenizer(argv[i], source);
+            free(source);
+        }
+        return 0;
+    }
+    if (compile) return compile_file(file, output);
+    if (emit_c) return emit_c_file(file, output);
+
     // Handle file input or interactive shell
     ToyVM *vm = vm_new();
-    if (argc > 1 && !debug) {  // If debug is set, assume interactive mode unless file explicitly provided
-        /* Read from a file if provided */
-        FILE *file = fopen(argv[1], "r");
-        if (!file) {
+    vm->backend = backend;
+    struct stat st;
+    if (stream || (file && !debug && stat(file, &st) == 0 && !S_ISREG(st.st_mode))) {
+        /* Pipes and FIFOs cannot be measured up front, so they always stream */
+        FILE *input = file ? fopen(file, "r") : stdin;
+        if (!input) {
             perror("Error opening file");
             vm_free(vm);
             return 1;
         }
-        fseek(file, 0, SEEK_END);
-        long size = ftell(file);
-        fseek(file, 0, SEEK_SET);
-        char *source = malloc(size + 1);
-        fread(source, 1, size, file);
-        source[size] = '\0';
-        fclose(file);
+        int result = interpret_stream(vm, input);
+        if (input != stdin) fclose(input);
+        vm_free(vm);
+        return result;
+    } else if (file && !debug && vm_is_bytecode_file(file)) {
+        /* Precompiled: runs straight from the mapped file */
+        int result = vm_map_bytecode_file(vm, file);
+        if (result == 0) vm_execute(vm);
+        vm_free(vm);
+        return result;
+    } else if (file && !debug) {  // If debug is set, assume interactive mode unless file explicitly provided
+        /* Read from a file if provided */
+        char *source = read_file(file);
+        if (!source) {
+            vm_free(vm);
+            return 1;
+        }
 
         interpret(vm, source);
         free(source);
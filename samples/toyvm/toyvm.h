@@ -1,6 +1,28 @@
 #ifndef TOYVM_H
 #define TOYVM_H
 
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Computed-goto dispatch needs the GCC/Clang labels-as-values extension */
+#if defined(__GNUC__) && !defined(TOYVM_NO_THREADED)
+#define TOYVM_THREADED 1
+#else
+#define TOYVM_THREADED 0
+#endif
+
+/* The native code backend emits x86-64 and maps memory the Linux way */
+#if defined(__x86_64__) && defined(__linux__) && !defined(TOYVM_NO_JIT)
+#define TOYVM_JIT 1
+#else
+#define TOYVM_JIT 0
+#endif
+
+// ANSI color codes
+#define COLOR_GREY "\033[90m"  // Bright black (grey-ish)
+#define COLOR_RESET "\033[0m"
+
 /* Token types for the tokenizer */
 typedef enum {
     TOKEN_NUMBER,
@@ -10,21 +32,37 @@ typedef enum {
     TOKEN_MINUS,  // New
     TOKEN_MULTIPLY,  // New
     TOKEN_DIVIDE,  // New
+    TOKEN_LPAREN,
+    TOKEN_RPAREN,
     TOKEN_PRINT,
     TOKEN_EOF,
     TOKEN_ERROR
 } TokenType;
 
-/* Structure for a token */
+/* Structure for a token: a view into the source it was read from */
 typedef struct {
     TokenType type;
-    char *value;  // Dynamically allocated string
+    int offset;   // Start of the token's text in the source
     int length;
+    int line;     // 1-based source line, for error messages
 } Token;
 
-/* VM instruction opcodes */
+/* Bump allocator (toyvm_arena.c); everything in it is freed together */
+typedef struct ArenaBlock ArenaBlock;
+typedef struct {
+    ArenaBlock *blocks;  // Newest first
+} Arena;
+
+/* VM instruction opcodes
+ *
+ * Operands follow the opcode as prefix varints (see vm_read_uint): variable
+ * slots and pool indices unsigned, immediates zigzag-encoded so small
+ * negative numbers stay short. Numbering and operands are part of the
+ * bytecode format; changing either means bumping TOYVM_BYTECODE_VERSION.
+ */
 typedef enum {
-    OP_PUSH,
+    OP_PUSH,   // PUSH k: push an immediate
+    OP_CONST,  // CONST i: push constant i from the program's pool
     OP_STORE,  // Store value in variable
     OP_LOAD,   // Load value from variable
     OP_ADD,
@@ -32,29 +70,196 @@ typedef enum {
     OP_MUL,    // New: Multiply
     OP_DIV,    // New: Divide
     OP_PRINT,
-    OP_HALT
+    OP_HALT,
+    /* Superinstructions; only the peephole pass emits these */
+    OP_STORE_IMM,      // STORE_IMM x k: x = k
+    OP_ADD_VV_STORE,   // ADD_VV_STORE d a b: d = a + b
+    OP_SUB_VV_STORE,
+    OP_MUL_VV_STORE,
+    OP_DIV_VV_STORE,
+    OP_INC_VAR_IMM,    // INC_VAR_IMM x k: x = x + k
+    OP_DEC_VAR_IMM,
+    OP_MUL_VAR_IMM,
+    OP_DIV_VAR_IMM,
+    OP_LOAD_PRINT      // LOAD_PRINT x: print x
 } Opcode;
 
+/* Register VM opcodes. Operands are registers: 0-25 are the variables a-z,
+ * higher ones are temporaries. LI and the *I ops take imm instead of rb. */
+typedef enum {
+    ROP_LI,     // LI rd, imm: rd = imm
+    ROP_MOV,    // MOV rd, ra: rd = ra
+    ROP_ADD,    // ADD rd, ra, rb: rd = ra + rb
+    ROP_SUB,
+    ROP_MUL,
+    ROP_DIV,
+    ROP_ADDI,   // ADDI rd, ra, imm: rd = ra + imm
+    ROP_SUBI,
+    ROP_MULI,
+    ROP_DIVI,
+    ROP_PRINT,  // PRINT ra
+    ROP_HALT
+} RegOpcode;
+
+/* One fixed-width register VM instruction */
+typedef struct {
+    unsigned char op;
+    unsigned char rd;
+    unsigned char ra;
+    unsigned char rb;
+    int32_t imm;
+} RegInsn;
+
+/* One stack instruction decoded for tools that walk bytecode; the VM loop
+ * reads operands in place instead */
+typedef struct {
+    unsigned char op;
+    int operand_count;
+    int32_t args[3];
+    int length;  // Encoded size in bytes
+} VmInstruction;
+
+/* Serialized bytecode (.toyc), written by vm_save_bytecode. Laid out so
+ * that a mapped file can run in place:
+ *   0   "TOYB"
+ *   4   version byte, then 3 zero bytes
+ *   8   checksum: FNV-1a of every byte from offset 24 to the end
+ *   12  constant count
+ *   16  code size
+ *   20  zero
+ *   24  constants, 4 bytes each
+ *   ... code bytes, then VM_CODE_PADDING zero bytes
+ * All fields are little-endian 32-bit. Version 1 was the unversioned
+ * format with one-byte operands; version 2 stored the header fields and
+ * constants as varints, so it could not be used in place. */
+#define TOYVM_BYTECODE_MAGIC "TOYB"
+#define TOYVM_BYTECODE_VERSION 3
+#define TOYVM_BYTECODE_HEADER_SIZE 24
+
+/* Readable bytes vm->code must have after code_size: the decoder loads 8
+ * bytes at every operand */
+#define VM_CODE_PADDING 8
+
+/* Bytes interpret_stream reads at a time */
+#define STREAM_CHUNK_SIZE (64 * 1024)
+
+/* Instruction sets interpret can compile for */
+typedef enum {
+    VM_BACKEND_STACK,     // Byte-coded stack machine (vm->code)
+    VM_BACKEND_REGISTER,  // Three-address ops on the variable slots (vm->rcode)
+    VM_BACKEND_JIT        // Native code from toyvm_jit.c (vm->jit_code); the stack VM where unsupported
+} VmBackend;
+
+/* Dispatch loops vm_execute_with can run */
+typedef enum {
+    VM_DISPATCH_SWITCH,    // Portable switch loop
+    VM_DISPATCH_THREADED   // Computed-goto loop; falls back to the switch without GCC/Clang
+} VmDispatch;
+
 /* Structure for the VM */
 typedef struct {
     int stack[256];        // Simple stack for values
     int sp;                // Stack pointer
     int ip;                // Instruction pointer
-    char *code;            // Bytecode
+    char *code;            // Bytecode, followed by VM_CODE_PADDING readable bytes
     int code_size;
+    int32_t *consts;       // Constant pool for CONST
+    int const_count;
     int vars[26];          // Simple variable storage (a-z)
+    VmBackend backend;     // What interpret compiles for; VM_BACKEND_STACK from vm_new
+    RegInsn *rcode;        // Register code, translated from code for VM_BACKEND_REGISTER
+    int rcode_count;
+    int reg_count;         // Registers rcode touches: 26 variables plus temporaries
+    void *jit_code;        // Native code compiled from code for VM_BACKEND_JIT, or NULL
+    size_t jit_size;
+    void *mapping;         // Mapped .toyc file code and consts point into, or NULL
+    size_t mapping_size;
 } ToyVM;
 
+/* Arena functions */
+void arena_init(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size);  // Extends in place when it can
+void arena_release(Arena *arena);
+
 /* Tokenizer functions */
-Token *tokenize(const char *source, int *token_count);
-void free_tokens(Token *tokens, int token_count);
+Token *tokenize(Arena *arena, const char *source, int *token_count);  // Tokens live in arena; the last is TOKEN_EOF
 
 /* Interpreter functions */
-void interpret(ToyVM *vm, const char *source);
+int toy_compile(ToyVM *vm, const char *source);  // Into vm->code; 0, or 1 after printing a syntax error
+void interpret(ToyVM *vm, const char *source);   // toy_compile, then vm_execute
+/* Reads, compiles and runs input a chunk of whole statements at a time, so
+ * memory stays bounded by STREAM_CHUNK_SIZE and the longest statement.
+ * Returns: 0, or 1 after a syntax, runtime or read error (earlier chunks
+ * have already run) */
+int interpret_stream(ToyVM *vm, FILE *input);
+
+/* Bytecode functions */
+int vm_encode(char *out, unsigned char op, const int32_t *args);  // Returns bytes written (at most 16)
+int vm_decode(const char *code, int code_size, int ip, VmInstruction *insn);  // 0 if malformed
+int vm_verify(const char *code, int code_size, int const_count);  // 0 if safe to execute
+const char *vm_opcode_name(unsigned char op);
+int vm_save_bytecode(const ToyVM *vm, char **image, int *image_size);  // 0 on success
+int vm_load_bytecode(ToyVM *vm, const char *image, int image_size);  // Copies; 0, or 1 after printing why
+int vm_save_bytecode_file(const ToyVM *vm, const char *path);  // 0, or 1 after printing why
+int vm_map_bytecode_file(ToyVM *vm, const char *path);  // Runs in place; 0, or 1 after printing why
+int vm_is_bytecode_file(const char *path);  // 1 if the file starts with the magic
+int peephole_optimize(char **code, int code_size, const int32_t *consts, int const_count);  // Replaces *code; returns the new size
+int reg_translate(const char *code, int code_size, const int32_t *consts, int const_count,
+                  RegInsn **rcode, int *reg_count);  // Count, or -1
+void reg_execute(ToyVM *vm, VmDispatch dispatch, int trace);
+int jit_compile(ToyVM *vm);  // Into vm->jit_code from vm->code; 0, or -1 to keep interpreting
+void jit_free(ToyVM *vm);
+void jit_execute(ToyVM *vm);
+int vm_has_jit(void);  // 1 on Linux x86-64
+int vm_emit_c(const ToyVM *vm, const char *function, FILE *out);  // 0, or -1 if the code fails vm_verify
+
+/* Prefix varint: the number of trailing 1 bits in the first byte, plus one,
+ * is the length n (1-5 bytes); the value is in the bits above, little-endian.
+ * Decoding is one unaligned load, a count-trailing-zeros and a mask, with no
+ * branch on the width. Always loads 8 bytes at the operand, hence
+ * VM_CODE_PADDING. */
+static inline uint32_t vm_read_uint(const char *code, int *ip) {
+    uint64_t word;
+    memcpy(&word, code + *ip, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+#if defined(__GNUC__)
+    int length = __builtin_ctzll(~word) + 1;
+#else
+    int length = 1;
+    while ((word >> (length - 1)) & 1) length++;
+#endif
+    *ip += length;
+    return (uint32_t)((word >> length) & ((1ULL << (7 * length)) - 1));
+}
+
+/* Zigzag: 0, -1, 1, -2, ... map to 0, 1, 2, 3, ... */
+static inline int32_t vm_read_int(const char *code, int *ip) {
+    uint32_t zigzag = vm_read_uint(code, ip);
+    return (int32_t)((zigzag >> 1) ^ (0u - (zigzag & 1)));
+}
+
+/* a op b for +, - and *, computed through unsigned so that overflow wraps
+ * modulo 2^32 instead of being undefined */
+#define VM_WRAP(a, op, b) ((int32_t)((uint32_t)(a) op (uint32_t)(b)))
+
+/* Division for a non-zero divisor, wrapping like ADD, SUB and MUL: x / -1 is
+ * -x computed through unsigned, so INT_MIN / -1 is INT_MIN instead of the
+ * trap x86's idiv raises */
+static inline int32_t vm_div(int32_t a, int32_t b) {
+    return b == -1 ? (int32_t)(0u - (uint32_t)a) : a / b;
+}
 
 /* VM functions */
 ToyVM *vm_new();
 void vm_free(ToyVM *vm);
-void vm_execute(ToyVM *vm);
+/* Takes ownership of code (padded) and consts, replacing the VM's program
+ * (and unmapping a mapped one) */
+void vm_set_program(ToyVM *vm, char *code, int code_size, int32_t *consts, int const_count);
+void vm_execute(ToyVM *vm);  // Fastest available dispatch; the tracing loop under --debug
+void vm_execute_with(ToyVM *vm, VmDispatch dispatch);
+int vm_has_threaded_dispatch(void);
 
 #endif // TOYVM_H
\ No newline at end of file
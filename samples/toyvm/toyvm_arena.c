@@ -0,0 +1,72 @@
+/* toyvm_arena.c - Bump allocator for short-lived compiler data
+ *
+ * Memory comes from large blocks and is only ever released all at once, so
+ * an allocation is a pointer bump and freeing a program's tokens is one
+ * free per block rather than one per token. The most recent allocation can
+ * grow in place while its block has room, which is how the tokenizer's
+ * token buffer expands.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "toyvm.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t size;  // Usable bytes after the header
+    size_t used;
+    size_t last;  // Offset of the most recent allocation
+};
+
+/* Data starts after the header, rounded up so it stays aligned */
+#define BLOCK_HEADER ((sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define BLOCK_DATA(block) ((char *)(block) + BLOCK_HEADER)
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+void arena_init(Arena *arena) {
+    arena->blocks = NULL;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = align_up(size ? size : 1);
+    ArenaBlock *block = arena->blocks;
+    if (!block || block->size - block->used < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = malloc(BLOCK_HEADER + block_size);
+        if (!block) return NULL;
+        block->next = arena->blocks;
+        block->size = block_size;
+        block->used = 0;
+        arena->blocks = block;
+    }
+    block->last = block->used;
+    block->used += size;
+    return BLOCK_DATA(block) + block->last;
+}
+
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size) {
+    ArenaBlock *block = arena->blocks;
+    if (ptr && block && (char *)ptr == BLOCK_DATA(block) + block->last &&
+        block->size - block->last >= align_up(new_size)) {
+        block->used = block->last + align_up(new_size);
+        return ptr;
+    }
+    /* Not the newest allocation, or no room: the old copy is simply abandoned */
+    void *moved = arena_alloc(arena, new_size);
+    if (moved && ptr) memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+    return moved;
+}
+
+void arena_release(Arena *arena) {
+    while (arena->blocks) {
+        ArenaBlock *next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+}
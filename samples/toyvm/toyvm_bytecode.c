@@ -0,0 +1,304 @@
+/* toyvm_bytecode.c - ToyVM bytecode encoding, verification and serialization
+ *
+ * Everything here runs outside the VM loop: the compiler and the peephole
+ * pass encode with vm_encode, tools walk code with vm_decode, and
+ * vm_load_bytecode only accepts images that vm_verify proves safe, because
+ * the loop itself trusts slots, pool indices, stack depth and the final HALT.
+ *
+ * vm_map_bytecode_file maps a .toyc file read-only and points vm->code and
+ * vm->consts straight into the mapping, so starting a precompiled program
+ * costs a checksum and one verification pass instead of a compile.
+ *
+ * Decoding here checks bounds byte by byte instead of using the 8-byte
+ * loads of vm_read_uint, so it also works on unpadded input.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "toyvm.h"
+
+#define VAR_COUNT 26
+#define MAX_VARINT 5
+
+/* Operand kinds per opcode: 'v' variable slot, 'c' pool index, 'i' signed immediate */
+static const char *const operand_kinds[] = {
+    [OP_PUSH] = "i",
+    [OP_CONST] = "c",
+    [OP_STORE] = "v",
+    [OP_LOAD] = "v",
+    [OP_ADD] = "", [OP_SUB] = "", [OP_MUL] = "", [OP_DIV] = "",
+    [OP_PRINT] = "",
+    [OP_HALT] = "",
+    [OP_STORE_IMM] = "vi",
+    [OP_ADD_VV_STORE] = "vvv", [OP_SUB_VV_STORE] = "vvv",
+    [OP_MUL_VV_STORE] = "vvv", [OP_DIV_VV_STORE] = "vvv",
+    [OP_INC_VAR_IMM] = "vi", [OP_DEC_VAR_IMM] = "vi",
+    [OP_MUL_VAR_IMM] = "vi", [OP_DIV_VAR_IMM] = "vi",
+    [OP_LOAD_PRINT] = "v",
+};
+
+#define OPCODE_COUNT ((int)(sizeof(operand_kinds) / sizeof(operand_kinds[0])))
+
+static const char *const opcode_names[] = {
+    "PUSH", "CONST", "STORE", "LOAD", "ADD", "SUB", "MUL", "DIV", "PRINT", "HALT",
+    "STORE_IMM", "ADD_VV_STORE", "SUB_VV_STORE", "MUL_VV_STORE", "DIV_VV_STORE",
+    "INC_VAR_IMM", "DEC_VAR_IMM", "MUL_VAR_IMM", "DIV_VAR_IMM", "LOAD_PRINT",
+};
+
+const char *vm_opcode_name(unsigned char op) {
+    return op < OPCODE_COUNT ? opcode_names[op] : "INVALID";
+}
+
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/* Returns: bytes written (1-5) */
+static int write_uint(char *out, uint32_t value) {
+    int length = 1;
+    while (length < MAX_VARINT && value >> (7 * length)) length++;
+    uint64_t word = ((uint64_t)value << length) | ((1u << (length - 1)) - 1);
+    for (int i = 0; i < length; i++) out[i] = (char)(word >> (8 * i));
+    return length;
+}
+
+/* Returns: bytes read, or 0 if the varint is malformed or runs past end */
+static int read_uint(const char *in, const char *end, uint32_t *value) {
+    if (in >= end) return 0;
+    int length = 1;
+    while (length <= MAX_VARINT && ((unsigned char)in[0] >> (length - 1)) & 1) length++;
+    if (length > MAX_VARINT || in + length > end) return 0;
+    uint64_t word = 0;
+    for (int i = 0; i < length; i++) word |= (uint64_t)(unsigned char)in[i] << (8 * i);
+    word >>= length;
+    if (word > UINT32_MAX) return 0;
+    *value = (uint32_t)word;
+    return length;
+}
+
+int vm_encode(char *out, unsigned char op, const int32_t *args) {
+    int size = 0;
+    out[size++] = (char)op;
+    const char *kinds = op < OPCODE_COUNT ? operand_kinds[op] : "";
+    for (int i = 0; kinds[i]; i++) {
+        uint32_t value = kinds[i] == 'i' ? zigzag(args[i]) : (uint32_t)args[i];
+        size += write_uint(out + size, value);
+    }
+    return size;
+}
+
+int vm_decode(const char *code, int code_size, int ip, VmInstruction *insn) {
+    if (ip < 0 || ip >= code_size) return 0;
+    unsigned char op = (unsigned char)code[ip];
+    if (op >= OPCODE_COUNT) return 0;
+
+    const char *end = code + code_size;
+    const char *p = code + ip + 1;
+    const char *kinds = operand_kinds[op];
+    insn->op = op;
+    insn->operand_count = (int)strlen(kinds);
+    for (int i = 0; kinds[i]; i++) {
+        uint32_t value;
+        int length = read_uint(p, end, &value);
+        if (length == 0) return 0;
+        insn->args[i] = kinds[i] == 'i' ? (int32_t)((value >> 1) ^ (0u - (value & 1))) : (int32_t)value;
+        p += length;
+    }
+    insn->length = (int)(p - (code + ip));
+    return insn->length;
+}
+
+/* Stack effect of an opcode: values popped and pushed */
+static void stack_effect(unsigned char op, int *pops, int *pushes) {
+    *pops = 0;
+    *pushes = 0;
+    switch (op) {
+        case OP_PUSH: case OP_CONST: case OP_LOAD: *pushes = 1; break;
+        case OP_STORE: case OP_PRINT: *pops = 1; break;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: *pops = 2; *pushes = 1; break;
+        default: break;
+    }
+}
+
+int vm_verify(const char *code, int code_size, int const_count) {
+    VmInstruction insn = {0};
+    int ip = 0;
+    int depth = 0;
+    int max_depth = (int)(sizeof(((ToyVM *)0)->stack) / sizeof(int));
+    while (ip < code_size) {
+        if (!vm_decode(code, code_size, ip, &insn)) return 1;
+        const char *kinds = operand_kinds[insn.op];
+        for (int i = 0; kinds[i]; i++) {
+            if (kinds[i] == 'v' && (insn.args[i] < 0 || insn.args[i] >= VAR_COUNT)) return 1;
+            if (kinds[i] == 'c' && (insn.args[i] < 0 || insn.args[i] >= const_count)) return 1;
+        }
+        /* Code is straight-line, so one pass finds the deepest stack */
+        int pops, pushes;
+        stack_effect(insn.op, &pops, &pushes);
+        if (depth < pops) return 1;
+        depth += pushes - pops;
+        if (depth > max_depth) return 1;
+        ip += insn.length;
+    }
+    /* The loop stops only at HALT */
+    return code_size == 0 || insn.op != OP_HALT;
+}
+
+static void put_u32(char *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out[i] = (char)(value >> (8 * i));
+}
+
+static uint32_t get_u32(const char *in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value |= (uint32_t)(unsigned char)in[i] << (8 * i);
+    return value;
+}
+
+/* FNV-1a. Catches truncated, bit-flipped or hand-edited files; it is not a
+ * defence against deliberate tampering, which is vm_verify's job. */
+static uint32_t checksum(const char *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int vm_save_bytecode(const ToyVM *vm, char **image, int *image_size) {
+    size_t size = TOYVM_BYTECODE_HEADER_SIZE + 4 * (size_t)vm->const_count + vm->code_size + VM_CODE_PADDING;
+    if (size > INT32_MAX) return 1;
+    char *out = calloc(size, 1);
+    if (!out) return 1;
+
+    memcpy(out, TOYVM_BYTECODE_MAGIC, 4);
+    out[4] = TOYVM_BYTECODE_VERSION;
+    put_u32(out + 12, (uint32_t)vm->const_count);
+    put_u32(out + 16, (uint32_t)vm->code_size);
+    char *p = out + TOYVM_BYTECODE_HEADER_SIZE;
+    for (int i = 0; i < vm->const_count; i++, p += 4) {
+        put_u32(p, (uint32_t)vm->consts[i]);
+    }
+    memcpy(p, vm->code, vm->code_size);
+    put_u32(out + 8, checksum(out + TOYVM_BYTECODE_HEADER_SIZE, size - TOYVM_BYTECODE_HEADER_SIZE));
+
+    *image = out;
+    *image_size = (int)size;
+    return 0;
+}
+
+/* Validates everything about an image, including its code; on success the
+ * constants start at the header's end and the code follows them */
+static int check_image(const char *image, size_t image_size, uint32_t *const_count, uint32_t *code_size) {
+    if (image_size < TOYVM_BYTECODE_HEADER_SIZE || memcmp(image, TOYVM_BYTECODE_MAGIC, 4) != 0) {
+        fprintf(stderr, "Error: Not ToyVM bytecode\n");
+        return 1;
+    }
+    if (image[4] != TOYVM_BYTECODE_VERSION) {
+        fprintf(stderr, "Error: Bytecode version %d, expected %d\n", (unsigned char)image[4], TOYVM_BYTECODE_VERSION);
+        return 1;
+    }
+    *const_count = get_u32(image + 12);
+    *code_size = get_u32(image + 16);
+    uint64_t expected = TOYVM_BYTECODE_HEADER_SIZE + 4 * (uint64_t)*const_count + *code_size + VM_CODE_PADDING;
+    if (expected != image_size || *const_count > INT32_MAX || *code_size > INT32_MAX) {
+        fprintf(stderr, "Error: Bytecode is truncated\n");
+        return 1;
+    }
+    if (checksum(image + TOYVM_BYTECODE_HEADER_SIZE, image_size - TOYVM_BYTECODE_HEADER_SIZE) != get_u32(image + 8)) {
+        fprintf(stderr, "Error: Bytecode checksum mismatch\n");
+        return 1;
+    }
+    const char *code = image + TOYVM_BYTECODE_HEADER_SIZE + 4 * (size_t)*const_count;
+    if (vm_verify(code, (int)*code_size, (int)*const_count) != 0) {
+        fprintf(stderr, "Error: Bytecode failed verification\n");
+        return 1;
+    }
+    return 0;
+}
+
+int vm_load_bytecode(ToyVM *vm, const char *image, int image_size) {
+    uint32_t const_count, code_size;
+    if (image_size < 0 || check_image(image, (size_t)image_size, &const_count, &code_size) != 0) return 1;
+
+    const char *p = image + TOYVM_BYTECODE_HEADER_SIZE;
+    int32_t *consts = malloc(sizeof(int32_t) * (const_count ? const_count : 1));
+    for (uint32_t i = 0; i < const_count; i++, p += 4) {
+        consts[i] = (int32_t)get_u32(p);
+    }
+    char *code = malloc(code_size + VM_CODE_PADDING);
+    memcpy(code, p, code_size + VM_CODE_PADDING);
+    vm_set_program(vm, code, (int)code_size, consts, (int)const_count);
+    return 0;
+}
+
+int vm_save_bytecode_file(const ToyVM *vm, const char *path) {
+    char *image;
+    int image_size;
+    if (vm_save_bytecode(vm, &image, &image_size) != 0) {
+        fprintf(stderr, "Error: Program too large to save\n");
+        return 1;
+    }
+    FILE *file = fopen(path, "wb");
+    int failed = !file || fwrite(image, 1, image_size, file) != (size_t)image_size;
+    if (file && fclose(file) != 0) failed = 1;
+    if (failed) fprintf(stderr, "Error: Cannot write %s: %s\n", path, strerror(errno));
+    free(image);
+    return failed;
+}
+
+int vm_map_bytecode_file(ToyVM *vm, const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size < TOYVM_BYTECODE_HEADER_SIZE || size > INT32_MAX) {
+        close(fd);
+        fprintf(stderr, "Error: Not ToyVM bytecode\n");
+        return 1;
+    }
+    char *image = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    /* The constants are little-endian, so they cannot be used in place */
+    int result = vm_load_bytecode(vm, image, (int)size);
+    munmap(image, size);
+    return result;
+#else
+    uint32_t const_count, code_size;
+    if (check_image(image, size, &const_count, &code_size) != 0) {
+        munmap(image, size);
+        return 1;
+    }
+    /* The header keeps the constants 4-byte aligned in the page-aligned map */
+    int32_t *consts = (int32_t *)(image + TOYVM_BYTECODE_HEADER_SIZE);
+    vm_set_program(vm, (char *)(consts + const_count), (int)code_size, consts, (int)const_count);
+    vm->mapping = image;
+    vm->mapping_size = size;
+    return 0;
+#endif
+}
+
+int vm_is_bytecode_file(const char *path) {
+    char magic[4];
+    FILE *file = fopen(path, "rb");
+    if (!file) return 0;
+    int is_bytecode = fread(magic, 1, 4, file) == 4 && memcmp(magic, TOYVM_BYTECODE_MAGIC, 4) == 0;
+    fclose(file);
+    return is_bytecode;
+}
@@ -0,0 +1,176 @@
+/* toyvm_emit_c.c - Ahead-of-time C backend for ToyVM (--emit-c)
+ *
+ * vm_emit_c writes verified stack bytecode (plain or peephole-optimized) as
+ * one self-contained C function over int vars[26]. Each stack slot becomes
+ * a local (s0, s1, ...), so LOAD x, PUSH 3, ADD, STORE x reads as
+ * s0 = vars[x]; s1 = 3; s0 = TOY_ADD(s0, s1); vars[x] = s0; and the C
+ * compiler's own register allocation and constant propagation do the rest.
+ *
+ * The generated code keeps the VM's semantics: arithmetic wraps (it goes
+ * through unsigned, since signed overflow would let the compiler assume it
+ * never happens, and INT_MIN / -1 is INT_MIN), PRINT uses the same format,
+ * and a division by zero reports the same error and returns 1 with earlier
+ * stores in place.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "toyvm.h"
+
+/* Writes value as a C int expression; INT_MIN has no literal */
+static void emit_int(FILE *out, int32_t value) {
+    if (value == INT32_MIN) {
+        fputs("(-2147483647 - 1)", out);
+    } else {
+        fprintf(out, "%d", value);
+    }
+}
+
+/* Writes text as a C string literal */
+static void emit_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++) {
+        if (*c == '\n') {
+            fputs("\\n", out);
+        } else if (*c == '"' || *c == '\\') {
+            fprintf(out, "\\%c", *c);
+        } else if (*c < 32 || *c >= 127) {
+            fprintf(out, "\\%03o", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/* Wrapping macro for a stack or fused arithmetic opcode; division is separate,
+ * since it checks for zero first */
+static const char *arithmetic_macro(unsigned char op) {
+    switch (op) {
+        case OP_ADD: case OP_ADD_VV_STORE: case OP_INC_VAR_IMM: return "TOY_ADD";
+        case OP_SUB: case OP_SUB_VV_STORE: case OP_DEC_VAR_IMM: return "TOY_SUB";
+        default: return "TOY_MUL";
+    }
+}
+
+int vm_emit_c(const ToyVM *vm, const char *function, FILE *out) {
+    /* Rules out bad slots, pool indices and stack underflow up front */
+    if (vm_verify(vm->code, vm->code_size, vm->const_count) != 0) return -1;
+
+    /* First pass: the deepest stack, to declare one local per slot */
+    int depth = 0, max_depth = 0;
+    VmInstruction insn;
+    for (int ip = 0; ip < vm->code_size; ip += insn.length) {
+        vm_decode(vm->code, vm->code_size, ip, &insn);
+        switch (insn.op) {
+            case OP_PUSH: case OP_CONST: case OP_LOAD: depth++; break;
+            case OP_STORE: case OP_PRINT: case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: depth--; break;
+            default: break;
+        }
+        if (depth > max_depth) max_depth = depth;
+    }
+
+    fprintf(out, "/* Generated by toyvm --emit-c. %s runs the program on vars (a-z) and\n"
+                 " * returns 0, or 1 after a division by zero. Build with -DTOY_MAIN for a\n"
+                 " * standalone executable. */\n", function);
+    fputs("#include <stdio.h>\n\n", out);
+    fputs("/* Arithmetic wraps like the VM's */\n", out);
+    fputs("#define TOY_ADD(a, b) ((int)((unsigned)(a) + (unsigned)(b)))\n", out);
+    fputs("#define TOY_SUB(a, b) ((int)((unsigned)(a) - (unsigned)(b)))\n", out);
+    fputs("#define TOY_MUL(a, b) ((int)((unsigned)(a) * (unsigned)(b)))\n", out);
+    fputs("#define TOY_DIV(a, b) ((b) == -1 ? TOY_SUB(0, a) : (a) / (b))\n", out);
+    fputs("#define TOY_FORMAT ", out);
+    emit_string(out, COLOR_GREY "%d" COLOR_RESET "\n");
+    fprintf(out, "\n\nint %s(int vars[26]) {\n", function);
+    for (int slot = 0; slot < max_depth; slot++) {
+        fprintf(out, "%s s%d", slot == 0 ? "    int" : ",", slot);
+    }
+    if (max_depth > 0) fputs(";\n", out);
+
+    int can_fail = 0;
+    depth = 0;
+    for (int ip = 0; ip < vm->code_size; ip += insn.length) {
+        vm_decode(vm->code, vm->code_size, ip, &insn);
+        const int32_t *args = insn.args;
+        unsigned char op = insn.op;
+
+        switch (op) {
+            case OP_PUSH:
+            case OP_CONST:
+                fprintf(out, "    s%d = ", depth++);
+                emit_int(out, op == OP_CONST ? vm->consts[args[0]] : args[0]);
+                fputs(";\n", out);
+                break;
+            case OP_STORE:
+                fprintf(out, "    vars[%d] = s%d;\n", args[0], --depth);
+                break;
+            case OP_LOAD:
+                fprintf(out, "    s%d = vars[%d];\n", depth++, args[0]);
+                break;
+            case OP_ADD: case OP_SUB: case OP_MUL:
+                depth--;
+                fprintf(out, "    s%d = %s(s%d, s%d);\n", depth - 1, arithmetic_macro(op), depth - 1, depth);
+                break;
+            case OP_DIV:
+                depth--;
+                fprintf(out, "    if (s%d == 0) goto division_by_zero;\n", depth);
+                fprintf(out, "    s%d = TOY_DIV(s%d, s%d);\n", depth - 1, depth - 1, depth);
+                can_fail = 1;
+                break;
+            case OP_PRINT:
+                fprintf(out, "    printf(TOY_FORMAT, s%d);\n", --depth);
+                break;
+            case OP_HALT:
+                break;
+            case OP_STORE_IMM:
+                fprintf(out, "    vars[%d] = ", args[0]);
+                emit_int(out, args[1]);
+                fputs(";\n", out);
+                break;
+            case OP_ADD_VV_STORE: case OP_SUB_VV_STORE: case OP_MUL_VV_STORE:
+                fprintf(out, "    vars[%d] = %s(vars[%d], vars[%d]);\n",
+                        args[0], arithmetic_macro(op), args[1], args[2]);
+                break;
+            case OP_DIV_VV_STORE:
+                fprintf(out, "    if (vars[%d] == 0) goto division_by_zero;\n", args[2]);
+                fprintf(out, "    vars[%d] = TOY_DIV(vars[%d], vars[%d]);\n", args[0], args[1], args[2]);
+                can_fail = 1;
+                break;
+            case OP_INC_VAR_IMM: case OP_DEC_VAR_IMM: case OP_MUL_VAR_IMM:
+                fprintf(out, "    vars[%d] = %s(vars[%d], ", args[0], arithmetic_macro(op), args[0]);
+                emit_int(out, args[1]);
+                fputs(");\n", out);
+                break;
+            case OP_DIV_VAR_IMM:
+                if (args[1] == 0) {
+                    fputs("    goto division_by_zero;\n", out);
+                    can_fail = 1;
+                } else {
+                    fprintf(out, "    vars[%d] = TOY_DIV(vars[%d], ", args[0], args[0]);
+                    emit_int(out, args[1]);
+                    fputs(");\n", out);
+                }
+                break;
+            case OP_LOAD_PRINT:
+                fprintf(out, "    printf(TOY_FORMAT, vars[%d]);\n", args[0]);
+                break;
+        }
+        if (op == OP_HALT) break;
+    }
+
+    fputs("    return 0;\n", out);
+    if (can_fail) {
+        fputs("division_by_zero:\n", out);
+        fputs("    fprintf(stderr, \"Error: Division by zero\\n\");\n", out);
+        fputs("    return 1;\n", out);
+    }
+    fputs("}\n\n", out);
+    fputs("#ifdef TOY_MAIN\n", out);
+    fputs("int main(void) {\n", out);
+    fputs("    int vars[26] = {0};\n", out);
+    fprintf(out, "    return %s(vars);\n", function);
+    fputs("}\n", out);
+    fputs("#endif\n", out);
+    return 0;
+}
@@ -0,0 +1,217 @@
+/* toyvm_jit.c - Copy-and-patch native code backend for ToyVM (Linux x86-64)
+ *
+ * jit_compile turns verified stack bytecode (plain or peephole-optimized)
+ * into one native function, int (*)(int *vars), by copying a fixed machine
+ * code template per opcode and patching its holes: variable displacements,
+ * immediates, and the jumps to the shared exit and division-error stubs.
+ * There is no register allocation; variables stay in vm->vars (addressed
+ * through rbx), and the operand stack is the native stack, so LOAD is a
+ * mov and a push and ADD is two pops, an add and a push. What disappears
+ * is dispatch and operand decoding, which is most of an interpreter's
+ * time on straight-line code.
+ *
+ * Code is written into an anonymous mapping that is never writable and
+ * executable at once: it is filled read-write, then flipped to
+ * read-execute with mprotect before anything runs. On other platforms,
+ * or if mapping fails, jit_compile returns -1 and the VM keeps
+ * interpreting.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "toyvm.h"
+
+#if TOYVM_JIT
+#include <sys/mman.h>
+
+/* What a hole in a template is patched with */
+typedef enum {
+    HOLE_NONE,
+    HOLE_SLOT,   // disp32: byte offset of variable args[arg] in vars
+    HOLE_IMM,    // imm32: args[arg] (a CONST's index already resolved to its value)
+    HOLE_ERROR,  // rel32: division-by-zero stub
+    HOLE_EXIT,   // rel32: epilogue
+    HOLE_PRINT   // imm64: address of jit_print
+} HoleKind;
+
+typedef struct {
+    unsigned char offset;
+    unsigned char kind;
+    unsigned char arg;
+} Hole;
+
+typedef struct {
+    const char *code;
+    unsigned char size;
+    Hole holes[4];
+} Template;
+
+#define T(bytes, ...) {bytes, sizeof(bytes) - 1, {__VA_ARGS__}}
+
+/* pop rdi is the value; realign rsp for the call and restore it after:
+ * mov rbp, rsp; and rsp, -16; mov rax, jit_print; call rax; mov rsp, rbp */
+#define PRINT_CALL "\x48\x89\xe5\x48\x83\xe4\xf0\x48\xb8\0\0\0\0\0\0\0\0\xff\xd0\x48\x89\xec"
+
+/* eax = eax / ecx for a non-zero ecx, wrapping like vm_div: idiv traps on
+ * INT_MIN / -1, so a divisor of -1 is a neg instead:
+ * cmp ecx, -1; jne div; neg eax; jmp done; div: cdq; idiv ecx; done: */
+#define WRAPPING_IDIV "\x83\xf9\xff\x75\x04\xf7\xd8\xeb\x03\x99\xf7\xf9"
+
+/* Operands: eax and ecx are scratch, rbx points at vars */
+static const Template templates[] = {
+    /* push imm32 */
+    [OP_PUSH] = T("\x68\0\0\0\0", {1, HOLE_IMM, 0}),
+    [OP_CONST] = T("\x68\0\0\0\0", {1, HOLE_IMM, 0}),
+    /* pop rax; mov [rbx+x], eax */
+    [OP_STORE] = T("\x58\x89\x83\0\0\0\0", {3, HOLE_SLOT, 0}),
+    /* mov eax, [rbx+x]; push rax */
+    [OP_LOAD] = T("\x8b\x83\0\0\0\0\x50", {2, HOLE_SLOT, 0}),
+    /* pop rcx; pop rax; op eax, ecx; push rax */
+    [OP_ADD] = T("\x59\x58\x01\xc8\x50"),
+    [OP_SUB] = T("\x59\x58\x29\xc8\x50"),
+    [OP_MUL] = T("\x59\x58\x0f\xaf\xc1\x50"),
+    /* pop rcx; pop rax; test ecx, ecx; jz error; divide; push rax */
+    [OP_DIV] = T("\x59\x58\x85\xc9\x0f\x84\0\0\0\0" WRAPPING_IDIV "\x50", {6, HOLE_ERROR, 0}),
+    /* pop rdi; print */
+    [OP_PRINT] = T("\x5f" PRINT_CALL, {10, HOLE_PRINT, 0}),
+    /* xor eax, eax; jmp exit */
+    [OP_HALT] = T("\x31\xc0\xe9\0\0\0\0", {3, HOLE_EXIT, 0}),
+    /* mov dword [rbx+x], imm32 */
+    [OP_STORE_IMM] = T("\xc7\x83\0\0\0\0\0\0\0\0", {2, HOLE_SLOT, 0}, {6, HOLE_IMM, 1}),
+    /* mov eax, [rbx+a]; op eax, [rbx+b]; mov [rbx+d], eax */
+    [OP_ADD_VV_STORE] = T("\x8b\x83\0\0\0\0\x03\x83\0\0\0\0\x89\x83\0\0\0\0",
+                          {2, HOLE_SLOT, 1}, {8, HOLE_SLOT, 2}, {14, HOLE_SLOT, 0}),
+    [OP_SUB_VV_STORE] = T("\x8b\x83\0\0\0\0\x2b\x83\0\0\0\0\x89\x83\0\0\0\0",
+                          {2, HOLE_SLOT, 1}, {8, HOLE_SLOT, 2}, {14, HOLE_SLOT, 0}),
+    [OP_MUL_VV_STORE] = T("\x8b\x83\0\0\0\0\x0f\xaf\x83\0\0\0\0\x89\x83\0\0\0\0",
+                          {2, HOLE_SLOT, 1}, {9, HOLE_SLOT, 2}, {15, HOLE_SLOT, 0}),
+    /* mov ecx, [rbx+b]; test ecx, ecx; jz error; mov eax, [rbx+a]; divide; mov [rbx+d], eax */
+    [OP_DIV_VV_STORE] = T("\x8b\x8b\0\0\0\0\x85\xc9\x0f\x84\0\0\0\0\x8b\x83\0\0\0\0" WRAPPING_IDIV "\x89\x83\0\0\0\0",
+                          {2, HOLE_SLOT, 2}, {10, HOLE_ERROR, 0}, {16, HOLE_SLOT, 1}, {34, HOLE_SLOT, 0}),
+    /* add/sub dword [rbx+x], imm32 */
+    [OP_INC_VAR_IMM] = T("\x81\x83\0\0\0\0\0\0\0\0", {2, HOLE_SLOT, 0}, {6, HOLE_IMM, 1}),
+    [OP_DEC_VAR_IMM] = T("\x81\xab\0\0\0\0\0\0\0\0", {2, HOLE_SLOT, 0}, {6, HOLE_IMM, 1}),
+    /* mov eax, [rbx+x]; imul eax, eax, imm32; mov [rbx+x], eax */
+    [OP_MUL_VAR_IMM] = T("\x8b\x83\0\0\0\0\x69\xc0\0\0\0\0\x89\x83\0\0\0\0",
+                         {2, HOLE_SLOT, 0}, {8, HOLE_IMM, 1}, {14, HOLE_SLOT, 0}),
+    /* mov ecx, imm32; test ecx, ecx; jz error; mov eax, [rbx+x]; divide; mov [rbx+x], eax */
+    [OP_DIV_VAR_IMM] = T("\xb9\0\0\0\0\x85\xc9\x0f\x84\0\0\0\0\x8b\x83\0\0\0\0" WRAPPING_IDIV "\x89\x83\0\0\0\0",
+                         {1, HOLE_IMM, 1}, {9, HOLE_ERROR, 0}, {15, HOLE_SLOT, 0}, {33, HOLE_SLOT, 0}),
+    /* mov edi, [rbx+x]; print */
+    [OP_LOAD_PRINT] = T("\x8b\xbb\0\0\0\0" PRINT_CALL, {2, HOLE_SLOT, 0}, {15, HOLE_PRINT, 0}),
+};
+
+/* push rbx; push rbp; push r12; mov rbx, rdi; mov r12, rsp
+ * Three pushes leave rsp 16-byte aligned, and r12 keeps the stack base so
+ * the epilogue can drop whatever the program left on the operand stack. */
+static const char prologue[] = "\x53\x55\x41\x54\x48\x89\xfb\x49\x89\xe4";
+
+/* error: mov eax, 1; then the epilogue:
+ * exit: mov rsp, r12; pop r12; pop rbp; pop rbx; ret */
+static const char error_stub[] = "\xb8\x01\0\0\0";
+static const char epilogue[] = "\x4c\x89\xe4\x41\x5c\x5d\x5b\xc3";
+
+static void jit_print(int value) {
+    printf(COLOR_GREY "%d" COLOR_RESET "\n", value);
+}
+
+static void patch32(char *at, int32_t value) {
+    memcpy(at, &value, sizeof(value));
+}
+
+int jit_compile(ToyVM *vm) {
+    if (vm_verify(vm->code, vm->code_size, vm->const_count) != 0) return -1;
+
+    /* First pass: size, so the stubs' offsets are known before emitting */
+    size_t size = sizeof(prologue) - 1;
+    VmInstruction insn;
+    for (int ip = 0; ip < vm->code_size; ip += insn.length) {
+        vm_decode(vm->code, vm->code_size, ip, &insn);
+        size += templates[insn.op].size;
+    }
+    size_t error_offset = size;
+    size_t exit_offset = error_offset + sizeof(error_stub) - 1;
+    size += sizeof(error_stub) - 1 + sizeof(epilogue) - 1;
+
+    char *code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) return -1;
+
+    char *out = code;
+    memcpy(out, prologue, sizeof(prologue) - 1);
+    out += sizeof(prologue) - 1;
+    for (int ip = 0; ip < vm->code_size; ip += insn.length) {
+        vm_decode(vm->code, vm->code_size, ip, &insn);
+        const Template *t = &templates[insn.op];
+        int32_t args[3];
+        memcpy(args, insn.args, sizeof(args));
+        if (insn.op == OP_CONST) args[0] = vm->consts[args[0]];
+
+        memcpy(out, t->code, t->size);
+        for (int h = 0; h < 4 && t->holes[h].kind != HOLE_NONE; h++) {
+            const Hole *hole = &t->holes[h];
+            char *at = out + hole->offset;
+            switch (hole->kind) {
+                case HOLE_SLOT: patch32(at, args[hole->arg] * (int32_t)sizeof(int)); break;
+                case HOLE_IMM: patch32(at, args[hole->arg]); break;
+                case HOLE_ERROR: patch32(at, (int32_t)(code + error_offset - (at + 4))); break;
+                case HOLE_EXIT: patch32(at, (int32_t)(code + exit_offset - (at + 4))); break;
+                case HOLE_NONE: break;
+                case HOLE_PRINT: {
+                    uint64_t address = (uint64_t)(uintptr_t)jit_print;
+                    memcpy(at, &address, sizeof(address));
+                    break;
+                }
+            }
+        }
+        out += t->size;
+    }
+    memcpy(out, error_stub, sizeof(error_stub) - 1);
+    out += sizeof(error_stub) - 1;
+    memcpy(out, epilogue, sizeof(epilogue) - 1);
+
+    /* W^X: never writable and executable at the same time */
+    if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, size);
+        return -1;
+    }
+    vm->jit_code = code;
+    vm->jit_size = size;
+    return 0;
+}
+
+void jit_free(ToyVM *vm) {
+    if (vm->jit_code) munmap(vm->jit_code, vm->jit_size);
+    vm->jit_code = NULL;
+    vm->jit_size = 0;
+}
+
+void jit_execute(ToyVM *vm) {
+    int (*run)(int *vars) = (int (*)(int *))vm->jit_code;
+    int status = run(vm->vars);
+    if (status != 0) fprintf(stderr, "Error: Division by zero\n");
+    vm->sp = 0;
+    vm->ip = status == 0 ? vm->code_size : -1;  // No bytecode offset for the failing division
+}
+
+#else /* !TOYVM_JIT */
+
+int jit_compile(ToyVM *vm) {
+    (void)vm;
+    return -1;
+}
+
+void jit_free(ToyVM *vm) {
+    vm->jit_code = NULL;
+    vm->jit_size = 0;
+}
+
+void jit_execute(ToyVM *vm) {
+    (void)vm;
+}
+
+#endif /* TOYVM_JIT */
+
+int vm_has_jit(void) {
+    return TOYVM_JIT;
+}
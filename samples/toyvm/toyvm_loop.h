@@ -0,0 +1,217 @@
+/* toyvm_loop.h - The bytecode execution loop, instantiated once per variant by toyvm.c
+ *
+ * Define before including:
+ * - VM_LOOP_NAME: name of the static function to generate
+ * - VM_LOOP_THREADED: 1 for direct-threaded dispatch through computed gotos
+ *   (GCC/Clang only), 0 for the portable switch
+ * - VM_LOOP_TRACE: 1 to print every instruction as it runs (--debug)
+ *
+ * Tracing is a separate instantiation, so the production loops carry no
+ * per-instruction debug checks. The threaded variant also drops the bounds
+ * check on ip: bytecode from interpret always ends in OP_HALT, and unknown
+ * opcodes jump to an error handler through the 256-entry target table.
+ * Operands are read with vm_read_uint/vm_read_int, which never branch on
+ * their width; slots and pool indices are trusted (see vm_verify).
+ */
+
+#if VM_LOOP_TRACE
+#define VM_TRACE(...) printf(__VA_ARGS__)
+#else
+#define VM_TRACE(...) ((void)0)
+#endif
+
+#define VM_UINT() vm_read_uint(code, &ip)
+#define VM_INT() vm_read_int(code, &ip)
+
+/* d = a op b and x = x op k, with the operands at code[ip] */
+#define VM_VV_STORE(name, op) do { \
+        uint32_t dest = VM_UINT(), lhs = VM_UINT(), rhs = VM_UINT(); \
+        vars[dest] = VM_WRAP(vars[lhs], op, vars[rhs]); \
+        VM_TRACE(name " %c = %c " #op " %c = %d\n", 'a' + dest, 'a' + lhs, 'a' + rhs, vars[dest]); \
+    } while (0)
+#define VM_VAR_IMM(name, op) do { \
+        uint32_t var = VM_UINT(); \
+        int32_t imm = VM_INT(); \
+        vars[var] = VM_WRAP(vars[var], op, imm); \
+        VM_TRACE(name " %c " #op "= %d -> %d\n", 'a' + var, imm, vars[var]); \
+    } while (0)
+
+#if VM_LOOP_THREADED
+#define VM_CASE(label, op) label:
+#define VM_DEFAULT(label) label:
+#define VM_NEXT() goto *targets[(unsigned char)code[ip++]]
+#else
+#define VM_CASE(label, op) case op:
+#define VM_DEFAULT(label) default:
+#define VM_NEXT() continue
+#endif
+
+static void VM_LOOP_NAME(ToyVM *vm) {
+    const char *code = vm->code;
+    const int32_t *consts = vm->consts;
+    int *stack = vm->stack;
+    int *vars = vm->vars;
+    int sp = 0;  // Every run starts with an empty stack, as vm_verify assumes
+    int ip = 0;
+    VM_TRACE("Executing %d bytes of bytecode:\n", vm->code_size);
+
+#if VM_LOOP_THREADED
+    /* Every byte starts out invalid; the opcodes then override their entries */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+    static const void *const targets[256] = {
+        [0 ... 255] = &&op_invalid,
+        [OP_PUSH] = &&op_push,
+        [OP_CONST] = &&op_const,
+        [OP_STORE] = &&op_store,
+        [OP_LOAD] = &&op_load,
+        [OP_ADD] = &&op_add,
+        [OP_SUB] = &&op_sub,
+        [OP_MUL] = &&op_mul,
+        [OP_DIV] = &&op_div,
+        [OP_PRINT] = &&op_print,
+        [OP_HALT] = &&op_halt,
+        [OP_STORE_IMM] = &&op_store_imm,
+        [OP_ADD_VV_STORE] = &&op_add_vv_store,
+        [OP_SUB_VV_STORE] = &&op_sub_vv_store,
+        [OP_MUL_VV_STORE] = &&op_mul_vv_store,
+        [OP_DIV_VV_STORE] = &&op_div_vv_store,
+        [OP_INC_VAR_IMM] = &&op_inc_var_imm,
+        [OP_DEC_VAR_IMM] = &&op_dec_var_imm,
+        [OP_MUL_VAR_IMM] = &&op_mul_var_imm,
+        [OP_DIV_VAR_IMM] = &&op_div_var_imm,
+        [OP_LOAD_PRINT] = &&op_load_print,
+    };
+#pragma GCC diagnostic pop
+    VM_NEXT();
+#else
+    while (ip < vm->code_size) {
+        switch ((unsigned char)code[ip++]) {
+#endif
+
+    VM_CASE(op_push, OP_PUSH)
+        stack[sp++] = VM_INT();
+        VM_TRACE("PUSH %d (sp=%d)\n", stack[sp - 1], sp);
+        VM_NEXT();
+    VM_CASE(op_const, OP_CONST)
+        stack[sp++] = consts[VM_UINT()];
+        VM_TRACE("CONST %d (sp=%d)\n", stack[sp - 1], sp);
+        VM_NEXT();
+    VM_CASE(op_store, OP_STORE) {
+        uint32_t var_idx = VM_UINT();
+        vars[var_idx] = stack[--sp];
+        VM_TRACE("STORE %c = %d (sp=%d)\n", 'a' + var_idx, vars[var_idx], sp);
+        VM_NEXT();
+    }
+    VM_CASE(op_load, OP_LOAD) {
+        uint32_t var_idx = VM_UINT();
+        stack[sp++] = vars[var_idx];
+        VM_TRACE("LOAD %c = %d (sp=%d)\n", 'a' + var_idx, stack[sp - 1], sp);
+        VM_NEXT();
+    }
+    VM_CASE(op_add, OP_ADD)
+        sp--;
+        VM_TRACE("ADD %d + %d = %d (sp=%d)\n", stack[sp - 1], stack[sp], VM_WRAP(stack[sp - 1], +, stack[sp]), sp);
+        stack[sp - 1] = VM_WRAP(stack[sp - 1], +, stack[sp]);
+        VM_NEXT();
+    VM_CASE(op_sub, OP_SUB)
+        sp--;
+        VM_TRACE("SUB %d - %d = %d (sp=%d)\n", stack[sp - 1], stack[sp], VM_WRAP(stack[sp - 1], -, stack[sp]), sp);
+        stack[sp - 1] = VM_WRAP(stack[sp - 1], -, stack[sp]);
+        VM_NEXT();
+    VM_CASE(op_mul, OP_MUL)
+        sp--;
+        VM_TRACE("MUL %d * %d = %d (sp=%d)\n", stack[sp - 1], stack[sp], VM_WRAP(stack[sp - 1], *, stack[sp]), sp);
+        stack[sp - 1] = VM_WRAP(stack[sp - 1], *, stack[sp]);
+        VM_NEXT();
+    VM_CASE(op_div, OP_DIV)
+        if (stack[sp - 1] == 0) {
+            fprintf(stderr, "Error: Division by zero\n");
+            goto done;
+        }
+        sp--;
+        VM_TRACE("DIV %d / %d = %d (sp=%d)\n", stack[sp - 1], stack[sp], vm_div(stack[sp - 1], stack[sp]), sp);
+        stack[sp - 1] = vm_div(stack[sp - 1], stack[sp]);
+        VM_NEXT();
+    VM_CASE(op_print, OP_PRINT)
+        printf(COLOR_GREY "%d" COLOR_RESET "\n", stack[--sp]);
+        VM_TRACE("PRINT %d (sp=%d)\n", stack[sp], sp);
+        VM_NEXT();
+    /* Superinstructions from the peephole pass; operands are variable slots
+     * (d, a, b, x) and immediates (k) */
+    VM_CASE(op_store_imm, OP_STORE_IMM) {
+        uint32_t var = VM_UINT();
+        vars[var] = VM_INT();
+        VM_TRACE("STORE_IMM %c = %d\n", 'a' + var, vars[var]);
+        VM_NEXT();
+    }
+    VM_CASE(op_add_vv_store, OP_ADD_VV_STORE)
+        VM_VV_STORE("ADD_VV_STORE", +);
+        VM_NEXT();
+    VM_CASE(op_sub_vv_store, OP_SUB_VV_STORE)
+        VM_VV_STORE("SUB_VV_STORE", -);
+        VM_NEXT();
+    VM_CASE(op_mul_vv_store, OP_MUL_VV_STORE)
+        VM_VV_STORE("MUL_VV_STORE", *);
+        VM_NEXT();
+    VM_CASE(op_div_vv_store, OP_DIV_VV_STORE) {
+        uint32_t dest = VM_UINT(), lhs = VM_UINT(), rhs = VM_UINT();
+        if (vars[rhs] == 0) {
+            fprintf(stderr, "Error: Division by zero\n");
+            goto done;
+        }
+        vars[dest] = vm_div(vars[lhs], vars[rhs]);
+        VM_TRACE("DIV_VV_STORE %c = %c / %c = %d\n", 'a' + dest, 'a' + lhs, 'a' + rhs, vars[dest]);
+        VM_NEXT();
+    }
+    VM_CASE(op_inc_var_imm, OP_INC_VAR_IMM)
+        VM_VAR_IMM("INC_VAR_IMM", +);
+        VM_NEXT();
+    VM_CASE(op_dec_var_imm, OP_DEC_VAR_IMM)
+        VM_VAR_IMM("DEC_VAR_IMM", -);
+        VM_NEXT();
+    VM_CASE(op_mul_var_imm, OP_MUL_VAR_IMM)
+        VM_VAR_IMM("MUL_VAR_IMM", *);
+        VM_NEXT();
+    VM_CASE(op_div_var_imm, OP_DIV_VAR_IMM) {
+        uint32_t var = VM_UINT();
+        int32_t imm = VM_INT();
+        if (imm == 0) {
+            fprintf(stderr, "Error: Division by zero\n");
+            goto done;
+        }
+        vars[var] = vm_div(vars[var], imm);
+        VM_TRACE("DIV_VAR_IMM %c /= %d -> %d\n", 'a' + var, imm, vars[var]);
+        VM_NEXT();
+    }
+    VM_CASE(op_load_print, OP_LOAD_PRINT) {
+        uint32_t var = VM_UINT();
+        printf(COLOR_GREY "%d" COLOR_RESET "\n", vars[var]);
+        VM_TRACE("LOAD_PRINT %c\n", 'a' + var);
+        VM_NEXT();
+    }
+    VM_CASE(op_halt, OP_HALT)
+        VM_TRACE("HALT\n");
+        goto done;
+    VM_DEFAULT(op_invalid)
+        fprintf(stderr, "Error: Invalid opcode %d at offset %d\n", (unsigned char)code[ip - 1], ip - 1);
+        goto done;
+
+#if !VM_LOOP_THREADED
+        }
+    }
+#endif
+
+done:
+    vm->sp = sp;
+    vm->ip = ip;
+}
+
+#undef VM_TRACE
+#undef VM_CASE
+#undef VM_DEFAULT
+#undef VM_NEXT
+#undef VM_VV_STORE
+#undef VM_VAR_IMM
+#undef VM_UINT
+#undef VM_INT
@@ -0,0 +1,261 @@
+/* toyvm_peephole.c - Peephole optimizer for ToyVM bytecode
+ *
+ * toy_compile() emits the same short sequences for the common statement
+ * shapes, and each group can run as a single dispatch:
+ * - PUSH k, STORE x             -> STORE_IMM x k
+ * - LOAD a, LOAD b, op, STORE d -> ADD/SUB/MUL/DIV_VV_STORE d a b
+ * - LOAD x, PUSH k, op, STORE x -> INC/DEC/MUL/DIV_VAR_IMM x k
+ * - LOAD x, PRINT               -> LOAD_PRINT x
+ *
+ * PUSH and CONST (a pooled constant) both count as immediates. Constants
+ * stored earlier in the same program are then propagated forward, and
+ * arithmetic on known values folds into STORE_IMM. Finally a backward pass
+ * drops stores that are overwritten before anything reads them. Variables
+ * outlive the program (the shell runs each line against the same VM), so
+ * all of them are live at HALT, and at any division that might fail, since
+ * the VM stops there.
+ *
+ * Folded immediates can be wider than the code they replace, so the pass
+ * writes a new buffer. Bytecode that fails vm_verify is left untouched.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "toyvm.h"
+
+#define VAR_COUNT 26
+
+typedef struct {
+    unsigned char op;
+    int32_t args[3];
+    int32_t pushed;  // Value a PUSH or CONST puts on the stack
+    int may_fault;  // Division whose divisor is not known to be non-zero
+    int dead;       // Store nothing reads; dropped before encoding
+} Insn;
+
+static int is_push(unsigned char op) {
+    return op == OP_PUSH || op == OP_CONST;
+}
+
+static int is_arithmetic(unsigned char op) {
+    return op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_DIV;
+}
+
+/* Arithmetic opcode a fused instruction performs */
+static unsigned char base_op(unsigned char op) {
+    switch (op) {
+        case OP_ADD_VV_STORE: case OP_INC_VAR_IMM: return OP_ADD;
+        case OP_SUB_VV_STORE: case OP_DEC_VAR_IMM: return OP_SUB;
+        case OP_MUL_VV_STORE: case OP_MUL_VAR_IMM: return OP_MUL;
+        case OP_DIV_VV_STORE: case OP_DIV_VAR_IMM: return OP_DIV;
+        default: return op;
+    }
+}
+
+static unsigned char vv_store_op(unsigned char op) {
+    switch (op) {
+        case OP_ADD: return OP_ADD_VV_STORE;
+        case OP_SUB: return OP_SUB_VV_STORE;
+        case OP_MUL: return OP_MUL_VV_STORE;
+        default: return OP_DIV_VV_STORE;
+    }
+}
+
+static unsigned char var_imm_op(unsigned char op) {
+    switch (op) {
+        case OP_ADD: return OP_INC_VAR_IMM;
+        case OP_SUB: return OP_DEC_VAR_IMM;
+        case OP_MUL: return OP_MUL_VAR_IMM;
+        default: return OP_DIV_VAR_IMM;
+    }
+}
+
+static int is_vv_store(unsigned char op) {
+    return op >= OP_ADD_VV_STORE && op <= OP_DIV_VV_STORE;
+}
+
+static int is_var_imm(unsigned char op) {
+    return op >= OP_INC_VAR_IMM && op <= OP_DIV_VAR_IMM;
+}
+
+/* Returns: 1 with *result set when a op b is defined and fits an int, else 0 */
+static int evaluate(unsigned char op, long long a, long long b, long long *result) {
+    switch (op) {
+        case OP_ADD: *result = a + b; break;
+        case OP_SUB: *result = a - b; break;
+        case OP_MUL: *result = a * b; break;
+        case OP_DIV:
+            if (b == 0) return 0;
+            *result = a / b;
+            break;
+        default: return 0;
+    }
+    return *result >= -2147483647LL - 1 && *result <= 2147483647LL;
+}
+
+/* Returns: number of instructions decoded into insns */
+static int decode(const char *code, int code_size, const int32_t *consts, Insn *insns) {
+    int count = 0;
+    VmInstruction insn;
+    for (int ip = 0; ip < code_size; ip += insn.length, count++) {
+        vm_decode(code, code_size, ip, &insn);
+        memset(&insns[count], 0, sizeof(Insn));
+        insns[count].op = insn.op;
+        memcpy(insns[count].args, insn.args, sizeof(insn.args));
+        if (insn.op == OP_PUSH) insns[count].pushed = insn.args[0];
+        if (insn.op == OP_CONST) insns[count].pushed = consts[insn.args[0]];
+    }
+    return count;
+}
+
+/* Collapses the statement patterns compile() emits into superinstructions */
+static int fuse(Insn *insns, int count) {
+    int out = 0;
+    for (int i = 0; i < count; i++) {
+        Insn *in = &insns[i];
+        Insn fused = {0};
+        if (i + 1 < count && is_push(in[0].op) && in[1].op == OP_STORE) {
+            fused.op = OP_STORE_IMM;
+            fused.args[0] = in[1].args[0];
+            fused.args[1] = in[0].pushed;
+            i += 1;
+        } else if (i + 3 < count && in[0].op == OP_LOAD && in[1].op == OP_LOAD &&
+                   is_arithmetic(in[2].op) && in[3].op == OP_STORE) {
+            fused.op = vv_store_op(in[2].op);
+            fused.args[0] = in[3].args[0];
+            fused.args[1] = in[0].args[0];
+            fused.args[2] = in[1].args[0];
+            i += 3;
+        } else if (i + 3 < count && in[0].op == OP_LOAD && is_push(in[1].op) &&
+                   is_arithmetic(in[2].op) && in[3].op == OP_STORE &&
+                   in[3].args[0] == in[0].args[0]) {
+            fused.op = var_imm_op(in[2].op);
+            fused.args[0] = in[0].args[0];
+            fused.args[1] = in[1].pushed;
+            i += 3;
+        } else if (i + 1 < count && in[0].op == OP_LOAD && in[1].op == OP_PRINT) {
+            fused.op = OP_LOAD_PRINT;
+            fused.args[0] = in[0].args[0];
+            i += 1;
+        } else {
+            fused = *in;
+        }
+        insns[out++] = fused;
+    }
+    return out;
+}
+
+/* Propagates constants forward and folds arithmetic on known values */
+static void fold(Insn *insns, int count) {
+    int known[VAR_COUNT] = {0};
+    long long value[VAR_COUNT];
+
+    for (int i = 0; i < count; i++) {
+        Insn *insn = &insns[i];
+        unsigned char op = insn->op;
+        if (op == OP_STORE_IMM) {
+            known[insn->args[0]] = 1;
+            value[insn->args[0]] = insn->args[1];
+        } else if (is_vv_store(op) || is_var_imm(op)) {
+            unsigned char dest = insn->args[0];
+            int lhs_known, rhs_known;
+            long long lhs, rhs, result;
+            if (is_vv_store(op)) {
+                lhs_known = known[insn->args[1]];
+                lhs = value[insn->args[1]];
+                rhs_known = known[insn->args[2]];
+                rhs = value[insn->args[2]];
+            } else {
+                lhs_known = known[dest];
+                lhs = value[dest];
+                rhs_known = 1;
+                rhs = insn->args[1];
+            }
+            insn->may_fault = base_op(op) == OP_DIV && !(rhs_known && rhs != 0);
+
+            known[dest] = lhs_known && rhs_known && evaluate(base_op(op), lhs, rhs, &result);
+            if (known[dest]) {
+                value[dest] = result;
+                insn->op = OP_STORE_IMM;
+                insn->args[1] = (int32_t)result;
+            }
+        } else if (op == OP_STORE) {
+            known[insn->args[0]] = 0;
+        } else if (op == OP_DIV) {
+            insn->may_fault = 1;
+        }
+    }
+}
+
+/* Drops stores that are overwritten before being read */
+static int eliminate_dead_stores(Insn *insns, int count) {
+    int live[VAR_COUNT];
+    for (int v = 0; v < VAR_COUNT; v++) live[v] = 1;
+
+    for (int i = count - 1; i >= 0; i--) {
+        Insn *insn = &insns[i];
+        unsigned char op = insn->op;
+        int dest = -1;
+        int reads[2] = {-1, -1};
+
+        if (op == OP_STORE_IMM) {
+            dest = insn->args[0];
+        } else if (is_vv_store(op)) {
+            dest = insn->args[0];
+            reads[0] = insn->args[1];
+            reads[1] = insn->args[2];
+        } else if (is_var_imm(op)) {
+            dest = insn->args[0];
+            reads[0] = dest;
+        } else if (op == OP_LOAD_PRINT) {
+            reads[0] = insn->args[0];
+        } else if (op != OP_HALT) {
+            /* Unfused stack code: assume it may read anything */
+            for (int v = 0; v < VAR_COUNT; v++) live[v] = 1;
+            continue;
+        }
+
+        if (dest >= 0 && !live[dest] && !insn->may_fault) {
+            insn->dead = 1;
+            continue;
+        }
+        if (dest >= 0) live[dest] = 0;
+        for (int r = 0; r < 2; r++) {
+            if (reads[r] >= 0) live[reads[r]] = 1;
+        }
+        if (insn->may_fault) {
+            for (int v = 0; v < VAR_COUNT; v++) live[v] = 1;
+        }
+    }
+
+    int out = 0;
+    for (int i = 0; i < count; i++) {
+        if (insns[i].dead) continue;
+        insns[out++] = insns[i];
+    }
+    return out;
+}
+
+int peephole_optimize(char **code, int code_size, const int32_t *consts, int const_count) {
+    /* Also rules out slots outside a-z, which the tables below rely on */
+    if (vm_verify(*code, code_size, const_count) != 0) return code_size;
+
+    /* Every instruction is at least one byte */
+    Insn *insns = malloc(sizeof(Insn) * (code_size > 0 ? code_size : 1));
+    int count = decode(*code, code_size, consts, insns);
+    count = fuse(insns, count);
+    fold(insns, count);
+    count = eliminate_dead_stores(insns, count);
+
+    /* Opcode plus at most three 5-byte operands per instruction */
+    char *out = malloc(count * 16 + VM_CODE_PADDING);
+    int size = 0;
+    for (int i = 0; i < count; i++) {
+        size += vm_encode(out + size, insns[i].op, insns[i].args);
+    }
+    memset(out + size, 0, VM_CODE_PADDING);
+    free(insns);
+    free(*code);
+    *code = out;
+    return size;
+}
@@ -0,0 +1,224 @@
+/* toyvm_register.c - Register VM backend for ToyVM
+ *
+ * reg_translate turns stack bytecode (plain or peephole-optimized) into
+ * three-address instructions on a register file whose first 26 registers
+ * are the variables a-z. It walks the bytecode with an abstract stack of
+ * pending operands, so LOAD and PUSH cost nothing; an operator becomes one
+ * instruction writing a temporary, and the STORE that follows retargets
+ * that instruction at the variable instead of copying. `z = x + y` is
+ * therefore a single `ADD z, x, y` where the stack machine needs four
+ * dispatches and four stack pointer updates.
+ *
+ * Temporaries are numbered by stack depth from register 26 up. Code that
+ * needs none runs directly on vm->vars; otherwise reg_execute copies the
+ * variables into a local register file and back.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "toyvm.h"
+
+#define VAR_COUNT 26
+#define REG_FILE_SIZE 256
+
+/* Operand waiting on the abstract stack */
+typedef struct {
+    int is_imm;
+    int value;     // Immediate, or register number
+    int producer;  // Index of the instruction that wrote this temporary, or -1
+} Operand;
+
+typedef struct {
+    RegInsn *code;
+    int count;
+    int capacity;
+    int max_reg;
+} RegBuilder;
+
+static int emit_imm(RegBuilder *b, RegOpcode op, int rd, int ra, int32_t imm) {
+    if (b->count == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 16;
+        b->code = realloc(b->code, sizeof(RegInsn) * b->capacity);
+    }
+    b->code[b->count] = (RegInsn){(unsigned char)op, (unsigned char)rd, (unsigned char)ra, 0, imm};
+    if (rd > b->max_reg) b->max_reg = rd;
+    return b->count++;
+}
+
+static int emit(RegBuilder *b, RegOpcode op, int rd, int ra, int rb) {
+    int index = emit_imm(b, op, rd, ra, 0);
+    b->code[index].rb = (unsigned char)rb;
+    return index;
+}
+
+/* Register opcode for a stack arithmetic opcode */
+static RegOpcode binary_op(unsigned char op) {
+    switch (op) {
+        case OP_ADD: case OP_ADD_VV_STORE: case OP_INC_VAR_IMM: return ROP_ADD;
+        case OP_SUB: case OP_SUB_VV_STORE: case OP_DEC_VAR_IMM: return ROP_SUB;
+        case OP_MUL: case OP_MUL_VV_STORE: case OP_MUL_VAR_IMM: return ROP_MUL;
+        default: return ROP_DIV;
+    }
+}
+
+/* ADDI..DIVI are declared in the same order as ADD..DIV */
+static RegOpcode immediate_op(RegOpcode op) {
+    return (RegOpcode)(ROP_ADDI + (op - ROP_ADD));
+}
+
+/* Copies any pending read of variable var into a temporary before var is overwritten */
+static void spill_reads(RegBuilder *b, Operand *stack, int depth, int var) {
+    for (int i = 0; i < depth; i++) {
+        if (!stack[i].is_imm && stack[i].value == var) {
+            int temp = VAR_COUNT + i;
+            stack[i].producer = emit(b, ROP_MOV, temp, var, 0);
+            stack[i].value = temp;
+        }
+    }
+}
+
+/* Emits a op b into temp; returns the producing instruction */
+static int emit_binary(RegBuilder *b, RegOpcode op, Operand lhs, Operand rhs, int temp) {
+    int commutative = op == ROP_ADD || op == ROP_MUL;
+    if (!lhs.is_imm && !rhs.is_imm) return emit(b, op, temp, lhs.value, rhs.value);
+    if (!lhs.is_imm) return emit_imm(b, immediate_op(op), temp, lhs.value, rhs.value);
+    if (!rhs.is_imm && commutative) return emit_imm(b, immediate_op(op), temp, rhs.value, lhs.value);
+    emit_imm(b, ROP_LI, temp, 0, lhs.value);
+    if (rhs.is_imm) return emit_imm(b, immediate_op(op), temp, temp, rhs.value);
+    return emit(b, op, temp, temp, rhs.value);
+}
+
+int reg_translate(const char *code, int code_size, const int32_t *consts, int const_count,
+                  RegInsn **rcode, int *reg_count) {
+    /* Rules out bad slots, pool indices and stack underflow up front */
+    if (vm_verify(code, code_size, const_count) != 0) return -1;
+
+    RegBuilder b = {NULL, 0, 0, VAR_COUNT - 1};
+    Operand stack[REG_FILE_SIZE - VAR_COUNT];
+    int depth = 0;
+    VmInstruction insn;
+
+    for (int ip = 0; ip < code_size; ip += insn.length) {
+        vm_decode(code, code_size, ip, &insn);
+        const int32_t *args = insn.args;
+        unsigned char op = insn.op;
+
+        switch (op) {
+            case OP_PUSH:
+            case OP_CONST:
+            case OP_LOAD:
+                if (depth == REG_FILE_SIZE - VAR_COUNT) goto fail;
+                if (op == OP_CONST) {
+                    stack[depth++] = (Operand){1, consts[args[0]], -1};
+                } else {
+                    stack[depth++] = (Operand){op == OP_PUSH, args[0], -1};
+                }
+                break;
+            case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: {
+                Operand rhs = stack[--depth];
+                Operand lhs = stack[--depth];
+                int temp = VAR_COUNT + depth;
+                int producer = emit_binary(&b, binary_op(op), lhs, rhs, temp);
+                stack[depth++] = (Operand){0, temp, producer};
+                break;
+            }
+            case OP_STORE: {
+                Operand value = stack[--depth];
+                spill_reads(&b, stack, depth, args[0]);
+                if (value.producer == b.count - 1 && value.producer >= 0) {
+                    b.code[value.producer].rd = args[0];  // Write the variable directly
+                } else if (value.is_imm) {
+                    emit_imm(&b, ROP_LI, args[0], 0, value.value);
+                } else {
+                    emit(&b, ROP_MOV, args[0], value.value, 0);
+                }
+                break;
+            }
+            case OP_PRINT: {
+                Operand value = stack[--depth];
+                if (value.is_imm) {
+                    emit_imm(&b, ROP_LI, VAR_COUNT + depth, 0, value.value);
+                    value.value = VAR_COUNT + depth;
+                }
+                emit(&b, ROP_PRINT, 0, value.value, 0);
+                break;
+            }
+            case OP_HALT:
+                break;
+            case OP_STORE_IMM:
+                spill_reads(&b, stack, depth, args[0]);
+                emit_imm(&b, ROP_LI, args[0], 0, args[1]);
+                break;
+            case OP_ADD_VV_STORE: case OP_SUB_VV_STORE: case OP_MUL_VV_STORE: case OP_DIV_VV_STORE:
+                spill_reads(&b, stack, depth, args[0]);
+                emit(&b, binary_op(op), args[0], args[1], args[2]);
+                break;
+            case OP_INC_VAR_IMM: case OP_DEC_VAR_IMM: case OP_MUL_VAR_IMM: case OP_DIV_VAR_IMM:
+                spill_reads(&b, stack, depth, args[0]);
+                emit_imm(&b, immediate_op(binary_op(op)), args[0], args[0], args[1]);
+                break;
+            case OP_LOAD_PRINT:
+                emit(&b, ROP_PRINT, 0, args[0], 0);
+                break;
+        }
+        if (op == OP_HALT) break;
+    }
+    emit(&b, ROP_HALT, 0, 0, 0);
+    *rcode = b.code;
+    *reg_count = b.max_reg + 1;
+    return b.count;
+
+fail:
+    free(b.code);
+    return -1;
+}
+
+/* Loop variants; see toyvm_register_loop.h */
+#define REG_LOOP_NAME run_register_switch
+#define REG_LOOP_THREADED 0
+#define REG_LOOP_TRACE 0
+#include "toyvm_register_loop.h"
+#undef REG_LOOP_NAME
+#undef REG_LOOP_THREADED
+#undef REG_LOOP_TRACE
+
+#if TOYVM_THREADED
+#define REG_LOOP_NAME run_register_threaded
+#define REG_LOOP_THREADED 1
+#define REG_LOOP_TRACE 0
+#include "toyvm_register_loop.h"
+#undef REG_LOOP_NAME
+#undef REG_LOOP_THREADED
+#undef REG_LOOP_TRACE
+#endif
+
+#define REG_LOOP_NAME run_register_traced
+#define REG_LOOP_THREADED 0
+#define REG_LOOP_TRACE 1
+#include "toyvm_register_loop.h"
+#undef REG_LOOP_NAME
+#undef REG_LOOP_THREADED
+#undef REG_LOOP_TRACE
+
+void reg_execute(ToyVM *vm, VmDispatch dispatch, int trace) {
+    int file[REG_FILE_SIZE];
+    int *regs = vm->vars;
+    if (vm->reg_count > VAR_COUNT) {
+        memcpy(file, vm->vars, sizeof(vm->vars));
+        regs = file;
+    }
+
+    if (trace) {
+        run_register_traced(vm, regs);
+#if TOYVM_THREADED
+    } else if (dispatch == VM_DISPATCH_THREADED) {
+        run_register_threaded(vm, regs);
+#endif
+    } else {
+        run_register_switch(vm, regs);
+    }
+    (void)dispatch;
+
+    if (regs != vm->vars) memcpy(vm->vars, regs, sizeof(vm->vars));
+}
@@ -0,0 +1,134 @@
+/* toyvm_register_loop.h - The register VM loop, instantiated once per variant by toyvm_register.c
+ *
+ * Define before including:
+ * - REG_LOOP_NAME: name of the static function to generate
+ * - REG_LOOP_THREADED: 1 for computed-goto dispatch (GCC/Clang only), 0 for the switch
+ * - REG_LOOP_TRACE: 1 to print every instruction as it runs (--debug)
+ *
+ * Every instruction is one RegInsn, so the loop steps a pointer instead of
+ * decoding operand bytes. reg_translate always ends the code with HALT.
+ */
+
+#if REG_LOOP_TRACE
+#define REG_TRACE(...) printf(__VA_ARGS__)
+#else
+#define REG_TRACE(...) ((void)0)
+#endif
+
+#if REG_LOOP_THREADED
+#define REG_CASE(label, op) label:
+#define REG_DEFAULT(label) label:
+#define REG_NEXT() goto *targets[(++insn)->op]
+#else
+#define REG_CASE(label, op) case op:
+#define REG_DEFAULT(label) default:
+#define REG_NEXT() { insn++; continue; }
+#endif
+
+/* rd = ra op rb and rd = ra op imm */
+#define REG_BINARY(name, op) do { \
+        regs[insn->rd] = VM_WRAP(regs[insn->ra], op, regs[insn->rb]); \
+        REG_TRACE(name " r%d, r%d, r%d -> %d\n", insn->rd, insn->ra, insn->rb, regs[insn->rd]); \
+    } while (0)
+#define REG_IMMEDIATE(name, op) do { \
+        regs[insn->rd] = VM_WRAP(regs[insn->ra], op, insn->imm); \
+        REG_TRACE(name " r%d, r%d, %d -> %d\n", insn->rd, insn->ra, insn->imm, regs[insn->rd]); \
+    } while (0)
+
+static void REG_LOOP_NAME(ToyVM *vm, int *regs) {
+    const RegInsn *insn = vm->rcode;
+    REG_TRACE("Executing %d register instructions:\n", vm->rcode_count);
+
+#if REG_LOOP_THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+    static const void *const targets[256] = {
+        [0 ... 255] = &&rop_invalid,
+        [ROP_LI] = &&rop_li,
+        [ROP_MOV] = &&rop_mov,
+        [ROP_ADD] = &&rop_add,
+        [ROP_SUB] = &&rop_sub,
+        [ROP_MUL] = &&rop_mul,
+        [ROP_DIV] = &&rop_div,
+        [ROP_ADDI] = &&rop_addi,
+        [ROP_SUBI] = &&rop_subi,
+        [ROP_MULI] = &&rop_muli,
+        [ROP_DIVI] = &&rop_divi,
+        [ROP_PRINT] = &&rop_print,
+        [ROP_HALT] = &&rop_halt,
+    };
+#pragma GCC diagnostic pop
+    goto *targets[insn->op];
+#else
+    for (;;) {
+        switch (insn->op) {
+#endif
+
+    REG_CASE(rop_li, ROP_LI)
+        regs[insn->rd] = insn->imm;
+        REG_TRACE("LI r%d, %d\n", insn->rd, insn->imm);
+        REG_NEXT();
+    REG_CASE(rop_mov, ROP_MOV)
+        regs[insn->rd] = regs[insn->ra];
+        REG_TRACE("MOV r%d, r%d -> %d\n", insn->rd, insn->ra, regs[insn->rd]);
+        REG_NEXT();
+    REG_CASE(rop_add, ROP_ADD)
+        REG_BINARY("ADD", +);
+        REG_NEXT();
+    REG_CASE(rop_sub, ROP_SUB)
+        REG_BINARY("SUB", -);
+        REG_NEXT();
+    REG_CASE(rop_mul, ROP_MUL)
+        REG_BINARY("MUL", *);
+        REG_NEXT();
+    REG_CASE(rop_div, ROP_DIV)
+        if (regs[insn->rb] == 0) {
+            fprintf(stderr, "Error: Division by zero\n");
+            goto done;
+        }
+        regs[insn->rd] = vm_div(regs[insn->ra], regs[insn->rb]);
+        REG_TRACE("DIV r%d, r%d, r%d -> %d\n", insn->rd, insn->ra, insn->rb, regs[insn->rd]);
+        REG_NEXT();
+    REG_CASE(rop_addi, ROP_ADDI)
+        REG_IMMEDIATE("ADDI", +);
+        REG_NEXT();
+    REG_CASE(rop_subi, ROP_SUBI)
+        REG_IMMEDIATE("SUBI", -);
+        REG_NEXT();
+    REG_CASE(rop_muli, ROP_MULI)
+        REG_IMMEDIATE("MULI", *);
+        REG_NEXT();
+    REG_CASE(rop_divi, ROP_DIVI)
+        if (insn->imm == 0) {
+            fprintf(stderr, "Error: Division by zero\n");
+            goto done;
+        }
+        regs[insn->rd] = vm_div(regs[insn->ra], insn->imm);
+        REG_TRACE("DIVI r%d, r%d, %d -> %d\n", insn->rd, insn->ra, insn->imm, regs[insn->rd]);
+        REG_NEXT();
+    REG_CASE(rop_print, ROP_PRINT)
+        printf(COLOR_GREY "%d" COLOR_RESET "\n", regs[insn->ra]);
+        REG_TRACE("PRINT r%d\n", insn->ra);
+        REG_NEXT();
+    REG_CASE(rop_halt, ROP_HALT)
+        REG_TRACE("HALT\n");
+        goto done;
+    REG_DEFAULT(rop_invalid)
+        fprintf(stderr, "Error: Invalid register opcode %d at %d\n", insn->op, (int)(insn - vm->rcode));
+        goto done;
+
+#if !REG_LOOP_THREADED
+        }
+    }
+#endif
+
+done:
+    vm->ip = (int)(insn - vm->rcode);
+}
+
+#undef REG_TRACE
+#undef REG_CASE
+#undef REG_DEFAULT
+#undef REG_NEXT
+#undef REG_BINARY
+#undef REG_IMMEDIATE
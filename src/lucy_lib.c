@@ -33,6 +33,8 @@ int extension_count = 0;
 /* Weak symbols for annotation tracking, overridden by generated annotations.c */
 __attribute__((weak)) int __ANNOTATION_COUNT = 0;
 __attribute__((weak)) struct Annotation __ANNOTATIONS[MAX_ANNOTATIONS] = {};
+__attribute__((weak)) int __TAG_COUNT = 0;
+__attribute__((weak)) struct TagIndex __TAGS[1] = {};
 
 /* Temporary structure to hold multiple annotations before a function */
 typedef struct {
@@ -141,6 +143,7 @@ int lucy_process_file(const char *input_path, const char *output_path) {
                 annotations[annotation_count].target = NULL;
                 annotations[annotation_count].target_name = strdup(func_name);
                 annotations[annotation_count].type = strdup("function");
+                annotations[annotation_count].file = strdup(input_path);
                 split_args(pending_annotations[i].arg, annotations[annotation_count].args,
                           &annotations[annotation_count].arg_count);
 
@@ -234,6 +237,8 @@ int lucy_generate_annotations_header(const char *base_annotations_path, const ch
     fprintf(header_out, "\n// Annotation Tracking Declarations\n");
     fprintf(header_out, "extern struct Annotation __ANNOTATIONS[];\n");
     fprintf(header_out, "extern int __ANNOTATION_COUNT;\n");
+    fprintf(header_out, "extern struct TagIndex __TAGS[];\n");
+    fprintf(header_out, "extern int __TAG_COUNT;\n");
     fprintf(header_out, "extern struct Annotation *find_annotated_blocks(const char *name);\n");
     fprintf(header_out, "#endif // ANNOTATIONS_H\n");
 
@@ -241,6 +246,56 @@ int lucy_generate_annotations_header(const char *base_annotations_path, const ch
     return 0;
 }
 
+/* Returns: 1 if target_name carries @Tag(tag), 0 otherwise */
+static int has_tag(const char *target_name, const char *tag) {
+    for (int i = 0; i < annotation_count; i++) {
+        if (strcmp(annotations[i].name, "Tag") != 0 || strcmp(annotations[i].target_name, target_name) != 0) continue;
+        for (int j = 0; j < annotations[i].arg_count; j++) {
+            if (strcmp(annotations[i].args[j], tag) == 0) return 1;
+        }
+    }
+    return 0;
+}
+
+/* Emits __TAGS: for each distinct @Tag value, the indices of all other
+ * annotations on the functions carrying it */
+static void generate_tag_index(FILE *out) {
+    const char *tags[MAX_ANNOTATIONS];
+    int tag_count = 0;
+    for (int i = 0; i < annotation_count; i++) {
+        if (strcmp(annotations[i].name, "Tag") != 0) continue;
+        for (int j = 0; j < annotations[i].arg_count; j++) {
+            int seen = 0;
+            for (int k = 0; k < tag_count; k++) {
+                if (strcmp(tags[k], annotations[i].args[j]) == 0) seen = 1;
+            }
+            if (!seen && tag_count < MAX_ANNOTATIONS) tags[tag_count++] = annotations[i].args[j];
+        }
+    }
+
+    fprintf(out, "\n// Generated Tag Index\n");
+    for (int t = 0; t < tag_count; t++) {
+        fprintf(out, "static const int __TAG_%d[] = {", t);
+        int count = 0;
+        for (int i = 0; i < annotation_count; i++) {
+            if (strcmp(annotations[i].name, "Tag") == 0 || !has_tag(annotations[i].target_name, tags[t])) continue;
+            fprintf(out, "%s%d", count ? ", " : "", i);
+            count++;
+        }
+        fprintf(out, "};\n");
+    }
+    fprintf(out, "struct TagIndex __TAGS[%d] = {\n", tag_count ? tag_count : 1);
+    for (int t = 0; t < tag_count; t++) {
+        int count = 0;
+        for (int i = 0; i < annotation_count; i++) {
+            if (strcmp(annotations[i].name, "Tag") != 0 && has_tag(annotations[i].target_name, tags[t])) count++;
+        }
+        fprintf(out, "    {\"%s\", __TAG_%d, %d}%s\n", tags[t], t, count, t < tag_count - 1 ? "," : "");
+    }
+    fprintf(out, "};\n");
+    fprintf(out, "int __TAG_COUNT = %d;\n", tag_count);
+}
+
 /* Generates annotations.c with tracking data */
 int lucy_generate_annotations_source(const char *output_path) {
     FILE *out = fopen(output_path, "w");
@@ -266,9 +321,10 @@ int lucy_generate_annotations_source(const char *output_path) {
                 }
                 if (j < MAX_ARGS - 1) fprintf(out, ", ");
             }
-            fprintf(out, "}, %d, \"%s\", \"%s\"}%s\n", annotations[i].arg_count,
+            fprintf(out, "}, %d, \"%s\", \"%s\", \"%s\"}%s\n", annotations[i].arg_count,
                     annotations[i].condition,
                     annotations[i].target_name,
+                    annotations[i].file,
                     i < annotation_count - 1 ? "," : "");
             fprintf(out, "#else\n");
             fprintf(out, "    {\"%s\", NULL, \"%s\", 1, {", annotations[i].name,
@@ -281,9 +337,10 @@ int lucy_generate_annotations_source(const char *output_path) {
                 }
                 if (j < MAX_ARGS - 1) fprintf(out, ", ");
             }
-            fprintf(out, "}, %d, \"%s\", \"%s\"}%s\n", annotations[i].arg_count,
+            fprintf(out, "}, %d, \"%s\", \"%s\", \"%s\"}%s\n", annotations[i].arg_count,
                     annotations[i].condition,
                     annotations[i].target_name,
+                    annotations[i].file,
                     i < annotation_count - 1 ? "," : "");
             fprintf(out, "#endif\n");
         } else {
@@ -297,13 +354,15 @@ int lucy_generate_annotations_source(const char *output_path) {
                 }
                 if (j < MAX_ARGS - 1) fprintf(out, ", ");
             }
-            fprintf(out, "}, %d, NULL, \"%s\"}%s\n", annotations[i].arg_count,
+            fprintf(out, "}, %d, NULL, \"%s\", \"%s\"}%s\n", annotations[i].arg_count,
                     annotations[i].target_name,
+                    annotations[i].file,
                     i < annotation_count - 1 ? "," : "");
         }
     }
     fprintf(out, "};\n");
     fprintf(out, "int __ANNOTATION_COUNT = %d;\n", annotation_count);
+    generate_tag_index(out);
     fclose(out);
     return 0;
 }
@@ -325,6 +384,7 @@ void lucy_cleanup(void) {
         free((void *)annotations[i].type);
         free((void *)annotations[i].condition);
         free((void *)annotations[i].target_name);
+        free((void *)annotations[i].file);
         for (int j = 0; j < annotations[i].arg_count; j++) {
             free((void *)annotations[i].args[j]);
         }
@@ -0,0 +1,160 @@
+/* lucy_test_alloc.c - Allocation accounting for tests
+ *
+ * liblucy-test.so defines malloc, calloc, realloc, free and the aligned
+ * allocators (posix_memalign, aligned_alloc, memalign, valloc, pvalloc), so
+ * every block free can see was also counted when it was made. Executables linked
+ * against it resolve those symbols here before reaching libc, so every
+ * allocation in a test process (including ones made inside libc) passes
+ * through these wrappers, which forward to glibc's __libc_* implementations.
+ *
+ * Counting is per thread and only happens between lucy_alloc_start and
+ * lucy_alloc_stop, so the cost outside a test body is one thread-local load.
+ * The runner pauses it around its own work inside that window, such as
+ * recording an assertion failure.
+ * Live and peak bytes use malloc_usable_size, so they include allocator
+ * rounding; a block freed on another thread is not subtracted.
+ *
+ * Dependencies:
+ * - lucy_test_runner.h: AllocStats and the functions defined here.
+ * - glibc: __libc_malloc, __libc_calloc, __libc_realloc, __libc_free, __libc_memalign,
+ *   __libc_valloc, __libc_pvalloc, malloc_usable_size.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "../include/lucy_test_runner.h"
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+
+/* Stats of the test running on this thread, or NULL when not counting.
+ * initial-exec keeps the access free of calls that could allocate.
+ */
+static __thread AllocStats *thread_stats __attribute__((tls_model("initial-exec"))) = NULL;
+
+/* Nonzero while this thread is inside one of glibc's allocator functions, whose
+ * locks a watchdog must not jump past; see lucy_alloc_busy.
+ */
+static __thread volatile sig_atomic_t allocator_depth __attribute__((tls_model("initial-exec"))) = 0;
+
+static void count_alloc(AllocStats *stats, void *ptr, size_t requested) {
+    if (!ptr) return;
+    stats->allocs++;
+    stats->bytes += requested;
+    stats->live_bytes += malloc_usable_size(ptr);
+    if (stats->live_bytes > stats->peak_bytes) stats->peak_bytes = stats->live_bytes;
+}
+
+static void count_free(AllocStats *stats, void *ptr) {
+    if (!ptr) return;
+    stats->frees++;
+    stats->live_bytes -= malloc_usable_size(ptr);
+}
+
+void *malloc(size_t size) {
+    allocator_depth++;
+    void *ptr = __libc_malloc(size);
+    allocator_depth--;
+    if (thread_stats) count_alloc(thread_stats, ptr, size);
+    return ptr;
+}
+
+void *calloc(size_t count, size_t size) {
+    allocator_depth++;
+    void *ptr = __libc_calloc(count, size);
+    allocator_depth--;
+    if (thread_stats) count_alloc(thread_stats, ptr, count * size);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+    AllocStats *stats = thread_stats;
+    size_t old_size = stats && ptr ? malloc_usable_size(ptr) : 0;
+    allocator_depth++;
+    void *result = __libc_realloc(ptr, size);
+    allocator_depth--;
+    if (!stats) return result;
+
+    /* A resize counts as freeing the old block and allocating a new one */
+    if (!result && size > 0) return NULL;  // Old block untouched
+    if (ptr) {
+        stats->frees++;
+        stats->live_bytes -= old_size;
+    }
+    count_alloc(stats, result, size);
+    return result;
+}
+
+void free(void *ptr) {
+    if (thread_stats) count_free(thread_stats, ptr);
+    allocator_depth++;
+    __libc_free(ptr);
+    allocator_depth--;
+}
+
+void *memalign(size_t alignment, size_t size) {
+    allocator_depth++;
+    void *ptr = __libc_memalign(alignment, size);
+    allocator_depth--;
+    if (thread_stats) count_alloc(thread_stats, ptr, size);
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **result, size_t alignment, size_t size) {
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0) return EINVAL;
+    void *ptr = memalign(alignment, size);
+    if (!ptr && size > 0) return ENOMEM;
+    *result = ptr;
+    return 0;
+}
+
+void *valloc(size_t size) {
+    allocator_depth++;
+    void *ptr = __libc_valloc(size);
+    allocator_depth--;
+    if (thread_stats) count_alloc(thread_stats, ptr, size);
+    return ptr;
+}
+
+void *pvalloc(size_t size) {
+    allocator_depth++;
+    void *ptr = __libc_pvalloc(size);
+    allocator_depth--;
+    if (thread_stats) count_alloc(thread_stats, ptr, size);
+    return ptr;
+}
+
+void lucy_alloc_start(AllocStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    thread_stats = stats;
+}
+
+void lucy_alloc_stop(void) {
+    thread_stats = NULL;
+}
+
+AllocStats *lucy_alloc_pause(void) {
+    AllocStats *stats = thread_stats;
+    thread_stats = NULL;
+    return stats;
+}
+
+void lucy_alloc_resume(AllocStats *stats) {
+    thread_stats = stats;
+}
+
+int lucy_alloc_busy(void) {
+    return allocator_depth > 0;
+}
@@ -0,0 +1,112 @@
+/* lucy_test_bench.c - Auto-calibrated microbenchmark harness for @Benchmark
+ *
+ * A @Benchmark function performs one operation per call. The harness doubles
+ * the iteration count until a batch takes long enough to time reliably (this
+ * also warms caches and branch predictors), runs one more warmup batch, then
+ * times a fixed number of batches. Each batch gives one ns/op sample, and the
+ * samples are summarized as median, median absolute deviation and p99 so a
+ * few noisy batches don't move the result.
+ *
+ * Dependencies:
+ * - lucy_test_runner.h: Benchmark, BenchOptions and the functions defined here.
+ * - Standard C libraries: stdlib.h, time.h.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include "../include/lucy_test_runner.h"
+
+/* Upper bound on iterations per batch, for bodies the compiler optimized away */
+#define MAX_BENCH_ITERATIONS (1L << 30)
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Times one batch of `iterations` calls
+ * Returns: elapsed nanoseconds
+ */
+static double run_batch(TestFunc func, long iterations) {
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        func();
+    }
+    return now_ns() - start;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Median of an already sorted array */
+static double sorted_median(const double *values, int count) {
+    if (count % 2) return values[count / 2];
+    return (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
+
+void lucy_bench_stats(double *samples, int count, double *median, double *mad, double *p99) {
+    if (count <= 0) {
+        *median = *mad = *p99 = 0;
+        return;
+    }
+
+    qsort(samples, count, sizeof(double), compare_doubles);
+    *median = sorted_median(samples, count);
+
+    /* Nearest-rank percentile: the smallest sample >= 99% of all samples */
+    int rank = (int)((99 * count + 99) / 100);
+    if (rank < 1) rank = 1;
+    *p99 = samples[rank - 1];
+
+    double *deviations = malloc(count * sizeof(double));
+    if (!deviations) {
+        *mad = 0;
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        double deviation = samples[i] - *median;
+        deviations[i] = deviation < 0 ? -deviation : deviation;
+    }
+    qsort(deviations, count, sizeof(double), compare_doubles);
+    *mad = sorted_median(deviations, count);
+    free(deviations);
+}
+
+void lucy_bench_run(Benchmark *bench, const BenchOptions *opts, PerfCounters *perf) {
+    double target_ns = opts->batch_ms * 1e6;
+
+    /* Calibrate: grow the batch until it is long enough to time */
+    long iterations = 1;
+    while (iterations < MAX_BENCH_ITERATIONS && run_batch(bench->func, iterations) < target_ns) {
+        iterations *= 2;
+    }
+    run_batch(bench->func, iterations);  // Warmup at the final size
+
+    double *samples = malloc(opts->samples * sizeof(double));
+    if (!samples) {
+        bench->samples = 0;
+        return;
+    }
+    if (perf) lucy_perf_start(perf);
+    for (int i = 0; i < opts->samples; i++) {
+        samples[i] = run_batch(bench->func, iterations) / iterations;
+    }
+    if (perf) {
+        lucy_perf_stop(perf, &bench->perf);
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            if (bench->perf.values[e] >= 0) bench->perf.values[e] /= (double)iterations * opts->samples;
+        }
+    }
+
+    bench->iterations = iterations;
+    bench->samples = opts->samples;
+    lucy_bench_stats(samples, opts->samples, &bench->median_ns, &bench->mad_ns, &bench->p99_ns);
+    free(samples);
+
+    bench->regressed = bench->baseline_ns > 0 &&
+                       bench->median_ns > bench->baseline_ns * (1.0 + opts->threshold_pct / 100.0);
+}
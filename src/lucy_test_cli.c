@@ -0,0 +1,386 @@
+/* lucy_test_cli.c - The lucy-test command: merging, local sharding and watching test runs
+ *
+ * lucy-test merge OUT.jsonl IN.jsonl...
+ *   Combines the --report JSONL files of several shards into one report with
+ *   a single summary line, and prints the totals.
+ *
+ * lucy-test shard N RUNNER [ARGS...]
+ *   Starts N copies of RUNNER side by side, the i-th with --shard=i/N and its
+ *   own report and log, waits for all of them and merges their reports. The
+ *   shards only share the command line, exactly as they would on N CI nodes.
+ *
+ * lucy-test watch [--dir=DIR]... [--make=CMD] RUNNER [ARGS...]
+ *   Watches the source trees (default: src, tests and include) with inotify.
+ *   After each save it runs the build command (default: make test_runner,
+ *   which builds without running the suite; the Makefile's per-file rules
+ *   reprocess and recompile only what the change touched), then reruns
+ *   RUNNER with --changed set to the saved files. A changed header reruns
+ *   everything.
+ *
+ * Dependencies:
+ * - lucy_test_runner.h: lucy_report_merge, ReportTotals.
+ * - POSIX: unistd.h, fcntl.h, dirent.h, poll.h, sys/wait.h.
+ * - Linux: sys/inotify.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "../include/lucy_test_runner.h"
+#include "../include/lucy_api.h"    // For MAX_BUFFER_SIZE
+
+/* File names used by the shard command, relative to the working directory */
+#define SHARD_REPORT_FORMAT "lucy-shard-%d.jsonl"
+#define SHARD_LOG_FORMAT "lucy-shard-%d.log"
+#define SHARD_MERGED_REPORT "lucy-shards.jsonl"
+
+/* Upper bound on shards started by one shard command */
+#define MAX_SHARDS 64
+
+/* Limits of the watch command */
+#define MAX_WATCHED_DIRS 256
+#define MAX_CHANGED_FILES 64
+#define WATCH_SETTLE_MS 50  // Quiet time that ends a burst of saves
+
+static void print_usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s merge OUT.jsonl IN.jsonl...\n"
+                    "       %s shard N RUNNER [ARGS...]\n"
+                    "       %s watch [--dir=DIR]... [--make=CMD] RUNNER [ARGS...]\n", argv0, argv0, argv0);
+}
+
+static void print_totals(const ReportTotals *totals) {
+    printf("Merged %d reports: %d passed, %d failed (%d disabled), longest shard %.3f ms\n",
+           totals->reports, totals->passed, totals->failed, totals->disabled, totals->wall_ms);
+    if (totals->incomplete > 0) {
+        printf("✘ %d reports have no summary; their runners did not finish\n", totals->incomplete);
+    }
+}
+
+static int merge_command(int argc, char *argv[]) {
+    if (argc < 4) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    ReportTotals totals;
+    int status = lucy_report_merge(argv[2], (const char *const *)argv + 3, argc - 3, &totals);
+    print_totals(&totals);
+    return status || totals.failed > 0 || totals.incomplete > 0 ? 1 : 0;
+}
+
+/* Starts shard `index` (1-based) of `count` with output going to its log file
+ * Returns: child pid, or -1 on failure
+ */
+static pid_t start_shard(int index, int count, int runner_argc, char *runner_argv[]) {
+    char shard_arg[MAX_BUFFER_SIZE];
+    char report_arg[MAX_BUFFER_SIZE];
+    char log_path[MAX_BUFFER_SIZE];
+    snprintf(shard_arg, sizeof(shard_arg), "--shard=%d/%d", index, count);
+    snprintf(report_arg, sizeof(report_arg), "--report=" SHARD_REPORT_FORMAT, index);
+    snprintf(log_path, sizeof(log_path), SHARD_LOG_FORMAT, index);
+
+    char **args = malloc((runner_argc + 3) * sizeof(char *));
+    if (!args) return -1;
+    for (int i = 0; i < runner_argc; i++) args[i] = runner_argv[i];
+    args[runner_argc] = shard_arg;
+    args[runner_argc + 1] = report_arg;
+    args[runner_argc + 2] = NULL;
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        int log = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log >= 0) {
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+            close(log);
+        }
+        execvp(args[0], args);
+        perror(args[0]);
+        _exit(127);
+    }
+    free(args);
+    return pid;
+}
+
+static int shard_command(int argc, char *argv[]) {
+    int count = argc >= 4 ? atoi(argv[2]) : 0;
+    if (count < 1 || count > MAX_SHARDS) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    pid_t pids[MAX_SHARDS];
+    for (int i = 0; i < count; i++) {
+        pids[i] = start_shard(i + 1, count, argc - 3, argv + 3);
+        if (pids[i] < 0) perror("fork");
+    }
+
+    int status = 0;
+    for (int i = 0; i < count; i++) {
+        int exit_status = 1;
+        if (pids[i] > 0 && waitpid(pids[i], &exit_status, 0) > 0 &&
+            WIFEXITED(exit_status) && WEXITSTATUS(exit_status) == 0) {
+            printf("Shard %d/%d ✔ (log: " SHARD_LOG_FORMAT ")\n", i + 1, count, i + 1);
+        } else {
+            printf("Shard %d/%d ✘ (log: " SHARD_LOG_FORMAT ")\n", i + 1, count, i + 1);
+            status = 1;
+        }
+    }
+
+    char paths[MAX_SHARDS][MAX_BUFFER_SIZE];
+    const char *inputs[MAX_SHARDS];
+    for (int i = 0; i < count; i++) {
+        snprintf(paths[i], sizeof(paths[i]), SHARD_REPORT_FORMAT, i + 1);
+        inputs[i] = paths[i];
+    }
+    ReportTotals totals;
+    if (lucy_report_merge(SHARD_MERGED_REPORT, inputs, count, &totals) != 0) status = 1;
+    print_totals(&totals);
+    printf("Merged report: " SHARD_MERGED_REPORT "\n");
+    return status || totals.failed > 0 || totals.incomplete > 0 ? 1 : 0;
+}
+
+/* Directories watched by the watch command, indexed by position; wds[i] belongs to paths[i] */
+typedef struct {
+    int fd;
+    int wds[MAX_WATCHED_DIRS];
+    char paths[MAX_WATCHED_DIRS][MAX_BUFFER_SIZE];
+    int count;
+} WatchSet;
+
+/* Files saved since the last run */
+typedef struct {
+    char paths[MAX_CHANGED_FILES][MAX_BUFFER_SIZE];
+    int count;
+    int overflow;  // More files than fit, or a header: rerun everything
+} ChangedFiles;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Watches dir and every subdirectory except hidden ones and build output */
+static void watch_tree(WatchSet *watch, const char *dir) {
+    if (watch->count == MAX_WATCHED_DIRS) {
+        fprintf(stderr, "watch: more than %d directories; not watching %s\n", MAX_WATCHED_DIRS, dir);
+        return;
+    }
+    int wd = inotify_add_watch(watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+    if (wd < 0) {
+        perror(dir);
+        return;
+    }
+    watch->wds[watch->count] = wd;
+    snprintf(watch->paths[watch->count], MAX_BUFFER_SIZE, "%s", dir);
+    watch->count++;
+
+    DIR *entries = opendir(dir);
+    if (!entries) return;
+    struct dirent *entry;
+    while ((entry = readdir(entries))) {
+        if (entry->d_name[0] == '.' || strcmp(entry->d_name, "build") == 0) continue;
+        char path[MAX_BUFFER_SIZE];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        struct stat info;
+        if (stat(path, &info) == 0 && S_ISDIR(info.st_mode)) watch_tree(watch, path);
+    }
+    closedir(entries);
+}
+
+static const char *watched_dir(const WatchSet *watch, int wd) {
+    for (int i = 0; i < watch->count; i++) {
+        if (watch->wds[i] == wd) return watch->paths[i];
+    }
+    return NULL;
+}
+
+static void note_change(ChangedFiles *changed, const char *path) {
+    size_t len = strlen(path);
+    int header = len > 2 && strcmp(path + len - 2, ".h") == 0;
+    int source = len > 2 && strcmp(path + len - 2, ".c") == 0;
+    if (!header && !source) return;
+    if (header) changed->overflow = 1;
+    for (int i = 0; i < changed->count; i++) {
+        if (strcmp(changed->paths[i], path) == 0) return;
+    }
+    if (changed->count == MAX_CHANGED_FILES) {
+        changed->overflow = 1;
+        return;
+    }
+    snprintf(changed->paths[changed->count++], MAX_BUFFER_SIZE, "%s", path);
+}
+
+/* Reads one batch of inotify events into changed, watching new subdirectories as they appear
+ * Returns: 0 on success, 1 if the inotify descriptor failed
+ */
+static int read_events(WatchSet *watch, ChangedFiles *changed) {
+    char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n = read(watch->fd, buffer, sizeof(buffer));
+    if (n <= 0) return 1;
+    for (char *p = buffer; p < buffer + n;) {
+        const struct inotify_event *event = (const struct inotify_event *)p;
+        p += sizeof(struct inotify_event) + event->len;
+        const char *dir = watched_dir(watch, event->wd);
+        if (!dir || event->len == 0 || event->name[0] == '.') continue;
+        char path[MAX_BUFFER_SIZE];
+        snprintf(path, sizeof(path), "%s/%s", dir, event->name);
+        if (event->mask & IN_ISDIR) {
+            if (event->mask & IN_CREATE) watch_tree(watch, path);
+        } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+            note_change(changed, path);
+        }
+    }
+    return 0;
+}
+
+/* Runs argv to completion with inherited stdout/stderr
+ * Returns: 1 unless it exited with status 0
+ */
+static int run_command(char *const args[]) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        execvp(args[0], args);
+        perror(args[0]);
+        _exit(127);
+    }
+    int status = 1;
+    if (waitpid(pid, &status, 0) < 0) return 1;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+}
+
+/* Rebuilds, then runs the runner on the changed files (all tests when changed is NULL) */
+static void watch_cycle(const char *make, int runner_argc, char *runner_argv[], const ChangedFiles *changed) {
+    double start = now_ms();
+    char *build[] = { "/bin/sh", "-c", (char *)make, NULL };
+    if (run_command(build) != 0) {
+        printf("✘ Build failed (%.0f ms); waiting for the next change\n", now_ms() - start);
+        return;
+    }
+    double built = now_ms();
+
+    char **args = malloc((runner_argc + 2) * sizeof(char *));
+    if (!args) return;
+    for (int i = 0; i < runner_argc; i++) args[i] = runner_argv[i];
+    int arg_count = runner_argc;
+
+    /* Sized for every path, so the list is never cut short; without it the
+     * runner falls back to running everything */
+    char *changed_arg = NULL;
+    if (changed && !changed->overflow) {
+        size_t length = strlen("--changed=") + 1;
+        for (int i = 0; i < changed->count; i++) length += strlen(changed->paths[i]) + 1;
+        changed_arg = malloc(length);
+    }
+    if (changed_arg) {
+        strcpy(changed_arg, "--changed=");
+        for (int i = 0; i < changed->count; i++) {
+            if (i > 0) strcat(changed_arg, ",");
+            strcat(changed_arg, changed->paths[i]);
+        }
+        args[arg_count++] = changed_arg;
+    }
+    args[arg_count] = NULL;
+
+    int status = run_command(args);
+    free(changed_arg);
+    free(args);
+    printf("%s Built in %.0f ms, tested in %.0f ms; watching for changes\n", status ? "✘" : "✔",
+           built - start, now_ms() - built);
+}
+
+static int watch_command(int argc, char *argv[]) {
+    WatchSet *watch = calloc(1, sizeof(WatchSet));
+    ChangedFiles *changed = calloc(1, sizeof(ChangedFiles));
+    if (!watch || !changed) {
+        fprintf(stderr, "Memory allocation failed in watch_command\n");
+        free(watch);
+        free(changed);
+        return 1;
+    }
+    const char *make = "make test_runner";  // Build only: `make` would also run the whole suite
+    const char *dirs[MAX_WATCHED_DIRS];
+    int dir_count = 0;
+    int i = 2;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strncmp(argv[i], "--dir=", 6) == 0 && dir_count < MAX_WATCHED_DIRS) {
+            dirs[dir_count++] = argv[i] + 6;
+        } else if (strncmp(argv[i], "--make=", 7) == 0) {
+            make = argv[i] + 7;
+        } else {
+            break;
+        }
+    }
+    if (i >= argc) {
+        print_usage(argv[0]);
+        free(watch);
+        free(changed);
+        return 1;
+    }
+    if (dir_count == 0) {
+        /* Not "." by default: test suites often write scratch .c files there */
+        static const char *defaults[] = { "src", "tests", "include" };
+        struct stat info;
+        for (int d = 0; d < 3; d++) {
+            if (stat(defaults[d], &info) == 0 && S_ISDIR(info.st_mode)) dirs[dir_count++] = defaults[d];
+        }
+        if (dir_count == 0) dirs[dir_count++] = ".";
+    }
+
+    watch->fd = inotify_init1(IN_CLOEXEC);
+    if (watch->fd < 0) {
+        perror("inotify_init1");
+        free(watch);
+        free(changed);
+        return 1;
+    }
+    for (int d = 0; d < dir_count; d++) watch_tree(watch, dirs[d]);
+    printf("Watching %d directories; press Ctrl-C to stop\n", watch->count);
+
+    watch_cycle(make, argc - i, argv + i, NULL);
+    for (;;) {
+        memset(changed, 0, sizeof(*changed));
+        if (read_events(watch, changed) != 0) break;
+        /* Editors and builds save in bursts; wait until the tree is quiet */
+        struct pollfd fd = { watch->fd, POLLIN, 0 };
+        while (poll(&fd, 1, WATCH_SETTLE_MS) > 0) {
+            if (read_events(watch, changed) != 0) break;
+        }
+        if (changed->count == 0) continue;
+        printf("\nChanged: %s%s\n", changed->paths[0], changed->count > 1 ? " ..." : "");
+        watch_cycle(make, argc - i, argv + i, changed);
+    }
+
+    close(watch->fd);
+    free(watch);
+    free(changed);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "merge") == 0) {
+        return merge_command(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "shard") == 0) {
+        return shard_command(argc, argv);
+    }
+    if (argc >= 2 && (strcmp(argv[1], "watch") == 0 || strcmp(argv[1], "--watch") == 0)) {
+        return watch_command(argc, argv);
+    }
+    print_usage(argv[0]);
+    return 1;
+}
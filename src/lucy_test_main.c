@@ -1,82 +1,1362 @@
+#define _GNU_SOURCE  // For RUSAGE_THREAD
 #include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <regex.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
 #include "../include/lucy_api.h"    // For lucy_init, lucy_cleanup, etc.
 #include "../include/lucy_test.h"   // For assertions and test annotations
+#include "../include/lucy_test_runner.h"
 #include "annotations.h"            // Generated header with embedded lucy.h
 
 extern int __ANNOTATION_COUNT;
 extern struct Annotation __ANNOTATIONS[];
 extern void sync_annotations(void);
 
-int __test_failed = 0;
+__thread int __test_failed = 0;
+
+/* Command-line options for a single runner invocation */
+typedef struct {
+    int debug;
+    int fork;                 // Run each test in a child forked from the warmed runner
+    int jobs;                 // Forked children allowed to run at once
+    int threads;              // In-process worker threads; 0 disables the thread pool
+    const char *timings_path; // Timings cache, or NULL when disabled
+    int slowest;              // Rows in the slowest-tests table; 0 hides it
+    const char *report_paths[MAX_REPORTS];
+    int report_count;
+    int bench;                // Run @Benchmark functions after the tests
+    int bench_save;           // Store this run's medians as the new baselines
+    const char *bench_baseline_path;
+    BenchOptions bench_opts;
+    int perf;                 // Read hardware counters around every test and benchmark
+    const char *profile_dir;  // Folded stacks per test go here, or NULL when not profiling
+    long profile_interval_us;
+    long timeout_ms;          // Limit for tests without @Timeout; 0 for none
+    int shard_index;          // 0-based shard to run (--shard=i/n takes it 1-based)
+    int shard_count;          // 1 runs everything
+    ShardStrategy shard_by;
+    const char *filter;       // Glob matched against description and target_name, or NULL
+    const char *filter_regex; // Extended regex matched the same way, or NULL
+    const char *tags;         // Comma-separated @Tag values to select, or NULL
+    const char *changed;      // Comma-separated changed source files, "-" for stdin, or NULL
+    int failed_first;         // Run the tests that failed last time before the rest
+    int fail_fast;            // Start no further tests after the first failure
+    const char *module_paths[MAX_MODULES]; // Test modules to dlopen next to the linked-in tests
+    int module_count;
+} RunnerOptions;
+
+/* Growable byte buffer holding one test's report until it is flushed */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int echo;  // Also print messages immediately (sequential mode)
+} ReportBuffer;
+
+/* Where __lucy_test_fail writes on this thread; NULL prints straight to stdout */
+static __thread ReportBuffer *report_buffer = NULL;
+
+/* Hardware counters of this thread when --perf is on, NULL otherwise */
+static __thread PerfCounters *thread_perf = NULL;
+
+/* SIGPROF sampler of this thread when --profile is on, NULL otherwise */
+static __thread Profiler *thread_profiler = NULL;
+
+/* Timeout enforcement of this thread when it runs tests in-process, NULL otherwise */
+static __thread Watchdog *thread_watchdog = NULL;
+
+/* Serializes whole-test reports from pool threads on stdout and report files */
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* --report outputs, streamed as tests complete */
+static Report reports[MAX_REPORTS];
+static int report_count = 0;
+
+/* Setup and teardown functions, resolved once before any test runs; sized from
+ * the merged annotation table, which --module can grow past MAX_ANNOTATIONS */
+static TestFunc *setup_funcs;
+static int setup_count = 0;
+static TestFunc *teardown_funcs;
+static int teardown_count = 0;
+
+/* A @BeforeAll/@AfterAll function, run once in the runner process */
+typedef struct {
+    TestFunc func;
+    const char *file;  // Source file whose tests it wraps, or NULL around the whole run
+} Fixture;
+
+static Fixture *before_all_fixtures;
+static int before_all_count = 0;
+static Fixture *after_all_fixtures;
+static int after_all_count = 0;
+
+/* --fail-fast: set once a test fails; executors check it before starting the next test */
+static int fail_fast = 0;
+static int stop_requested = 0;
+
+static void report_append(ReportBuffer *buffer, const char *data, size_t len) {
+    if (buffer->len + len > buffer->cap) {
+        size_t cap = buffer->cap ? buffer->cap : 256;
+        while (cap < buffer->len + len) cap *= 2;
+        char *grown = realloc(buffer->data, cap);
+        if (!grown) return;  // Drop output rather than the result
+        buffer->data = grown;
+        buffer->cap = cap;
+    }
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+}
+
+/* Records a failure in the current test's output. Its allocations are the
+ * runner's, so they don't count against the test's @MaxAllocs/@MaxBytes. */
+static void record_failure(const char *format, va_list args) {
+    if (!report_buffer) {
+        vprintf(format, args);
+        return;
+    }
+
+    char message[MAX_LINE_LENGTH];
+    va_list retry;
+    va_copy(retry, args);
+    int len = vsnprintf(message, sizeof(message), format, args);
+    if (len < 0) {
+        va_end(retry);
+        return;
+    }
+
+    char *text = message;
+    if (len >= (int)sizeof(message)) {
+        text = malloc(len + 1);
+        if (text) {
+            vsnprintf(text, len + 1, format, retry);
+        } else {
+            text = message;
+            len = sizeof(message) - 1;
+        }
+    }
+    va_end(retry);
+
+    if (report_buffer->echo) fwrite(text, 1, len, stdout);
+    report_append(report_buffer, text, len);
+    if (text != message) free(text);
+}
+
+void __lucy_test_fail(const char *format, ...) {
+    __test_failed = 1;
+    AllocStats *stats = lucy_alloc_pause();
+    va_list args;
+    va_start(args, format);
+    record_failure(format, args);
+    va_end(args);
+    lucy_alloc_resume(stats);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* CPU time consumed so far by the calling thread */
+static double thread_cpu_ms(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0 +
+           usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+}
+
+/* Keeps a test's captured output and streams the finished test to every report.
+ * Pool threads call this with report_lock held.
+ */
+static void complete_test(TestCase *test, const ReportBuffer *output) {
+    test->ran = 1;
+    if (test->failed && fail_fast) __atomic_store_n(&stop_requested, 1, __ATOMIC_RELAXED);
+    if (output && output->len > 0) {
+        test->output = strndup(output->data, output->len);
+    }
+    for (int r = 0; r < report_count; r++) {
+        lucy_report_test(&reports[r], test);
+    }
+}
+
+/* Fails a test whose body never ran, e.g. because no worker could be started:
+ * prints its result line with reason, then cause (the failure messages behind
+ * it, or NULL), and streams it to every report like any other failure */
+static void fail_without_running(TestCase *test, const char *reason, const ReportBuffer *cause) {
+    ReportBuffer output = {0};
+    char message[MAX_LINE_LENGTH];
+    int len = snprintf(message, sizeof(message), "FAIL: %s %s\n", test->target_name, reason);
+    if (len >= (int)sizeof(message)) len = sizeof(message) - 1;
+    if (len > 0) report_append(&output, message, len);
+    if (cause && cause->len > 0) report_append(&output, cause->data, cause->len);
+
+    test->failed = 1;
+    printf("Running: %s ", test->description);
+    fwrite(output.data, 1, output.len, stdout);
+    printf("✘\n");
+    fflush(stdout);
+    complete_test(test, &output);
+    free(output.data);
+}
+
+static void print_usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [--debug|-d] [--fork] [--jobs=N|-j N] [--threads=N|-t N] [--timings=PATH] [--no-timings]\n"
+                    "       [--slowest=N] [--report=FILE.xml|FILE.jsonl]...\n"
+                    "       [--bench] [--bench-baseline=PATH] [--bench-save] [--bench-threshold=PCT] [--perf]\n"
+                    "       [--profile[=DIR]] [--profile-interval=US] [--timeout=MS]\n"
+                    "       [--shard=I/N] [--shard-by=hash|duration]\n"
+                    "       [--filter=GLOB] [--filter-regex=REGEX] [--tag=TAG[,TAG...]]\n"
+                    "       [--changed=FILE[,FILE...]|--changed=-] [--failed-first] [--fail-fast]\n"
+                    "       [--module=MODULE.so]...\n", argv0);
+}
+
+/* Parses a worker count; 0 (or garbage) means one worker per online CPU */
+static int parse_worker_count(const char *value) {
+    int count = atoi(value);
+    if (count <= 0) count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+}
+
+static int parse_options(int argc, char *argv[], RunnerOptions *opts) {
+    opts->debug = 0;
+    opts->fork = 0;
+    opts->jobs = 1;
+    opts->threads = 0;
+    opts->timings_path = LUCY_TIMINGS_PATH;
+    opts->slowest = 5;
+    opts->report_count = 0;
+    opts->bench = 0;
+    opts->bench_save = 0;
+    opts->bench_baseline_path = LUCY_BENCH_BASELINE_PATH;
+    opts->bench_opts.batch_ms = 5.0;
+    opts->bench_opts.samples = 31;
+    opts->bench_opts.threshold_pct = 10.0;
+    opts->perf = 0;
+    opts->profile_dir = NULL;
+    opts->profile_interval_us = LUCY_PROFILE_INTERVAL_US;
+    opts->timeout_ms = 0;
+    opts->shard_index = 0;
+    opts->shard_count = 1;
+    opts->shard_by = SHARD_BY_HASH;
+    opts->filter = NULL;
+    opts->filter_regex = NULL;
+    opts->tags = NULL;
+    opts->changed = NULL;
+    opts->failed_first = 0;
+    opts->fail_fast = 0;
+    opts->module_count = 0;
 
-int main(int argc, char *argv[]) {
-    int debug = 0;
     for (int i = 1; i < argc; i++) {
+        const char *jobs = NULL;
+        const char *threads = NULL;
         if (strcmp(argv[i], "--debug") == 0 || strcmp(argv[i], "-d") == 0) {
-            debug = 1;
+            opts->debug = 1;
+        } else if (strcmp(argv[i], "--fork") == 0) {
+            opts->fork = 1;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = argv[i] + 7;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = argv[++i];
+        } else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2]) {
+            jobs = argv[i] + 2;
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = argv[i] + 10;
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = argv[++i];
+        } else if (strncmp(argv[i], "-t", 2) == 0 && argv[i][2]) {
+            threads = argv[i] + 2;
+        } else if (strncmp(argv[i], "--timings=", 10) == 0) {
+            opts->timings_path = argv[i] + 10;
+        } else if (strcmp(argv[i], "--no-timings") == 0) {
+            opts->timings_path = NULL;
+        } else if (strncmp(argv[i], "--slowest=", 10) == 0) {
+            opts->slowest = atoi(argv[i] + 10);
+        } else if (strncmp(argv[i], "--report=", 9) == 0) {
+            if (opts->report_count == MAX_REPORTS) {
+                fprintf(stderr, "At most %d --report outputs are supported\n", MAX_REPORTS);
+                return 1;
+            }
+            opts->report_paths[opts->report_count++] = argv[i] + 9;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            opts->bench = 1;
+        } else if (strncmp(argv[i], "--bench-baseline=", 17) == 0) {
+            opts->bench_baseline_path = argv[i] + 17;
+        } else if (strcmp(argv[i], "--bench-save") == 0) {
+            opts->bench_save = 1;
+        } else if (strncmp(argv[i], "--bench-threshold=", 18) == 0) {
+            opts->bench_opts.threshold_pct = atof(argv[i] + 18);
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            opts->perf = 1;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            opts->profile_dir = LUCY_PROFILE_DIR;
+        } else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            opts->profile_dir = argv[i] + 10;
+        } else if (strncmp(argv[i], "--profile-interval=", 19) == 0) {
+            opts->profile_interval_us = atol(argv[i] + 19);
+            if (opts->profile_interval_us <= 0) opts->profile_interval_us = LUCY_PROFILE_INTERVAL_US;
+        } else if (strncmp(argv[i], "--timeout=", 10) == 0) {
+            opts->timeout_ms = atol(argv[i] + 10);
+            if (opts->timeout_ms < 0) opts->timeout_ms = 0;
+        } else if (strncmp(argv[i], "--shard=", 8) == 0) {
+            int index = 0;
+            int count = 0;
+            if (sscanf(argv[i] + 8, "%d/%d", &index, &count) != 2 || count < 1 || index < 1 || index > count) {
+                fprintf(stderr, "Invalid shard %s: expected I/N with 1 <= I <= N\n", argv[i] + 8);
+                return 1;
+            }
+            opts->shard_index = index - 1;
+            opts->shard_count = count;
+        } else if (strcmp(argv[i], "--shard-by=hash") == 0) {
+            opts->shard_by = SHARD_BY_HASH;
+        } else if (strcmp(argv[i], "--shard-by=duration") == 0) {
+            opts->shard_by = SHARD_BY_DURATION;
+        } else if (strncmp(argv[i], "--filter=", 9) == 0) {
+            opts->filter = argv[i] + 9;
+        } else if (strncmp(argv[i], "--filter-regex=", 15) == 0) {
+            opts->filter_regex = argv[i] + 15;
+        } else if (strncmp(argv[i], "--tag=", 6) == 0) {
+            opts->tags = argv[i] + 6;
+        } else if (strncmp(argv[i], "--changed=", 10) == 0) {
+            opts->changed = argv[i] + 10;
+        } else if (strcmp(argv[i], "--failed-first") == 0) {
+            opts->failed_first = 1;
+        } else if (strcmp(argv[i], "--fail-fast") == 0) {
+            opts->fail_fast = 1;
+        } else if (strncmp(argv[i], "--module=", 9) == 0) {
+            if (opts->module_count == MAX_MODULES) {
+                fprintf(stderr, "At most %d --module options are supported\n", MAX_MODULES);
+                return 1;
+            }
+            opts->module_paths[opts->module_count++] = argv[i] + 9;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        if (jobs) opts->jobs = parse_worker_count(jobs);
+        if (threads) opts->threads = parse_worker_count(threads);
+    }
+
+    if (opts->jobs > 1) opts->fork = 1;
+    if (opts->fork && opts->threads > 0) {
+        fprintf(stderr, "--fork/--jobs and --threads are mutually exclusive\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* Opens counters for the calling thread; on failure the thread runs without them */
+static void perf_attach(PerfCounters *perf, const RunnerOptions *opts) {
+    if (opts->perf && lucy_perf_open(perf) > 0) {
+        thread_perf = perf;
+    }
+}
+
+static void perf_detach(void) {
+    if (thread_perf) lucy_perf_close(thread_perf);
+    thread_perf = NULL;
+}
+
+/* Creates a sampler for the calling thread; on failure the thread runs unprofiled */
+static void profile_attach(Profiler *profiler, const RunnerOptions *opts) {
+    if (opts->profile_dir && lucy_profile_init(profiler, opts->profile_interval_us) == 0) {
+        thread_profiler = profiler;
+    }
+}
+
+static void profile_detach(void) {
+    if (thread_profiler) lucy_profile_free(thread_profiler);
+    thread_profiler = NULL;
+}
+
+static void watchdog_attach(Watchdog *watchdog) {
+    if (lucy_watchdog_init(watchdog) == 0) {
+        thread_watchdog = watchdog;
+    }
+}
+
+static void watchdog_detach(void) {
+    if (thread_watchdog) lucy_watchdog_free(thread_watchdog);
+    thread_watchdog = NULL;
+}
+
+/* Writes the samples of the test that just ran to <profile_dir>/<target_name>.folded */
+static void profile_save(const TestCase *test, const RunnerOptions *opts) {
+    char path[MAX_LINE_LENGTH];
+    snprintf(path, sizeof(path), "%s/%s.folded", opts->profile_dir, test->target_name);
+    lucy_profile_write_folded(thread_profiler, path);
+    if (thread_profiler->dropped > 0) {
+        fprintf(stderr, "%s: profile truncated, %d samples dropped\n", test->target_name, thread_profiler->dropped);
+    }
+}
+
+/* Fails the current test if its body went over an @MaxAllocs or @MaxBytes budget */
+static void check_alloc_budget(const TestCase *test) {
+    if (test->max_allocs >= 0 && test->allocs.allocs > test->max_allocs) {
+        __lucy_test_fail("FAIL: %s made %ld allocations (@MaxAllocs(%ld))\n",
+                         test->target_name, test->allocs.allocs, test->max_allocs);
+    }
+    if (test->max_bytes >= 0 && test->allocs.bytes > test->max_bytes) {
+        __lucy_test_fail("FAIL: %s allocated %ld bytes (@MaxBytes(%ld))\n",
+                         test->target_name, test->allocs.bytes, test->max_bytes);
+    }
+}
+
+/* Runs every setup, the test itself and every teardown in the current process.
+ * Allocations, --perf counters and --profile samples cover only the test
+ * function itself and are stored in the test; the caller writes the samples
+ * out with profile_save once it has stopped timing the test.
+ */
+static int run_test_body(TestCase *test, const RunnerOptions *opts) {
+    __test_failed = 0;
+    test->timed_out = 0;
+    for (int j = 0; j < setup_count; j++) {
+        setup_funcs[j]();
+    }
+
+    if (opts->debug) printf("Running test: %s\n", test->description);
+    if (thread_profiler) lucy_profile_start(thread_profiler);
+    if (thread_perf) lucy_perf_start(thread_perf);
+    lucy_alloc_start(&test->allocs);
+    double start = now_ms();
+    if (thread_watchdog) {
+        thread_watchdog->name = test->target_name;
+        test->timed_out = lucy_watchdog_run(thread_watchdog, test->func, test->timeout_ms);
+    } else {
+        test->func();
+    }
+    lucy_alloc_stop();
+    if (test->timed_out) {
+        __lucy_test_fail("FAIL: %s timed out after %.0f ms (limit %ld ms)\n",
+                         test->target_name, now_ms() - start, test->timeout_ms);
+    }
+    if (thread_perf) lucy_perf_stop(thread_perf, &test->perf);
+    if (thread_profiler) lucy_profile_stop(thread_profiler);
+    check_alloc_budget(test);
+
+    for (int j = 0; j < teardown_count; j++) {
+        teardown_funcs[j]();
+    }
+    return __test_failed;
+}
+
+/* Returns: 1 if both are the same recorded source file (or both unknown) */
+static int same_source(const char *a, const char *b) {
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+/* Runs the fixtures scoped to file (NULL: the suite-wide ones) in the runner process.
+ * Their failure messages are printed as they happen and, if messages isn't NULL,
+ * also collected there.
+ * Returns: 1 if any of them failed an assertion, 0 otherwise
+ */
+static int run_fixtures(const Fixture *fixtures, int count, const char *file, const char *kind, int debug,
+                        ReportBuffer *messages) {
+    __test_failed = 0;
+    ReportBuffer *saved = report_buffer;
+    if (messages) {
+        messages->echo = 1;
+        report_buffer = messages;
+    }
+    for (int j = 0; j < count; j++) {
+        if (!same_source(fixtures[j].file, file)) continue;
+        if (debug) printf("Running %s fixture %d%s%s\n", kind, j, file ? " of " : "", file ? file : "");
+        fixtures[j].func();
+    }
+    report_buffer = saved;
+    return __test_failed;
+}
+
+/* Runs tests one after another in declaration order, inside the runner process */
+static void run_sequential(TestCase *tests, int count, const RunnerOptions *opts) {
+    ReportBuffer buffer = {0};
+    buffer.echo = 1;
+    report_buffer = &buffer;
+    PerfCounters perf;
+    perf_attach(&perf, opts);
+    Profiler profiler;
+    profile_attach(&profiler, opts);
+    Watchdog watchdog;
+    watchdog_attach(&watchdog);
+
+    for (int i = 0; i < count; i++) {
+        if (__atomic_load_n(&stop_requested, __ATOMIC_RELAXED)) break;
+        printf("Running: %s ", tests[i].description);
+        fflush(stdout);
+
+        buffer.len = 0;
+        double start = now_ms();
+        double cpu_start = thread_cpu_ms();
+        tests[i].failed = run_test_body(&tests[i], opts);
+        tests[i].cpu_ms = thread_cpu_ms() - cpu_start;
+        tests[i].wall_ms = now_ms() - start;
+        if (thread_profiler) profile_save(&tests[i], opts);
+
+        printf(tests[i].failed ? "✘\n" : "✔\n");
+        complete_test(&tests[i], &buffer);
+    }
+
+    watchdog_detach();
+    profile_detach();
+    perf_detach();
+    report_buffer = NULL;
+    free(buffer.data);
+}
+
+/* One in-flight forked test and the output it has produced so far */
+typedef struct {
+    pid_t pid;
+    int fd;        // Read end of the child's stdout/stderr pipe
+    int test;      // Index into the tests array
+    double start;  // now_ms() at fork time
+    int killed;    // 1 once the runner killed the child for running past its timeout
+    ReportBuffer output;
+} Worker;
+
+/* What a forked child measured, handed back to the runner */
+typedef struct {
+    PerfCounts perf;
+    AllocStats allocs;
+    double wall_ms;  // The test body alone, without fork, startup or writing its profile
+    double cpu_ms;
+} ChildMeasurements;
+
+/* Forked children publish measurements here, one slot per test (MAP_SHARED) */
+static ChildMeasurements *shared_measurements = NULL;
+
+static int worker_start(Worker *worker, TestCase *tests, int test, const RunnerOptions *opts) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return 1;
+    }
+
+    if (pid == 0) {
+        /* Child: report through the pipe, exit status carries pass/fail */
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[1]);
+        /* The parent's counters follow the parent thread; count this child separately */
+        PerfCounters perf;
+        Profiler profiler;
+        thread_perf = NULL;
+        thread_watchdog = NULL;  // The runner kills this child on timeout instead
+        perf_attach(&perf, opts);
+        profile_attach(&profiler, opts);  // Timers aren't inherited across fork
+        double start = now_ms();
+        double cpu_start = thread_cpu_ms();
+        int failed = run_test_body(&tests[test], opts);
+        if (shared_measurements) {
+            shared_measurements[test].perf = tests[test].perf;
+            shared_measurements[test].allocs = tests[test].allocs;
+            shared_measurements[test].cpu_ms = thread_cpu_ms() - cpu_start;
+            shared_measurements[test].wall_ms = now_ms() - start;
+        }
+        if (thread_profiler) profile_save(&tests[test], opts);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(failed ? 1 : 0);
+    }
+
+    close(fds[1]);
+    worker->pid = pid;
+    worker->fd = fds[0];
+    worker->test = test;
+    worker->start = now_ms();
+    worker->killed = 0;
+    worker->output.len = 0;
+    return 0;
+}
+
+/* Reaps a worker whose pipe reached EOF and prints its report in one piece */
+static void worker_finish(Worker *worker, TestCase *tests) {
+    int status = 0;
+    struct rusage usage;
+    close(worker->fd);
+    wait4(worker->pid, &status, 0, &usage);
+
+    TestCase *test = &tests[worker->test];
+    test->wall_ms = now_ms() - worker->start;
+    test->cpu_ms = usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0 +
+                   usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+    test->failed = !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    if (shared_measurements) {
+        test->perf = shared_measurements[worker->test].perf;
+        test->allocs = shared_measurements[worker->test].allocs;
+        if (shared_measurements[worker->test].wall_ms > 0) {  // 0: killed before it finished
+            test->wall_ms = shared_measurements[worker->test].wall_ms;
+            test->cpu_ms = shared_measurements[worker->test].cpu_ms;
+        }
+    }
+
+    test->timed_out = worker->killed;
+    if (test->timed_out) {
+        char message[MAX_LINE_LENGTH];
+        int len = snprintf(message, sizeof(message), "FAIL: %s timed out after %.0f ms (limit %ld ms)\n",
+                           test->target_name, test->wall_ms, test->timeout_ms);
+        report_append(&worker->output, message, len);
+    }
+
+    printf("Running: %s ", test->description);
+    fwrite(worker->output.data, 1, worker->output.len, stdout);
+    if (test->timed_out) {
+        printf("✘ (timed out)\n");
+    } else if (WIFSIGNALED(status)) {
+        printf("✘ (crashed: %s)\n", strsignal(WTERMSIG(status)));
+    } else {
+        printf(test->failed ? "✘\n" : "✔\n");
+    }
+    fflush(stdout);
+    complete_test(test, &worker->output);
+
+    worker->pid = 0;
+    worker->fd = -1;
+}
+
+/* Milliseconds until the earliest running child reaches its timeout, or -1 for none */
+static int poll_timeout(const Worker *workers, const TestCase *tests, int jobs) {
+    double earliest = -1;
+    double now = now_ms();
+    for (int w = 0; w < jobs; w++) {
+        long timeout_ms = tests[workers[w].test].timeout_ms;
+        if (workers[w].fd < 0 || workers[w].killed || timeout_ms <= 0) continue;
+        double remaining = workers[w].start + timeout_ms - now;
+        if (remaining < 0) remaining = 0;
+        if (earliest < 0 || remaining < earliest) earliest = remaining;
+    }
+    return earliest < 0 ? -1 : (int)earliest + 1;
+}
+
+/* SIGKILLs children past their timeout; their pipes then reach EOF as usual */
+static void kill_overdue(Worker *workers, const TestCase *tests, int jobs) {
+    double now = now_ms();
+    for (int w = 0; w < jobs; w++) {
+        long timeout_ms = tests[workers[w].test].timeout_ms;
+        if (workers[w].fd < 0 || workers[w].killed || timeout_ms <= 0) continue;
+        if (now - workers[w].start >= timeout_ms) {
+            kill(workers[w].pid, SIGKILL);
+            workers[w].killed = 1;
+        }
+    }
+}
+
+/* Runs each test in its own forked child, keeping up to opts->jobs children busy.
+ * Tests are handed out longest-first from the timings cache, and a worker slot
+ * takes the next test as soon as it frees up, so the tail of the run is made of
+ * short tests rather than one straggler.
+ */
+static void run_forked(TestCase *tests, int count, const RunnerOptions *opts) {
+    int *order = malloc(count * sizeof(int));
+    Worker *workers = calloc(opts->jobs, sizeof(Worker));
+    struct pollfd *fds = malloc(opts->jobs * sizeof(struct pollfd));
+    if (!order || !workers || !fds) {
+        fprintf(stderr, "Memory allocation failed in run_forked\n");
+        free(order);
+        free(workers);
+        free(fds);
+        return;
+    }
+    lucy_schedule_longest_first(tests, count, order);
+    shared_measurements = mmap(NULL, count * sizeof(ChildMeasurements), PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared_measurements == MAP_FAILED) shared_measurements = NULL;
+
+    if (opts->debug) {
+        printf("Schedule (%d workers):\n", opts->jobs);
+        for (int i = 0; i < count; i++) {
+            printf("  %s (expected %.3f ms)\n", tests[order[i]].target_name, tests[order[i]].expected_ms);
+        }
+    }
+
+    int next = 0;
+    int active = 0;
+    for (int w = 0; w < opts->jobs; w++) workers[w].fd = -1;
+
+    while (next < count || active > 0) {
+        if (__atomic_load_n(&stop_requested, __ATOMIC_RELAXED)) next = count;  // Let running children finish
+        for (int w = 0; w < opts->jobs && next < count; w++) {
+            if (workers[w].fd >= 0) continue;
+            if (worker_start(&workers[w], tests, order[next], opts) != 0) {
+                fail_without_running(&tests[order[next]], "could not start a worker", NULL);
+            } else {
+                active++;
+            }
+            next++;
+        }
+        if (active == 0) continue;
+
+        int nfds = 0;
+        for (int w = 0; w < opts->jobs; w++) {
+            if (workers[w].fd < 0) continue;
+            fds[nfds].fd = workers[w].fd;
+            fds[nfds].events = POLLIN;
+            fds[nfds].revents = 0;
+            nfds++;
+        }
+        if (poll(fds, nfds, poll_timeout(workers, tests, opts->jobs)) < 0) continue;  // EINTR: just poll again
+        kill_overdue(workers, tests, opts->jobs);
+
+        for (int p = 0; p < nfds; p++) {
+            if (!fds[p].revents) continue;
+            Worker *worker = NULL;
+            for (int w = 0; w < opts->jobs; w++) {
+                if (workers[w].fd == fds[p].fd) worker = &workers[w];
+            }
+
+            char buffer[4096];
+            ssize_t n = read(worker->fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                report_append(&worker->output, buffer, n);
+            } else if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;  // Interrupted (e.g. by --profile's SIGPROF), not finished: poll again
+            } else {
+                worker_finish(worker, tests);
+                active--;
+            }
+        }
+    }
+
+    for (int w = 0; w < opts->jobs; w++) free(workers[w].output.data);
+    if (shared_measurements) munmap(shared_measurements, count * sizeof(ChildMeasurements));
+    shared_measurements = NULL;
+    free(order);
+    free(workers);
+    free(fds);
+}
+
+/* Prints the per-operation counters of a benchmark, skipping unavailable ones */
+static void print_perf_per_op(const PerfCounts *perf) {
+    if (!perf->valid) return;
+    printf("    ");
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        if (perf->values[e] >= 0) printf("%.2f %s/op  ", perf->values[e], lucy_perf_event_name(e));
+    }
+    double cycles = perf->values[PERF_CYCLES];
+    double instructions = perf->values[PERF_INSTRUCTIONS];
+    if (cycles > 0 && instructions >= 0) printf("IPC %.2f", instructions / cycles);
+    printf("\n");
+}
+
+/* Runs every benchmark on the runner's main thread, one at a time, so nothing
+ * else competes for the CPU while it is being measured
+ * Returns: number of benchmarks that failed an assertion or regressed
+ */
+static int run_benchmarks(Benchmark *benchmarks, int count, const RunnerOptions *opts) {
+    TimingCache baselines = {0};
+    if (lucy_timings_load(&baselines, opts->bench_baseline_path) != 0) {
+        fprintf(stderr, "Ignoring unreadable benchmark baselines %s\n", opts->bench_baseline_path);
+    }
+
+    PerfCounters perf;
+    perf_attach(&perf, opts);
+
+    int bad = 0;
+    printf("\nRunning benchmarks...\n");
+    for (int i = 0; i < count; i++) {
+        Benchmark *bench = &benchmarks[i];
+        printf("Benchmark: %s ", bench->description);
+        fflush(stdout);
+
+        bench->baseline_ns = lucy_timings_lookup(&baselines, bench->target_name);
+        __test_failed = 0;
+        for (int j = 0; j < setup_count; j++) setup_funcs[j]();
+        lucy_bench_run(bench, &opts->bench_opts, thread_perf);
+        for (int j = 0; j < teardown_count; j++) teardown_funcs[j]();
+        bench->failed = __test_failed;
+
+        printf("%.1f ns/op (MAD %.1f, p99 %.1f; %ld iterations x %d samples) ",
+               bench->median_ns, bench->mad_ns, bench->p99_ns, bench->iterations, bench->samples);
+        if (bench->failed) {
+            printf("✘\n");
+        } else if (bench->baseline_ns > 0) {
+            double change = (bench->median_ns / bench->baseline_ns - 1.0) * 100.0;
+            printf("%s (%+.1f%% vs baseline %.1f ns/op)\n", bench->regressed ? "✘" : "✔", change, bench->baseline_ns);
+        } else {
+            printf("✔ (no baseline)\n");
+        }
+        print_perf_per_op(&bench->perf);
+        if (bench->failed || bench->regressed) bad++;
+
+        for (int r = 0; r < report_count; r++) {
+            lucy_report_benchmark(&reports[r], bench);
+        }
+        if (opts->bench_save && !bench->failed) {
+            lucy_timings_record(&baselines, bench->target_name, bench->median_ns);
+        }
+    }
+
+    if (opts->bench_save) {
+        lucy_timings_save(&baselines, opts->bench_baseline_path);
+        printf("Saved benchmark baselines to %s\n", opts->bench_baseline_path);
+    }
+    perf_detach();
+    lucy_timings_free(&baselines);
+    return bad;
+}
+
+/* Shared state of one thread pool run */
+typedef struct {
+    TestCase *tests;
+    const int *order;
+    int count;
+    int next;  // Next position in order; claimed with an atomic add
+    const RunnerOptions *opts;
+} ThreadPool;
+
+static void *thread_worker(void *arg) {
+    ThreadPool *pool = arg;
+    ReportBuffer buffer = {0};
+    report_buffer = &buffer;
+    PerfCounters perf;
+    perf_attach(&perf, pool->opts);
+    Profiler profiler;
+    profile_attach(&profiler, pool->opts);
+    Watchdog watchdog;
+    watchdog_attach(&watchdog);
+
+    for (;;) {
+        if (__atomic_load_n(&stop_requested, __ATOMIC_RELAXED)) break;
+        int position = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+        if (position >= pool->count) break;
+        TestCase *test = &pool->tests[pool->order[position]];
+
+        buffer.len = 0;
+        double start = now_ms();
+        double cpu_start = thread_cpu_ms();
+        test->failed = run_test_body(test, pool->opts);
+        test->cpu_ms = thread_cpu_ms() - cpu_start;
+        test->wall_ms = now_ms() - start;
+        if (thread_profiler) profile_save(test, pool->opts);
+
+        pthread_mutex_lock(&report_lock);
+        printf("Running: %s ", test->description);
+        fwrite(buffer.data, 1, buffer.len, stdout);
+        printf(test->failed ? "✘\n" : "✔\n");
+        fflush(stdout);
+        complete_test(test, &buffer);
+        pthread_mutex_unlock(&report_lock);
+    }
+
+    watchdog_detach();
+    profile_detach();
+    perf_detach();
+    report_buffer = NULL;
+    free(buffer.data);
+    return NULL;
+}
+
+/* Runs tests on opts->threads threads inside the runner process. Failure state is
+ * thread-local and assertion messages are buffered per test, so each report is
+ * printed in one piece. Tests are claimed longest-first, like forked workers.
+ */
+static void run_threaded(TestCase *tests, int count, const RunnerOptions *opts) {
+    int *order = malloc(count * sizeof(int));
+    pthread_t *threads = malloc(opts->threads * sizeof(pthread_t));
+    if (!order || !threads) {
+        fprintf(stderr, "Memory allocation failed in run_threaded\n");
+        free(order);
+        free(threads);
+        return;
+    }
+    lucy_schedule_longest_first(tests, count, order);
+
+    ThreadPool pool = { tests, order, count, 0, opts };
+    int started = 0;
+    for (int t = 0; t < opts->threads; t++) {
+        if (pthread_create(&threads[t], NULL, thread_worker, &pool) != 0) {
+            perror("pthread_create");
             break;
         }
+        started++;
+    }
+    if (started == 0) thread_worker(&pool);  // Degrade to running on this thread
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    free(order);
+    free(threads);
+}
+
+static int is_not_thread_safe(const TestCase *test) {
+    return test->not_thread_safe;
+}
+
+/* Moves the tests matching first() to the front, keeping declaration order within both groups
+ * Returns: number of matching tests
+ */
+static int partition_tests(TestCase *tests, int count, int (*first)(const TestCase *)) {
+    TestCase *sorted = malloc(count * sizeof(TestCase));
+    if (!sorted) return 0;
+    int leading = 0;
+    for (int i = 0; i < count; i++) {
+        if (first(&tests[i])) sorted[leading++] = tests[i];
+    }
+    int position = leading;
+    for (int i = 0; i < count; i++) {
+        if (!first(&tests[i])) sorted[position++] = tests[i];
+    }
+    memcpy(tests, sorted, count * sizeof(TestCase));
+    free(sorted);
+    return leading;
+}
+
+/* Returns: index one past the run of tests from the same source file as tests[start] */
+static int group_end(const TestCase *tests, int count, int start) {
+    int end = start + 1;
+    while (end < count && same_source(tests[end].file, tests[start].file)) end++;
+    return end;
+}
+
+/* Reorders for --failed-first without breaking up file groups: groups holding a
+ * last failure run first, and within each group its failures lead
+ * Returns: number of tests that failed last time
+ */
+static int order_failed_first(TestCase *tests, int count) {
+    TestCase *sorted = malloc(count * sizeof(TestCase));
+    if (!sorted) return 0;
+    int position = 0;
+    int rerun = 0;
+    for (int pass = 1; pass >= 0; pass--) {
+        for (int start = 0; start < count;) {
+            int end = group_end(tests, count, start);
+            int group_failed = 0;
+            for (int i = start; i < end; i++) group_failed |= tests[i].last_failed;
+            if (group_failed == pass) {
+                for (int i = start; i < end; i++) {
+                    if (tests[i].last_failed) sorted[position++] = tests[i];
+                }
+                for (int i = start; i < end; i++) {
+                    if (!tests[i].last_failed) sorted[position++] = tests[i];
+                }
+            }
+            start = end;
+        }
+    }
+    for (int i = 0; i < count; i++) rerun += sorted[i].last_failed;
+    memcpy(tests, sorted, count * sizeof(TestCase));
+    free(sorted);
+    return rerun;
+}
+
+/* Runs tests with the executor chosen on the command line */
+static void run_tests(TestCase *tests, int count, const RunnerOptions *opts) {
+    if (opts->fork || opts->threads > 0) {
+        /* @NotThreadSafe tests run first, alone, exactly as in sequential mode */
+        int serial = partition_tests(tests, count, is_not_thread_safe);
+        run_sequential(tests, serial, opts);
+        if (opts->fork) {
+            run_forked(tests + serial, count - serial, opts);
+        } else {
+            run_threaded(tests + serial, count - serial, opts);
+        }
+    } else {
+        run_sequential(tests, count, opts);
+    }
+}
+
+static int has_file_fixtures(const char *file) {
+    if (!file) return 0;
+    for (int j = 0; j < before_all_count; j++) {
+        if (same_source(before_all_fixtures[j].file, file)) return 1;
+    }
+    for (int j = 0; j < after_all_count; j++) {
+        if (same_source(after_all_fixtures[j].file, file)) return 1;
+    }
+    return 0;
+}
+
+/* Runs the tests one source file at a time, wrapping each file that has
+ * @BeforeAll("file")/@AfterAll("file") fixtures in them. Tests arrive grouped by
+ * file in the order lucy processed the files; neighbouring files without
+ * fixtures share one batch so parallel runs aren't cut into small pieces.
+ * Returns: 1 if a file-scoped @AfterAll failed, 0 otherwise
+ */
+static int run_file_groups(TestCase *tests, int count, const RunnerOptions *opts) {
+    int after_all_failed = 0;
+    for (int start = 0; start < count;) {
+        const char *file = tests[start].file;
+        int end = group_end(tests, count, start);
+        if (!has_file_fixtures(file)) {
+            while (end < count && !has_file_fixtures(tests[end].file)) end = group_end(tests, count, end);
+            run_tests(tests + start, end - start, opts);
+        } else if (!__atomic_load_n(&stop_requested, __ATOMIC_RELAXED)) {
+            ReportBuffer messages = {0};
+            if (run_fixtures(before_all_fixtures, before_all_count, file, "before-all", opts->debug, &messages)) {
+                printf("✘ @BeforeAll of %s failed; skipping %d tests\n", file, end - start);
+                char reason[MAX_LINE_LENGTH];
+                snprintf(reason, sizeof(reason), "not run: @BeforeAll of %s failed", file);
+                for (int i = start; i < end; i++) fail_without_running(&tests[i], reason, &messages);
+            } else {
+                run_tests(tests + start, end - start, opts);
+            }
+            free(messages.data);
+            if (run_fixtures(after_all_fixtures, after_all_count, file, "after-all", opts->debug, NULL)) {
+                printf("✘ @AfterAll of %s failed\n", file);
+                after_all_failed = 1;
+            }
+        }
+        start = end;
+    }
+    return after_all_failed;
+}
+
+/* Returns: the source file a @BeforeAll/@AfterAll is scoped to with ("file"), or NULL */
+static const char *fixture_file(const struct Annotation *fixture) {
+    if (fixture->arg_count > 0 && fixture->args[0] && strcmp(fixture->args[0], "file") == 0) {
+        return fixture->file;
+    }
+    return NULL;
+}
+
+/* Compiled --filter/--filter-regex/--tag selection */
+typedef struct {
+    const char *glob;
+    regex_t regex;
+    int has_regex;
+    TestFunc *tagged;  // Sorted functions carrying a selected tag
+    int tagged_count;
+    int has_tags;
+} Selection;
+
+static int compare_funcs(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t)*(const TestFunc *)a;
+    uintptr_t y = (uintptr_t)*(const TestFunc *)b;
+    return (x > y) - (x < y);
+}
+
+/* Builds the selection; tagged functions come straight from the generated
+ * per-tag index lists, so no annotation outside the selected tags is visited
+ * Returns: 0 on success, 1 on an invalid regex or allocation failure
+ */
+static int selection_init(Selection *selection, const RunnerOptions *opts, const AnnotationTable *table) {
+    memset(selection, 0, sizeof(*selection));
+    selection->glob = opts->filter;
+    if (opts->filter_regex) {
+        int error = regcomp(&selection->regex, opts->filter_regex, REG_EXTENDED | REG_NOSUB);
+        if (error) {
+            char message[MAX_BUFFER_SIZE];
+            regerror(error, &selection->regex, message, sizeof(message));
+            fprintf(stderr, "Invalid --filter-regex %s: %s\n", opts->filter_regex, message);
+            return 1;
+        }
+        selection->has_regex = 1;
+    }
+    if (!opts->tags) return 0;
+
+    selection->has_tags = 1;
+    char tags[MAX_BUFFER_SIZE];
+    snprintf(tags, sizeof(tags), "%s", opts->tags);
+    for (char *tag = strtok(tags, ","); tag; tag = strtok(NULL, ",")) {
+        for (int t = 0; t < table->tag_count; t++) {
+            const struct TagIndex *index = &table->tags[t];
+            if (strcmp(index->tag, tag) != 0) continue;
+            TestFunc *grown = realloc(selection->tagged, (selection->tagged_count + index->count) * sizeof(TestFunc));
+            if (!grown) {
+                fprintf(stderr, "Memory allocation failed in selection_init\n");
+                return 1;
+            }
+            selection->tagged = grown;
+            for (int k = 0; k < index->count; k++) {
+                selection->tagged[selection->tagged_count++] = (TestFunc)table->annotations[index->annotations[k]].target;
+            }
+        }
+    }
+    qsort(selection->tagged, selection->tagged_count, sizeof(TestFunc), compare_funcs);
+    return 0;
+}
+
+/* Returns: 1 if a test or benchmark passes every configured filter */
+static int selection_matches(const Selection *selection, const char *description, const char *target_name, TestFunc func) {
+    if (selection->glob && fnmatch(selection->glob, description, 0) != 0 &&
+        fnmatch(selection->glob, target_name, 0) != 0) {
+        return 0;
+    }
+    if (selection->has_regex && regexec(&selection->regex, description, 0, NULL, 0) != 0 &&
+        regexec(&selection->regex, target_name, 0, NULL, 0) != 0) {
+        return 0;
+    }
+    if (selection->has_tags &&
+        !bsearch(&func, selection->tagged, selection->tagged_count, sizeof(TestFunc), compare_funcs)) {
+        return 0;
+    }
+    return 1;
+}
+
+static void selection_free(Selection *selection) {
+    if (selection->has_regex) regfree(&selection->regex);
+    free(selection->tagged);
+}
+
+/* Changed source files given with --changed */
+typedef struct {
+    char **paths;
+    int count;
+} ChangeSet;
+
+static int changes_add(ChangeSet *changes, const char *path, size_t len) {
+    while (len > 0 && (path[len - 1] == '\n' || path[len - 1] == '\r' || path[len - 1] == ' ')) len--;
+    if (len == 0) return 0;
+    char **grown = realloc(changes->paths, (changes->count + 1) * sizeof(char *));
+    if (!grown) return 1;
+    changes->paths = grown;
+    changes->paths[changes->count] = strndup(path, len);
+    if (!changes->paths[changes->count]) return 1;
+    changes->count++;
+    return 0;
+}
+
+/* Reads the changed files from a comma-separated list, or one per line from stdin for "-"
+ * (e.g. `git diff --name-only | ./test_runner --changed=-`)
+ * Returns: 0 on success, 1 on allocation failure
+ */
+static int changes_load(ChangeSet *changes, const char *spec) {
+    memset(changes, 0, sizeof(*changes));
+    if (strcmp(spec, "-") == 0) {
+        char line[MAX_BUFFER_SIZE];
+        while (fgets(line, sizeof(line), stdin)) {
+            if (changes_add(changes, line, strlen(line)) != 0) return 1;
+        }
+        return 0;
+    }
+    while (*spec) {
+        const char *end = strchr(spec, ',');
+        size_t len = end ? (size_t)(end - spec) : strlen(spec);
+        if (changes_add(changes, spec, len) != 0) return 1;
+        spec += end ? len + 1 : len;
+    }
+    return 0;
+}
+
+static void changes_free(ChangeSet *changes) {
+    for (int i = 0; i < changes->count; i++) free(changes->paths[i]);
+    free(changes->paths);
+}
+
+/* Returns: 1 if both paths name the same file: equal after any leading "./", or
+ * one a suffix of the other starting at a directory boundary (absolute vs relative)
+ */
+static int same_file(const char *a, const char *b) {
+    while (strncmp(a, "./", 2) == 0) a += 2;
+    while (strncmp(b, "./", 2) == 0) b += 2;
+    size_t a_len = strlen(a);
+    size_t b_len = strlen(b);
+    if (a_len < b_len) {
+        const char *swap = a;
+        a = b;
+        b = swap;
+        size_t swap_len = a_len;
+        a_len = b_len;
+        b_len = swap_len;
+    }
+    if (b_len == 0 || strcmp(a + a_len - b_len, b) != 0) return 0;
+    return a_len == b_len || a[a_len - b_len - 1] == '/';
+}
+
+static int changes_touch(const ChangeSet *changes, const char *path) {
+    if (!path) return 0;
+    for (int i = 0; i < changes->count; i++) {
+        if (same_file(path, changes->paths[i])) return 1;
+    }
+    return 0;
+}
+
+/* Returns: 1 if a test is defined in a changed file or @Covers one */
+static int changes_affect(const ChangeSet *changes, const struct Annotation *covers,
+                          const char *file, const char *target_name) {
+    if (changes_touch(changes, file)) return 1;
+    for (int i = 0; covers[i].name; i++) {
+        if (strcmp(covers[i].target_name, target_name) != 0) continue;
+        for (int a = 0; a < covers[i].arg_count; a++) {
+            if (changes_touch(changes, covers[i].args[a])) return 1;
+        }
+    }
+    return 0;
+}
+
+/* Keeps only the tests assigned to this shard, preserving their order
+ * Returns: number of tests kept
+ */
+static int select_shard(TestCase *tests, int count, const RunnerOptions *opts) {
+    int *shard_of = malloc((count ? count : 1) * sizeof(int));
+    if (!shard_of || lucy_shard_assign(tests, count, opts->shard_count, opts->shard_by, shard_of) != 0) {
+        fprintf(stderr, "Memory allocation failed in select_shard; running every test\n");
+        free(shard_of);
+        return count;
+    }
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (shard_of[i] == opts->shard_index) tests[kept++] = tests[i];
+    }
+    free(shard_of);
+    return kept;
+}
+
+/* Looks up the numeric argument of a budget annotation (@MaxAllocs, @Timeout, ...) on target_name
+ * Returns: the budget, or -1 if the test has none
+ */
+static long annotation_budget(const struct Annotation *budgets, const char *target_name) {
+    for (int i = 0; budgets[i].name; i++) {
+        if (strcmp(budgets[i].target_name, target_name) == 0 && budgets[i].arg_count > 0 && budgets[i].args[0]) {
+            return atol(budgets[i].args[0]);
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    RunnerOptions opts;
+    if (parse_options(argc, argv, &opts) != 0) {
+        return 1;
+    }
+    int debug = opts.debug;
+    double run_start = now_ms();
+
+    for (int r = 0; r < opts.report_count; r++) {
+        if (lucy_report_open(&reports[report_count], opts.report_paths[r]) == 0) {
+            report_count++;
+        }
+    }
+
+    if (opts.perf) {
+        PerfCounters probe;
+        if (lucy_perf_open(&probe) == 0) {
+            fprintf(stderr, "--perf: hardware counters unavailable (%s); check /proc/sys/kernel/perf_event_paranoid\n",
+                    strerror(probe.error));
+            opts.perf = 0;
+        }
+        lucy_perf_close(&probe);
+    }
+
+    if (opts.profile_dir && mkdir(opts.profile_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "--profile: cannot create %s: %s\n", opts.profile_dir, strerror(errno));
+        return 1;
+    }
+
+    /* Copy the linked-in table before anything can rewrite it (see sync_annotations),
+     * then append every --module; a module that fails to load doesn't stop the rest */
+    AnnotationTable table;
+    if (lucy_table_init(&table, __ANNOTATIONS, __ANNOTATION_COUNT, __TAGS, __TAG_COUNT) != 0) {
+        return 1;
+    }
+    for (int m = 0; m < opts.module_count; m++) {
+        lucy_table_load_module(&table, opts.module_paths[m]);
+    }
+    if (opts.module_count > 0) {
+        printf("Loaded %d of %d modules (%d annotations in total)\n", table.module_count, opts.module_count, table.count);
+    }
+
+    Selection selection;
+    if (selection_init(&selection, &opts, &table) != 0) {
+        selection_free(&selection);
+        lucy_table_free(&table);
+        return 1;
     }
 
     lucy_init();
 
     if (debug) {
-        printf("Total annotations: %d\n", __ANNOTATION_COUNT);
-        for (int i = 0; i < __ANNOTATION_COUNT; i++) {
+        printf("Total annotations: %d\n", table.count);
+        for (int i = 0; i < table.count; i++) {
             printf("Annotation %d: name=%s, target_name=%s, isRemoved=%d\n",
-                   i, __ANNOTATIONS[i].name, __ANNOTATIONS[i].target_name, __ANNOTATIONS[i].isRemoved);
+                   i, table.annotations[i].name, table.annotations[i].target_name, table.annotations[i].isRemoved);
         }
     }
 
-    struct Annotation *tests = find_annotated_blocks("Test");
-    struct Annotation *disabled = find_annotated_blocks("Disable");
-    struct Annotation *setups = find_annotated_blocks("Setup");
-    struct Annotation *teardowns = find_annotated_blocks("Teardown");
+    struct Annotation *tests = lucy_table_find(&table, "Test");
+    struct Annotation *disabled = lucy_table_find(&table, "Disable");
+    struct Annotation *setups = lucy_table_find(&table, "Setup");
+    struct Annotation *teardowns = lucy_table_find(&table, "Teardown");
+    struct Annotation *not_thread_safe = lucy_table_find(&table, "NotThreadSafe");
+    struct Annotation *before_alls = lucy_table_find(&table, "BeforeAll");
+    struct Annotation *after_alls = lucy_table_find(&table, "AfterAll");
+    struct Annotation *benches = lucy_table_find(&table, "Benchmark");
+    struct Annotation *max_allocs = lucy_table_find(&table, "MaxAllocs");
+    struct Annotation *max_bytes = lucy_table_find(&table, "MaxBytes");
+    struct Annotation *timeouts = lucy_table_find(&table, "Timeout");
+    struct Annotation *covers = lucy_table_find(&table, "Covers");
+
+    /* Each run list holds at most one entry per annotation in the merged table */
+    TestCase *enabled_tests = calloc(table.count + 1, sizeof(TestCase));
+    Benchmark *benchmarks = calloc(table.count + 1, sizeof(Benchmark));
+    setup_funcs = calloc(table.count + 1, sizeof(TestFunc));
+    teardown_funcs = calloc(table.count + 1, sizeof(TestFunc));
+    before_all_fixtures = calloc(table.count + 1, sizeof(Fixture));
+    after_all_fixtures = calloc(table.count + 1, sizeof(Fixture));
 
     if (debug) {
-        printf("tests=%p, disabled=%p, setups=%p, teardowns=%p\n", 
+        printf("tests=%p, disabled=%p, setups=%p, teardowns=%p\n",
                (void*)tests, (void*)disabled, (void*)setups, (void*)teardowns);
     }
 
-    if (!tests || !disabled || !setups || !teardowns) {
+    if (!tests || !disabled || !setups || !teardowns || !not_thread_safe || !before_alls || !after_alls || !benches ||
+        !max_allocs || !max_bytes || !timeouts || !covers || !enabled_tests || !benchmarks || !setup_funcs ||
+        !teardown_funcs || !before_all_fixtures || !after_all_fixtures) {
         printf("Failed to allocate annotation arrays\n");
         if (tests) free(tests);
         if (disabled) free(disabled);
         if (setups) free(setups);
         if (teardowns) free(teardowns);
+        if (not_thread_safe) free(not_thread_safe);
+        if (before_alls) free(before_alls);
+        if (after_alls) free(after_alls);
+        if (benches) free(benches);
+        if (max_allocs) free(max_allocs);
+        if (max_bytes) free(max_bytes);
+        if (timeouts) free(timeouts);
+        if (covers) free(covers);
+        free(enabled_tests);
+        free(benchmarks);
+        free(setup_funcs);
+        free(teardown_funcs);
+        free(before_all_fixtures);
+        free(after_all_fixtures);
+        selection_free(&selection);
+        lucy_table_free(&table);
         lucy_cleanup();
         return 1;
     }
 
     if (debug) {
-        printf("Tests found: %d\n", __ANNOTATION_COUNT);
-        for (int i = 0; i < __ANNOTATION_COUNT; i++) {
-            printf("  %d: name=%s, target_name=%s, isRemoved=%d\n", 
-                   i, tests[i].name ? tests[i].name : "(null)", 
-                   tests[i].target_name ? tests[i].target_name : "(null)", 
+        printf("Tests found: %d\n", table.count);
+        for (int i = 0; i < table.count && tests[i].name; i++) {
+            printf("  %d: name=%s, target_name=%s, isRemoved=%d\n",
+                   i, tests[i].name ? tests[i].name : "(null)",
+                   tests[i].target_name ? tests[i].target_name : "(null)",
                    tests[i].isRemoved);
         }
     }
 
-    struct Annotation enabled_tests[MAX_ANNOTATIONS];
     int enabled_test_count = 0;
-    int test_count = 0;
 
-    for (int i = 0; i < __ANNOTATION_COUNT && tests[i].name; i++) {
-        if (strcmp(tests[i].name, "Test") == 0 && !tests[i].isRemoved) {
-            test_count++;
-        }
-    }
-
-    if (debug) printf("test_count: %d\n", test_count);
-
-    int test_index = 0;
-    for (int i = 0; i < __ANNOTATION_COUNT && tests[i].name && test_index < test_count; i++) {
+    for (int i = 0; i < table.count && tests[i].name; i++) {
         if (strcmp(tests[i].name, "Test") == 0 && !tests[i].isRemoved) {
             int is_disabled = 0;
-            for (int j = 0; j < __ANNOTATION_COUNT && disabled[j].name; j++) {
+            for (int j = 0; j < table.count && disabled[j].name; j++) {
                 if (strcmp(disabled[j].name, "Disable") == 0 &&
                     strcmp(disabled[j].target_name, tests[i].target_name) == 0) {
                     is_disabled = 1;
@@ -85,62 +1365,213 @@ int main(int argc, char *argv[]) {
             }
             if (!is_disabled) {
                 if (debug) printf("Adding %s to enabled_tests\n", tests[i].target_name);
-                enabled_tests[enabled_test_count] = tests[i];
-                enabled_test_count++;
+                TestCase *test = &enabled_tests[enabled_test_count++];
+                test->description = (tests[i].arg_count > 0 && tests[i].args[0]) ? tests[i].args[0] : tests[i].target_name;
+                test->target_name = tests[i].target_name;
+                test->func = (TestFunc)tests[i].target;
+                test->expected_ms = -1;
+                test->wall_ms = 0;
+                test->cpu_ms = 0;
+                test->failed = 0;
+                test->timed_out = 0;
+                test->output = NULL;
+                test->file = tests[i].file;
+                test->last_failed = 0;
+                test->ran = 0;
+                test->not_thread_safe = 0;
+                test->max_allocs = annotation_budget(max_allocs, tests[i].target_name);
+                test->max_bytes = annotation_budget(max_bytes, tests[i].target_name);
+                test->timeout_ms = annotation_budget(timeouts, tests[i].target_name);
+                if (test->timeout_ms < 0) test->timeout_ms = opts.timeout_ms;
+                for (int j = 0; j < table.count && not_thread_safe[j].name; j++) {
+                    if (strcmp(not_thread_safe[j].target_name, tests[i].target_name) == 0) {
+                        test->not_thread_safe = 1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    /* Narrow to --filter/--tag before sharding, so shards split only what was asked for */
+    if (opts.filter || opts.filter_regex || opts.tags) {
+        int kept = 0;
+        for (int i = 0; i < enabled_test_count; i++) {
+            if (selection_matches(&selection, enabled_tests[i].description, enabled_tests[i].target_name,
+                                  enabled_tests[i].func)) {
+                enabled_tests[kept++] = enabled_tests[i];
+            }
+        }
+        printf("Selected %d of %d tests\n", kept, enabled_test_count);
+        enabled_test_count = kept;
+    }
+
+    /* --changed: only tests defined in, or @Covers-linked to, a changed file */
+    ChangeSet changes = {0};
+    if (opts.changed) {
+        if (changes_load(&changes, opts.changed) != 0) {
+            fprintf(stderr, "Memory allocation failed reading --changed; running every test\n");
+            opts.changed = NULL;
+        } else {
+            int kept = 0;
+            for (int i = 0; i < enabled_test_count; i++) {
+                if (changes_affect(&changes, covers, enabled_tests[i].file, enabled_tests[i].target_name)) {
+                    enabled_tests[kept++] = enabled_tests[i];
+                }
             }
-            test_index++;
+            printf("%d changed files affect %d of %d tests\n", changes.count, kept, enabled_test_count);
+            enabled_test_count = kept;
         }
     }
 
+    int benchmark_count = 0;
+    for (int i = 0; i < table.count && benches[i].name; i++) {
+        if (strcmp(benches[i].name, "Benchmark") != 0 || benches[i].isRemoved) continue;
+        int is_disabled = 0;
+        for (int j = 0; j < table.count && disabled[j].name; j++) {
+            if (strcmp(disabled[j].target_name, benches[i].target_name) == 0) {
+                is_disabled = 1;
+                break;
+            }
+        }
+        if (is_disabled) continue;
+        if (!selection_matches(&selection, benches[i].arg_count > 0 && benches[i].args[0] ? benches[i].args[0] : benches[i].target_name,
+                               benches[i].target_name, (TestFunc)benches[i].target)) continue;
+        if (opts.changed && !changes_affect(&changes, covers, benches[i].file, benches[i].target_name)) continue;
+        /* Benchmarks have no cached durations; shards split them by name */
+        if (opts.shard_count > 1 &&
+            lucy_shard_hash(benches[i].target_name) % (uint32_t)opts.shard_count != (uint32_t)opts.shard_index) continue;
+        Benchmark *bench = &benchmarks[benchmark_count++];
+        memset(bench, 0, sizeof(*bench));
+        bench->description = (benches[i].arg_count > 0 && benches[i].args[0]) ? benches[i].args[0] : benches[i].target_name;
+        bench->target_name = benches[i].target_name;
+        bench->func = (TestFunc)benches[i].target;
+        bench->baseline_ns = -1;
+    }
+
+    changes_free(&changes);
+
     int disabled_count = 0;
-    for (int i = 0; i < __ANNOTATION_COUNT && disabled[i].name; i++) {
+    for (int i = 0; i < table.count && disabled[i].name; i++) {
         if (strcmp(disabled[i].name, "Disable") == 0) {
             disabled_count++;
         }
     }
 
+    /* Resolve fixtures now: running tests may rewrite __ANNOTATIONS (see sync_annotations) */
+    for (int j = 0; j < table.count && setups[j].name; j++) {
+        if (strcmp(setups[j].name, "Setup") == 0 && !setups[j].isRemoved) {
+            if (debug) printf("Registering setup: %s\n", setups[j].target_name);
+            setup_funcs[setup_count++] = (TestFunc)setups[j].target;
+        }
+    }
+    for (int j = 0; j < table.count && teardowns[j].name; j++) {
+        if (strcmp(teardowns[j].name, "Teardown") == 0 && !teardowns[j].isRemoved) {
+            if (debug) printf("Registering teardown: %s\n", teardowns[j].target_name);
+            teardown_funcs[teardown_count++] = (TestFunc)teardowns[j].target;
+        }
+    }
+    for (int j = 0; j < table.count && before_alls[j].name; j++) {
+        if (strcmp(before_alls[j].name, "BeforeAll") == 0 && !before_alls[j].isRemoved) {
+            if (debug) printf("Registering before-all: %s\n", before_alls[j].target_name);
+            Fixture *fixture = &before_all_fixtures[before_all_count++];
+            fixture->func = (TestFunc)before_alls[j].target;
+            fixture->file = fixture_file(&before_alls[j]);
+        }
+    }
+    for (int j = 0; j < table.count && after_alls[j].name; j++) {
+        if (strcmp(after_alls[j].name, "AfterAll") == 0 && !after_alls[j].isRemoved) {
+            if (debug) printf("Registering after-all: %s\n", after_alls[j].target_name);
+            Fixture *fixture = &after_all_fixtures[after_all_count++];
+            fixture->func = (TestFunc)after_alls[j].target;
+            fixture->file = fixture_file(&after_alls[j]);
+        }
+    }
+
     if (debug) printf("disabled_count: %d, enabled_test_count: %d\n", disabled_count, enabled_test_count);
 
-    int passed = 0;
-    int failed = 0;
+    TimingCache timings = {0};
+    if (opts.timings_path && lucy_timings_load(&timings, opts.timings_path) != 0) {
+        fprintf(stderr, "Ignoring unreadable timings cache %s\n", opts.timings_path);
+    }
     for (int i = 0; i < enabled_test_count; i++) {
-        const char *desc = (enabled_tests[i].arg_count > 0 && enabled_tests[i].args[0]) ? enabled_tests[i].args[0] : enabled_tests[i].target_name;
-        printf("Running: %s ", desc);
-        fflush(stdout);
-
-        __test_failed = 0;
-        for (int j = 0; j < __ANNOTATION_COUNT && setups[j].name; j++) {
-            if (strcmp(setups[j].name, "Setup") == 0 && !setups[j].isRemoved) {
-                if (debug) printf("Running setup: %s\n", setups[j].target_name);
-                void (*setup_func)(void) = (void (*)(void))setups[j].target;
-                setup_func();
-            }
+        enabled_tests[i].expected_ms = lucy_timings_lookup(&timings, enabled_tests[i].target_name);
+    }
+    if (opts.shard_count > 1) {
+        int total = enabled_test_count;
+        enabled_test_count = select_shard(enabled_tests, enabled_test_count, &opts);
+        printf("Shard %d/%d: running %d of %d tests (by %s)\n", opts.shard_index + 1, opts.shard_count,
+               enabled_test_count, total, opts.shard_by == SHARD_BY_HASH ? "hash" : "duration");
+    }
+    if (opts.failed_first) {
+        for (int i = 0; i < enabled_test_count; i++) {
+            enabled_tests[i].last_failed = lucy_timings_failed(&timings, enabled_tests[i].target_name);
         }
+        int rerun = order_failed_first(enabled_tests, enabled_test_count);
+        if (rerun > 0) printf("Running %d tests that failed last time first\n", rerun);
+    }
+    fail_fast = opts.fail_fast;
 
-        if (debug) printf("Running test: %s\n", desc);
-        void (*test_func)(void) = (void (*)(void))enabled_tests[i].target;
-        test_func();
-
-        for (int j = 0; j < __ANNOTATION_COUNT && teardowns[j].name; j++) {
-            if (strcmp(teardowns[j].name, "Teardown") == 0 && !teardowns[j].isRemoved) {
-                if (debug) printf("Running teardown: %s\n", teardowns[j].target_name);
-                void (*teardown_func)(void) = (void (*)(void))teardowns[j].target;
-                teardown_func();
-            }
+    /* Expensive suite setup runs once; forked tests then start from this warmed
+     * image and get pristine copy-on-write state instead of redoing the work */
+    int after_all_failed = 0;
+    ReportBuffer before_all_messages = {0};
+    if (run_fixtures(before_all_fixtures, before_all_count, NULL, "before-all", debug, &before_all_messages)) {
+        printf("✘ @BeforeAll failed; skipping %d tests\n", enabled_test_count);
+        for (int i = 0; i < enabled_test_count; i++) {
+            fail_without_running(&enabled_tests[i], "not run: @BeforeAll failed", &before_all_messages);
         }
+    } else {
+        after_all_failed = run_file_groups(enabled_tests, enabled_test_count, &opts);
+    }
+    free(before_all_messages.data);
+    int bench_failed = 0;
+    if (opts.bench && benchmark_count > 0) {
+        bench_failed = run_benchmarks(benchmarks, benchmark_count, &opts);
+    }
+    if (run_fixtures(after_all_fixtures, after_all_count, NULL, "after-all", debug, NULL)) {
+        printf("✘ @AfterAll failed\n");
+        after_all_failed = 1;
+    }
 
-        if (__test_failed) {
-            printf("✘\n");
+    int passed = 0;
+    int failed = 0;
+    int skipped = 0;
+    for (int i = 0; i < enabled_test_count; i++) {
+        if (enabled_tests[i].failed) {
             failed++;
-        } else {
-            printf("✔\n");
+        } else if (enabled_tests[i].ran) {
             passed++;
+        } else {
+            skipped++;
         }
+        /* Skipped tests keep their history, so the next --failed-first still sees them */
+        if (!enabled_tests[i].ran) continue;
+        lucy_timings_record(&timings, enabled_tests[i].target_name, enabled_tests[i].wall_ms);
+        lucy_timings_set_failed(&timings, enabled_tests[i].target_name, enabled_tests[i].failed);
+    }
+    /* Duration shards must all read the cache they were partitioned with, so
+     * none of them may rewrite it while the others could still be starting */
+    int shared_cache = opts.shard_count > 1 && opts.shard_by == SHARD_BY_DURATION;
+    if (opts.timings_path && !shared_cache) {
+        lucy_timings_save(&timings, opts.timings_path);
+    }
+    lucy_timings_free(&timings);
+
+    lucy_print_slowest(enabled_tests, enabled_test_count, opts.slowest);
+    for (int r = 0; r < report_count; r++) {
+        lucy_report_close(&reports[r], passed, failed, disabled_count, now_ms() - run_start);
+    }
+    for (int i = 0; i < enabled_test_count; i++) {
+        free(enabled_tests[i].output);
     }
 
     /* ... disabled tests output ... */
 
     printf("\nTest Summary: %d/%d passed, %d failed (%d disabled)\n", passed, enabled_test_count, failed, disabled_count);
+    if (skipped > 0) {
+        printf("✘ Stopped at the first failure; %d tests skipped (--fail-fast)\n", skipped);
+    }
     if (failed == 0 && enabled_test_count > 0) {
         printf("✔ All enabled tests passed!\n");
     } else if (enabled_test_count == 0) {
@@ -159,6 +1590,26 @@ int main(int argc, char *argv[]) {
     free(disabled);
     free(setups);
     free(teardowns);
+    free(not_thread_safe);
+    free(before_alls);
+    free(after_alls);
+    free(benches);
+    free(max_allocs);
+    free(max_bytes);
+    free(timeouts);
+    free(covers);
+    free(enabled_tests);
+    free(benchmarks);
+    free(setup_funcs);
+    free(teardown_funcs);
+    free(before_all_fixtures);
+    free(after_all_fixtures);
+    selection_free(&selection);
+    int module_failed = table.failed_modules > 0;
+    if (module_failed) {
+        printf("✘ %d modules failed to load\n", table.failed_modules);
+    }
+    lucy_table_free(&table);
     lucy_cleanup();
-    return failed > 0 ? 1 : 0;
-}
\ No newline at end of file
+    return failed > 0 || after_all_failed || bench_failed || module_failed ? 1 : 0;
+}
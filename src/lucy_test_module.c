@@ -0,0 +1,151 @@
+/* lucy_test_module.c - Merging annotation tables of dlopen'd test modules for --module
+ *
+ * A test module is a shared object built like test_runner's tests: processed
+ * test files plus the annotations.c that lucy generated for them. It therefore
+ * defines its own __ANNOTATIONS, __ANNOTATION_COUNT, __TAGS and __TAG_COUNT.
+ * The runner looks those up in each module (dlsym on the module handle finds the
+ * module's definitions, not the runner's) and appends them to one table, so
+ * modules can be built and cached independently of each other and of the runner.
+ *
+ * Modules are opened RTLD_LOCAL: their tables don't clash with each other, and
+ * their tests still resolve lucy-test symbols from the already loaded library.
+ *
+ * Dependencies:
+ * - lucy_test_runner.h: AnnotationTable and the functions defined here.
+ * - glibc: dlfcn.h (dlopen, dlsym, dladdr1, dlinfo), link.h.
+ */
+
+#define _GNU_SOURCE  // For dladdr and dlinfo
+#include <dlfcn.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/lucy_test_runner.h"
+#include "../include/lucy_api.h"    // For MAX_BUFFER_SIZE
+
+/* ELF32_ST_BIND or ELF64_ST_BIND, matching ElfW(Sym); glibc's link.h builds
+ * ElfW from _ElfW but has no ELFW for the macros */
+#ifndef ELF_ST_BIND
+#define ELF_ST_BIND _ElfW(ELF, __ELF_NATIVE_CLASS, ST_BIND)
+#endif
+
+/* Appends annotations and their tag lists, rebasing the tag indices
+ * Returns: 0 on success, 1 on allocation failure
+ */
+static int append_table(AnnotationTable *table, const struct Annotation *annotations, int count,
+                        const struct TagIndex *tags, int tag_count) {
+    struct Annotation *grown = realloc(table->annotations, (table->count + count + 1) * sizeof(struct Annotation));
+    if (!grown) return 1;
+    table->annotations = grown;
+    struct TagIndex *grown_tags = realloc(table->tags, (table->tag_count + tag_count + 1) * sizeof(struct TagIndex));
+    if (!grown_tags) return 1;
+    table->tags = grown_tags;
+
+    int base = table->count;
+    for (int t = 0; t < tag_count; t++) {
+        int *indices = malloc((tags[t].count ? tags[t].count : 1) * sizeof(int));
+        if (!indices) return 1;
+        for (int k = 0; k < tags[t].count; k++) indices[k] = base + tags[t].annotations[k];
+        table->tags[table->tag_count].tag = tags[t].tag;
+        table->tags[table->tag_count].annotations = indices;
+        table->tags[table->tag_count].count = tags[t].count;
+        table->tag_count++;
+    }
+    memcpy(table->annotations + base, annotations, count * sizeof(struct Annotation));
+    table->count += count;
+    return 0;
+}
+
+int lucy_table_init(AnnotationTable *table, const struct Annotation *annotations, int count,
+                    const struct TagIndex *tags, int tag_count) {
+    memset(table, 0, sizeof(*table));
+    if (append_table(table, annotations, count, tags, tag_count) != 0) {
+        fprintf(stderr, "Memory allocation failed in lucy_table_init\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* Returns: 1 if symbol is a strong definition in the object behind handle itself,
+ * rather than one from a library it depends on or a weak default (such as those
+ * in liblucy-test.so)
+ */
+static int defined_in(void *handle, const void *symbol) {
+    struct link_map *map = NULL;
+    Dl_info info;
+    const ElfW(Sym) *entry = NULL;
+    if (!symbol || dlinfo(handle, RTLD_DI_LINKMAP, &map) != 0 ||
+        !dladdr1(symbol, &info, (void **)&entry, RTLD_DL_SYMENT) || !entry) {
+        return 0;
+    }
+    return (uintptr_t)info.dli_fbase == (uintptr_t)map->l_addr && ELF_ST_BIND(entry->st_info) != STB_WEAK;
+}
+
+int lucy_table_load_module(AnnotationTable *table, const char *path) {
+    if (table->module_count == MAX_MODULES) {
+        fprintf(stderr, "✘ Module %s: at most %d modules are supported\n", path, MAX_MODULES);
+        table->failed_modules++;
+        return 1;
+    }
+
+    /* A bare file name would make dlopen search the library path instead */
+    char local[MAX_BUFFER_SIZE];
+    if (!strchr(path, '/')) {
+        snprintf(local, sizeof(local), "./%s", path);
+        path = local;
+    }
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        fprintf(stderr, "✘ Cannot load module %s: %s\n", path, dlerror());
+        table->failed_modules++;
+        return 1;
+    }
+
+    const int *count = dlsym(handle, "__ANNOTATION_COUNT");
+    const struct Annotation *annotations = dlsym(handle, "__ANNOTATIONS");
+    if (!defined_in(handle, count) || !defined_in(handle, annotations)) {
+        fprintf(stderr, "✘ Module %s has no annotation table; link in the annotations.c lucy generated for it\n", path);
+        dlclose(handle);
+        table->failed_modules++;
+        return 1;
+    }
+    /* Modules without any @Tag still get __TAGS from a current lucy */
+    const int *tag_count = dlsym(handle, "__TAG_COUNT");
+    const struct TagIndex *tags = dlsym(handle, "__TAGS");
+    int has_tags = defined_in(handle, tag_count) && defined_in(handle, tags);
+
+    if (append_table(table, annotations, *count, has_tags ? tags : NULL, has_tags ? *tag_count : 0) != 0) {
+        fprintf(stderr, "Memory allocation failed loading module %s\n", path);
+        dlclose(handle);
+        table->failed_modules++;
+        return 1;
+    }
+    table->modules[table->module_count++] = handle;
+    return 0;
+}
+
+struct Annotation *lucy_table_find(const AnnotationTable *table, const char *name) {
+    struct Annotation *matches = calloc(table->count + 1, sizeof(struct Annotation));
+    if (!matches) {
+        fprintf(stderr, "Memory allocation failed in lucy_table_find\n");
+        return NULL;
+    }
+    int count = 0;
+    for (int i = 0; i < table->count; i++) {
+        if (table->annotations[i].name && strcmp(table->annotations[i].name, name) == 0) {
+            matches[count++] = table->annotations[i];
+        }
+    }
+    return matches;
+}
+
+void lucy_table_free(AnnotationTable *table) {
+    for (int t = 0; t < table->tag_count; t++) free((void *)table->tags[t].annotations);
+    free(table->tags);
+    free(table->annotations);
+    table->tags = NULL;
+    table->annotations = NULL;
+    table->count = 0;
+    table->tag_count = 0;
+}
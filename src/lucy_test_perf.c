@@ -0,0 +1,137 @@
+/* lucy_test_perf.c - Hardware performance counters for --perf
+ *
+ * Each thread that runs tests opens its own set of counters with
+ * perf_event_open (pid 0, any CPU, user space only), so counts never mix
+ * between concurrently running tests. The counters are opened independently
+ * rather than as one group: a group that does not fit the PMU is never
+ * scheduled, while independent counters are multiplexed by the kernel and
+ * scaled back up here using time_enabled / time_running.
+ *
+ * Kernels or VMs without a PMU (or with a restrictive perf_event_paranoid)
+ * refuse some or all events; those slots simply read as -1.
+ *
+ * Dependencies:
+ * - lucy_test_runner.h: PerfCounters, PerfCounts and the functions defined here.
+ * - Linux: linux/perf_event.h, sys/syscall.h, sys/ioctl.h.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "../include/lucy_test_runner.h"
+
+/* Names used in reports, indexed by PerfEvent */
+static const char *event_names[PERF_EVENT_COUNT] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+};
+
+/* One read with PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING */
+typedef struct {
+    uint64_t value;
+    uint64_t time_enabled;
+    uint64_t time_running;
+} CounterRead;
+
+static void event_attr(int event, struct perf_event_attr *attr) {
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->disabled = 1;
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (event) {
+        case PERF_CYCLES:
+            attr->type = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            attr->type = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_L1D_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_L1D |
+                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PERF_LLC_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_LL |
+                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PERF_BRANCH_MISSES:
+            attr->type = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+    }
+}
+
+static int read_counter(int fd, CounterRead *out) {
+    return read(fd, out, sizeof(*out)) == (ssize_t)sizeof(*out) ? 0 : 1;
+}
+
+const char *lucy_perf_event_name(int event) {
+    return event >= 0 && event < PERF_EVENT_COUNT ? event_names[event] : "unknown";
+}
+
+int lucy_perf_open(PerfCounters *perf) {
+    int opened = 0;
+    perf->error = 0;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        struct perf_event_attr attr;
+        event_attr(e, &attr);
+        perf->fds[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if (perf->fds[e] < 0) {
+            if (!perf->error) perf->error = errno;
+            continue;
+        }
+        opened++;
+    }
+    return opened;
+}
+
+void lucy_perf_start(PerfCounters *perf) {
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        if (perf->fds[e] < 0) continue;
+        CounterRead start = {0};
+        read_counter(perf->fds[e], &start);
+        perf->start[e][0] = start.value;
+        perf->start[e][1] = start.time_enabled;
+        perf->start[e][2] = start.time_running;
+        ioctl(perf->fds[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void lucy_perf_stop(PerfCounters *perf, PerfCounts *counts) {
+    /* Disable everything first so reading one counter isn't charged to the next */
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        if (perf->fds[e] >= 0) ioctl(perf->fds[e], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    counts->valid = 0;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        CounterRead end;
+        counts->values[e] = -1;
+        if (perf->fds[e] < 0 || read_counter(perf->fds[e], &end) != 0) continue;
+
+        double value = (double)(end.value - perf->start[e][0]);
+        uint64_t enabled = end.time_enabled - perf->start[e][1];
+        uint64_t running = end.time_running - perf->start[e][2];
+        if (running == 0) continue;  // Never scheduled on the PMU
+        if (running < enabled) value *= (double)enabled / running;
+        counts->values[e] = value;
+        counts->valid = 1;
+    }
+}
+
+void lucy_perf_close(PerfCounters *perf) {
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        if (perf->fds[e] >= 0) close(perf->fds[e]);
+        perf->fds[e] = -1;
+    }
+}
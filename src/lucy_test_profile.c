@@ -0,0 +1,195 @@
+/* lucy_test_profile.c - Sampling profiler behind --profile
+ *
+ * While a test body runs, a per-thread CPU-time timer (timer_create on
+ * CLOCK_THREAD_CPUTIME_ID, delivered to that thread only) raises SIGPROF at a
+ * fixed interval. The handler unwinds the interrupted stack with backtrace()
+ * into a preallocated buffer; nothing is allocated or symbolized in signal
+ * context. After the test the samples are symbolized with dladdr and written
+ * in the folded-stack format ("root;caller;callee count") read by flame graph
+ * tools such as flamegraph.pl, inferno and speedscope.
+ *
+ * Link test executables with -rdynamic so their functions resolve by name;
+ * anything else is written as module+0xoffset.
+ *
+ * Dependencies:
+ * - lucy_test_runner.h: Profiler and the functions defined here.
+ * - POSIX/glibc: signal.h, time.h (timer_create), execinfo.h, dlfcn.h.
+ */
+
+#define _GNU_SOURCE  // For dladdr and SIGEV_THREAD_ID
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "../include/lucy_test_runner.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid  // glibc < 2.35 lacks the alias
+#endif
+
+/* Frames belonging to the handler and the kernel's signal trampoline */
+#define SIGNAL_FRAMES 2
+
+/* Profiler that the SIGPROF handler of this thread writes to */
+static __thread Profiler *active_profiler = NULL;
+
+static void on_sigprof(int sig, siginfo_t *info, void *context) {
+    (void)sig;
+    (void)info;
+    (void)context;
+    int saved_errno = errno;
+    Profiler *profiler = active_profiler;
+    if (profiler) {
+        if (profiler->count < MAX_PROFILE_SAMPLES) {
+            void **frames = profiler->frames + (size_t)profiler->count * MAX_PROFILE_DEPTH;
+            profiler->depths[profiler->count] = backtrace(frames, MAX_PROFILE_DEPTH);
+            profiler->count++;
+        } else {
+            profiler->dropped++;
+        }
+    }
+    errno = saved_errno;
+}
+
+int lucy_profile_init(Profiler *profiler, long interval_us) {
+    memset(profiler, 0, sizeof(*profiler));
+    profiler->interval_us = interval_us;
+    profiler->frames = malloc((size_t)MAX_PROFILE_SAMPLES * MAX_PROFILE_DEPTH * sizeof(void *));
+    profiler->depths = malloc(MAX_PROFILE_SAMPLES * sizeof(int));
+    if (!profiler->frames || !profiler->depths) {
+        fprintf(stderr, "Memory allocation failed in lucy_profile_init\n");
+        lucy_profile_free(profiler);
+        return 1;
+    }
+
+    /* The first backtrace() loads the unwinder, which isn't safe in a handler */
+    backtrace(profiler->frames, 1);
+    active_profiler = NULL;  // Also allocates this thread's TLS block outside the handler
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = on_sigprof;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, NULL) != 0) {
+        perror("sigaction(SIGPROF)");
+        lucy_profile_free(profiler);
+        return 1;
+    }
+
+    struct sigevent event;
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = (pid_t)syscall(SYS_gettid);
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &profiler->timer) != 0) {
+        perror("timer_create");
+        lucy_profile_free(profiler);
+        return 1;
+    }
+    profiler->has_timer = 1;
+    return 0;
+}
+
+void lucy_profile_start(Profiler *profiler) {
+    profiler->count = 0;
+    profiler->dropped = 0;
+    active_profiler = profiler;
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = profiler->interval_us / 1000000;
+    spec.it_interval.tv_nsec = (profiler->interval_us % 1000000) * 1000;
+    spec.it_value = spec.it_interval;
+    timer_settime(profiler->timer, 0, &spec, NULL);
+}
+
+void lucy_profile_stop(Profiler *profiler) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    timer_settime(profiler->timer, 0, &spec, NULL);
+    active_profiler = NULL;
+}
+
+/* Appends the name of one frame: the symbol if exported, else module+0xoffset */
+static void append_frame(char *stack, size_t size, void *address) {
+    size_t len = strlen(stack);
+    if (len + 1 >= size) return;
+    Dl_info info;
+    if (!dladdr(address, &info)) {
+        snprintf(stack + len, size - len, "%p", address);  // info is left unset
+    } else if (info.dli_sname) {
+        snprintf(stack + len, size - len, "%s", info.dli_sname);
+    } else if (info.dli_fname) {
+        const char *module = strrchr(info.dli_fname, '/');
+        module = module ? module + 1 : info.dli_fname;
+        snprintf(stack + len, size - len, "%s+0x%lx", module,
+                 (unsigned long)((char *)address - (char *)info.dli_fbase));
+    } else {
+        snprintf(stack + len, size - len, "%p", address);
+    }
+}
+
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+int lucy_profile_write_folded(const Profiler *profiler, const char *path) {
+    if (profiler->count == 0) return 0;
+
+    char **stacks = calloc(profiler->count, sizeof(char *));
+    if (!stacks) {
+        fprintf(stderr, "Memory allocation failed in lucy_profile_write_folded\n");
+        return 1;
+    }
+
+    /* Render each sample root-first, dropping the signal frames on top */
+    int rendered = 0;
+    for (int i = 0; i < profiler->count; i++) {
+        char stack[MAX_PROFILE_STACK_LENGTH] = {0};
+        void **frames = profiler->frames + (size_t)i * MAX_PROFILE_DEPTH;
+        for (int f = profiler->depths[i] - 1; f >= SIGNAL_FRAMES; f--) {
+            append_frame(stack, sizeof(stack), frames[f]);
+            if (f > SIGNAL_FRAMES) strncat(stack, ";", sizeof(stack) - strlen(stack) - 1);
+        }
+        if (!stack[0]) continue;
+        stacks[rendered] = strdup(stack);
+        if (stacks[rendered]) rendered++;
+    }
+
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        perror("Error opening profile");
+        for (int i = 0; i < rendered; i++) free(stacks[i]);
+        free(stacks);
+        return 1;
+    }
+
+    /* Identical stacks are adjacent once sorted; emit one line per run */
+    qsort(stacks, rendered, sizeof(char *), compare_strings);
+    for (int i = 0; i < rendered;) {
+        int j = i;
+        while (j < rendered && strcmp(stacks[i], stacks[j]) == 0) j++;
+        fprintf(out, "%s %d\n", stacks[i], j - i);
+        i = j;
+    }
+    fclose(out);
+
+    for (int i = 0; i < rendered; i++) free(stacks[i]);
+    free(stacks);
+    return 0;
+}
+
+void lucy_profile_free(Profiler *profiler) {
+    if (profiler->has_timer) timer_delete(profiler->timer);
+    profiler->has_timer = 0;
+    free(profiler->frames);
+    free(profiler->depths);
+    profiler->frames = NULL;
+    profiler->depths = NULL;
+}
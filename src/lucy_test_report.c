@@ -0,0 +1,267 @@
+/* lucy_test_report.c - Machine-readable test reports and the slowest-tests table
+ *
+ * Reports are streamed: every test is written and flushed as soon as it
+ * completes, so CI can tail the file and a crashed runner still leaves the
+ * results of everything that finished. The format follows the file extension:
+ * ".xml" produces JUnit XML, anything else produces JSON Lines.
+ *
+ * Dependencies:
+ * - lucy_test_runner.h: TestCase, Report and the functions defined here.
+ * - Standard C libraries: stdio.h, stdlib.h, string.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/lucy_test_runner.h"
+
+static int has_suffix(const char *text, const char *suffix) {
+    size_t text_len = strlen(text);
+    size_t suffix_len = strlen(suffix);
+    return text_len >= suffix_len && strcmp(text + text_len - suffix_len, suffix) == 0;
+}
+
+static void write_json_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)(text ? text : ""); *c; c++) {
+        switch (*c) {
+            case '"': fputs("\\\"", out); break;
+            case '\\': fputs("\\\\", out); break;
+            case '\n': fputs("\\n", out); break;
+            case '\r': fputs("\\r", out); break;
+            case '\t': fputs("\\t", out); break;
+            default:
+                if (*c < 0x20) fprintf(out, "\\u%04x", *c);
+                else fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_xml_text(FILE *out, const char *text) {
+    for (const unsigned char *c = (const unsigned char *)(text ? text : ""); *c; c++) {
+        switch (*c) {
+            case '&': fputs("&amp;", out); break;
+            case '<': fputs("&lt;", out); break;
+            case '>': fputs("&gt;", out); break;
+            case '"': fputs("&quot;", out); break;
+            default:
+                /* XML 1.0 forbids most control characters, even escaped */
+                if (*c < 0x20 && *c != '\n' && *c != '\t' && *c != '\r') fputc('?', out);
+                else fputc(*c, out);
+        }
+    }
+}
+
+/* Writes ,"perf":{...} with null for unavailable counters; nothing without counters */
+static void write_json_perf(FILE *out, const PerfCounts *perf) {
+    if (!perf->valid) return;
+    fprintf(out, ",\"perf\":{");
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        fprintf(out, "%s\"%s\":", e ? "," : "", lucy_perf_event_name(e));
+        if (perf->values[e] < 0) fprintf(out, "null");
+        else fprintf(out, "%.3f", perf->values[e]);
+    }
+    fputc('}', out);
+}
+
+/* Writes one JUnit property per available counter */
+static void write_xml_perf(FILE *out, const PerfCounts *perf) {
+    if (!perf->valid) return;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        if (perf->values[e] < 0) continue;
+        fprintf(out, "<property name=\"%s\" value=\"%.3f\"/>", lucy_perf_event_name(e), perf->values[e]);
+    }
+}
+
+int lucy_report_open(Report *report, const char *path) {
+    report->path = path;
+    report->format = has_suffix(path, ".xml") ? REPORT_JUNIT : REPORT_JSONL;
+    report->out = fopen(path, "w");
+    if (!report->out) {
+        perror("Error opening report");
+        return 1;
+    }
+
+    if (report->format == REPORT_JUNIT) {
+        /* Totals aren't known yet; JUnit consumers count the testcase elements */
+        fprintf(report->out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+        fprintf(report->out, "<testsuites>\n<testsuite name=\"lucy-test\">\n");
+        fflush(report->out);
+    }
+    return 0;
+}
+
+void lucy_report_test(Report *report, const TestCase *test) {
+    if (!report->out) return;
+    FILE *out = report->out;
+
+    if (report->format == REPORT_JUNIT) {
+        fprintf(out, "  <testcase classname=\"lucy-test\" name=\"");
+        write_xml_text(out, test->description);
+        fprintf(out, "\" time=\"%.6f\">\n", test->wall_ms / 1000.0);
+        fprintf(out, "    <properties><property name=\"target_name\" value=\"");
+        write_xml_text(out, test->target_name);
+        fprintf(out, "\"/><property name=\"cpu_ms\" value=\"%.3f\"/>", test->cpu_ms);
+        fprintf(out, "<property name=\"allocs\" value=\"%ld\"/><property name=\"alloc_bytes\" value=\"%ld\"/>"
+                     "<property name=\"peak_bytes\" value=\"%ld\"/>",
+                test->allocs.allocs, test->allocs.bytes, test->allocs.peak_bytes);
+        write_xml_perf(out, &test->perf);
+        fprintf(out, "</properties>\n");
+        if (test->timed_out) {
+            fprintf(out, "    <failure message=\"timed out after %ld ms\" type=\"timeout\">", test->timeout_ms);
+            write_xml_text(out, test->output);
+            fprintf(out, "</failure>\n");
+        } else if (test->failed) {
+            fprintf(out, "    <failure message=\"test failed\">");
+            write_xml_text(out, test->output);
+            fprintf(out, "</failure>\n");
+        }
+        fprintf(out, "  </testcase>\n");
+    } else {
+        fprintf(out, "{\"type\":\"test\",\"name\":");
+        write_json_string(out, test->target_name);
+        fprintf(out, ",\"description\":");
+        write_json_string(out, test->description);
+        fprintf(out, ",\"status\":\"%s\",\"wall_ms\":%.3f,\"cpu_ms\":%.3f,"
+                     "\"allocs\":%ld,\"alloc_bytes\":%ld,\"peak_bytes\":%ld,\"output\":",
+                test->timed_out ? "timed_out" : test->failed ? "failed" : "passed", test->wall_ms, test->cpu_ms,
+                test->allocs.allocs, test->allocs.bytes, test->allocs.peak_bytes);
+        write_json_string(out, test->output);
+        write_json_perf(out, &test->perf);
+        fprintf(out, "}\n");
+    }
+    fflush(out);
+}
+
+void lucy_report_benchmark(Report *report, const Benchmark *bench) {
+    if (!report->out) return;
+    FILE *out = report->out;
+    const char *status = bench->failed ? "failed" : bench->regressed ? "regressed" : "passed";
+
+    if (report->format == REPORT_JUNIT) {
+        fprintf(out, "  <testcase classname=\"lucy-bench\" name=\"");
+        write_xml_text(out, bench->description);
+        fprintf(out, "\" time=\"%.6f\">\n", bench->median_ns * bench->iterations * bench->samples / 1e9);
+        fprintf(out, "    <properties><property name=\"target_name\" value=\"");
+        write_xml_text(out, bench->target_name);
+        fprintf(out, "\"/><property name=\"median_ns\" value=\"%.3f\"/>"
+                     "<property name=\"mad_ns\" value=\"%.3f\"/><property name=\"p99_ns\" value=\"%.3f\"/>"
+                     "<property name=\"baseline_ns\" value=\"%.3f\"/>",
+                bench->median_ns, bench->mad_ns, bench->p99_ns, bench->baseline_ns);
+        write_xml_perf(out, &bench->perf);
+        fprintf(out, "</properties>\n");
+        if (bench->failed || bench->regressed) {
+            fprintf(out, "    <failure message=\"%s\"/>\n", status);
+        }
+        fprintf(out, "  </testcase>\n");
+    } else {
+        fprintf(out, "{\"type\":\"benchmark\",\"name\":");
+        write_json_string(out, bench->target_name);
+        fprintf(out, ",\"description\":");
+        write_json_string(out, bench->description);
+        fprintf(out, ",\"status\":\"%s\",\"iterations\":%ld,\"samples\":%d,\"median_ns\":%.3f,"
+                     "\"mad_ns\":%.3f,\"p99_ns\":%.3f,\"baseline_ns\":%.3f",
+                status, bench->iterations, bench->samples, bench->median_ns,
+                bench->mad_ns, bench->p99_ns, bench->baseline_ns);
+        write_json_perf(out, &bench->perf);
+        fprintf(out, "}\n");
+    }
+    fflush(out);
+}
+
+void lucy_report_close(Report *report, int passed, int failed, int disabled, double wall_ms) {
+    if (!report->out) return;
+
+    if (report->format == REPORT_JUNIT) {
+        fprintf(report->out, "</testsuite>\n</testsuites>\n");
+    } else {
+        fprintf(report->out, "{\"type\":\"summary\",\"passed\":%d,\"failed\":%d,\"disabled\":%d,\"wall_ms\":%.3f}\n",
+                passed, failed, disabled, wall_ms);
+    }
+    fclose(report->out);
+    report->out = NULL;
+}
+
+/* Reads the number following "key": in a JSON line, or 0 if absent */
+static double json_number(const char *line, const char *key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *found = strstr(line, pattern);
+    return found ? atof(found + strlen(pattern)) : 0;
+}
+
+int lucy_report_merge(const char *out_path, const char *const *inputs, int count, ReportTotals *totals) {
+    memset(totals, 0, sizeof(*totals));
+    FILE *out = fopen(out_path, "w");
+    if (!out) {
+        perror("Error opening merged report");
+        return 1;
+    }
+
+    int status = 0;
+    char *line = NULL;
+    size_t capacity = 0;
+    for (int i = 0; i < count; i++) {
+        FILE *in = fopen(inputs[i], "r");
+        if (!in) {
+            fprintf(stderr, "Error opening report %s\n", inputs[i]);
+            status = 1;
+            continue;
+        }
+        totals->reports++;
+
+        int has_summary = 0;
+        while (getline(&line, &capacity, in) > 0) {
+            if (strstr(line, "\"type\":\"summary\"")) {
+                has_summary = 1;
+                totals->passed += (int)json_number(line, "passed");
+                totals->failed += (int)json_number(line, "failed");
+                int disabled = (int)json_number(line, "disabled");
+                if (disabled > totals->disabled) totals->disabled = disabled;
+                double wall_ms = json_number(line, "wall_ms");
+                if (wall_ms > totals->wall_ms) totals->wall_ms = wall_ms;
+            } else {
+                fputs(line, out);
+                if (line[strlen(line) - 1] != '\n') fputc('\n', out);
+            }
+        }
+        if (!has_summary) totals->incomplete++;
+        fclose(in);
+    }
+    free(line);
+
+    fprintf(out, "{\"type\":\"summary\",\"passed\":%d,\"failed\":%d,\"disabled\":%d,\"wall_ms\":%.3f,"
+                 "\"reports\":%d,\"incomplete\":%d}\n",
+            totals->passed, totals->failed, totals->disabled, totals->wall_ms,
+            totals->reports, totals->incomplete);
+    fclose(out);
+    return status;
+}
+
+void lucy_print_slowest(const TestCase *tests, int count, int limit) {
+    if (limit <= 0 || count == 0) return;
+    if (limit > count) limit = count;
+
+    /* Partial selection sort: only the top `limit` entries are ever needed */
+    int *order = malloc(count * sizeof(int));
+    if (!order) return;
+    for (int i = 0; i < count; i++) order[i] = i;
+    for (int i = 0; i < limit; i++) {
+        int slowest = i;
+        for (int j = i + 1; j < count; j++) {
+            if (tests[order[j]].wall_ms > tests[order[slowest]].wall_ms) slowest = j;
+        }
+        int swap = order[i];
+        order[i] = order[slowest];
+        order[slowest] = swap;
+    }
+
+    printf("\nSlowest %d tests:\n", limit);
+    printf("  %10s  %10s  %s\n", "wall ms", "cpu ms", "test");
+    for (int i = 0; i < limit; i++) {
+        const TestCase *test = &tests[order[i]];
+        printf("  %10.3f  %10.3f  %s\n", test->wall_ms, test->cpu_ms, test->description);
+    }
+    free(order);
+}
@@ -0,0 +1,62 @@
+/* lucy_test_shard.c - Deterministic partitioning of tests for --shard=i/n
+ *
+ * Every shard computes the full assignment from the same inputs and keeps
+ * only its own tests, so shards never need to talk to each other:
+ * - SHARD_BY_HASH: FNV-1a of target_name modulo n. A test stays on its
+ *   shard when other tests are added or removed.
+ * - SHARD_BY_DURATION: longest-first greedy packing using the timings cache,
+ *   which balances wall time. All shards must see the same cache file.
+ *
+ * Dependencies:
+ * - lucy_test_runner.h: TestCase, ShardStrategy and the functions defined here.
+ * - Standard C libraries: stdlib.h.
+ */
+
+#include <stdlib.h>
+#include "../include/lucy_test_runner.h"
+
+/* Assumed duration of a test without history when packing by duration */
+#define UNKNOWN_TEST_MS 1.0
+
+uint32_t lucy_shard_hash(const char *text) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int lucy_shard_assign(const TestCase *tests, int count, int shard_count,
+                      ShardStrategy strategy, int *shard_of) {
+    if (strategy == SHARD_BY_HASH) {
+        for (int i = 0; i < count; i++) {
+            shard_of[i] = (int)(lucy_shard_hash(tests[i].target_name) % (uint32_t)shard_count);
+        }
+        return 0;
+    }
+
+    int *order = malloc(count * sizeof(int));
+    double *load = calloc(shard_count, sizeof(double));
+    if (!order || !load) {
+        free(order);
+        free(load);
+        return 1;
+    }
+
+    /* Longest first, then each test onto the least loaded shard (lowest index on ties) */
+    lucy_schedule_longest_first(tests, count, order);
+    for (int i = 0; i < count; i++) {
+        const TestCase *test = &tests[order[i]];
+        int target = 0;
+        for (int s = 1; s < shard_count; s++) {
+            if (load[s] < load[target]) target = s;
+        }
+        shard_of[order[i]] = target;
+        load[target] += test->expected_ms >= 0 ? test->expected_ms : UNKNOWN_TEST_MS;
+    }
+
+    free(order);
+    free(load);
+    return 0;
+}
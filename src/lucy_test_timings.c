@@ -0,0 +1,169 @@
+/* lucy_test_timings.c - Per-test wall time cache and duration-aware scheduling
+ *
+ * The runner records how long every test took and stores it in a small text
+ * cache keyed by target_name. Parallel runs read it back to start the slowest
+ * tests first, so no long test is left running alone at the end of the suite.
+ * The cache also remembers which tests failed last time (a third "1" column),
+ * for --failed-first. Benchmark baselines use the same format, storing median
+ * ns/op instead.
+ *
+ * Dependencies:
+ * - lucy_test_runner.h: TestCase, TimingCache and the functions defined here.
+ * - Standard C libraries: stdio.h, stdlib.h, string.h; unistd.h for getpid.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/lucy_test_runner.h"
+#include "../include/lucy_api.h"    // For MAX_LINE_LENGTH, MAX_BUFFER_SIZE
+
+int lucy_timings_load(TimingCache *cache, const char *path) {
+    cache->entries = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
+
+    FILE *in = fopen(path, "r");
+    if (!in) return 0;  // No history yet
+
+    char line[MAX_LINE_LENGTH];
+    char name[MAX_BUFFER_SIZE];
+    double value;
+    int failed;
+    while (fgets(line, sizeof(line), in)) {
+        int fields = sscanf(line, "%1023s %lf %d", name, &value, &failed);
+        if (fields < 2) continue;
+        if (lucy_timings_record(cache, name, value) != 0 ||
+            (fields == 3 && lucy_timings_set_failed(cache, name, failed) != 0)) {
+            fclose(in);
+            return 1;
+        }
+    }
+    fclose(in);
+    return 0;
+}
+
+double lucy_timings_lookup(const TimingCache *cache, const char *target_name) {
+    for (int i = 0; i < cache->count; i++) {
+        if (strcmp(cache->entries[i].target_name, target_name) == 0) {
+            return cache->entries[i].value;
+        }
+    }
+    return -1;
+}
+
+/* Finds the entry of target_name, appending a new one (value -1) if there is none
+ * Returns: the entry, or NULL on allocation failure
+ */
+static TimingEntry *find_or_add(TimingCache *cache, const char *target_name) {
+    for (int i = 0; i < cache->count; i++) {
+        if (strcmp(cache->entries[i].target_name, target_name) == 0) {
+            return &cache->entries[i];
+        }
+    }
+
+    if (cache->count == cache->capacity) {
+        int capacity = cache->capacity ? cache->capacity * 2 : 64;
+        TimingEntry *entries = realloc(cache->entries, capacity * sizeof(TimingEntry));
+        if (!entries) {
+            fprintf(stderr, "Memory allocation failed in lucy_timings_record\n");
+            return NULL;
+        }
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+
+    char *name = strdup(target_name);
+    if (!name) {
+        fprintf(stderr, "Memory allocation failed in lucy_timings_record\n");
+        return NULL;
+    }
+    TimingEntry *entry = &cache->entries[cache->count++];
+    entry->target_name = name;
+    entry->value = -1;
+    entry->failed = 0;
+    return entry;
+}
+
+int lucy_timings_record(TimingCache *cache, const char *target_name, double value) {
+    TimingEntry *entry = find_or_add(cache, target_name);
+    if (!entry) return 1;
+    entry->value = value;
+    return 0;
+}
+
+int lucy_timings_set_failed(TimingCache *cache, const char *target_name, int failed) {
+    TimingEntry *entry = find_or_add(cache, target_name);
+    if (!entry) return 1;
+    entry->failed = failed;
+    return 0;
+}
+
+int lucy_timings_failed(const TimingCache *cache, const char *target_name) {
+    for (int i = 0; i < cache->count; i++) {
+        if (strcmp(cache->entries[i].target_name, target_name) == 0) {
+            return cache->entries[i].failed;
+        }
+    }
+    return 0;
+}
+
+int lucy_timings_save(const TimingCache *cache, const char *path) {
+    /* Write a private file and rename it over the cache, so shards or runners
+     * saving at the same time never leave a half-written cache behind */
+    char temp_path[MAX_BUFFER_SIZE];
+    snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path, (long)getpid());
+    FILE *out = fopen(temp_path, "w");
+    if (!out) {
+        perror("Error opening timings cache");
+        return 1;
+    }
+    for (int i = 0; i < cache->count; i++) {
+        const TimingEntry *entry = &cache->entries[i];
+        if (entry->failed) {
+            fprintf(out, "%s %.3f 1\n", entry->target_name, entry->value);
+        } else {
+            fprintf(out, "%s %.3f\n", entry->target_name, entry->value);
+        }
+    }
+    if (fclose(out) != 0 || rename(temp_path, path) != 0) {
+        perror("Error writing timings cache");
+        remove(temp_path);
+        return 1;
+    }
+    return 0;
+}
+
+void lucy_timings_free(TimingCache *cache) {
+    for (int i = 0; i < cache->count; i++) {
+        free(cache->entries[i].target_name);
+    }
+    free(cache->entries);
+    cache->entries = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
+}
+
+void lucy_schedule_longest_first(const TestCase *tests, int count, int *order) {
+    for (int i = 0; i < count; i++) order[i] = i;
+
+    /* Stable insertion sort; suites are small enough that O(n^2) never shows up */
+    for (int i = 1; i < count; i++) {
+        int current = order[i];
+        double key = tests[current].expected_ms;
+        int key_failed = tests[current].last_failed;
+        int j = i - 1;
+        while (j >= 0) {
+            double other = tests[order[j]].expected_ms;
+            int other_failed = tests[order[j]].last_failed;
+            /* --failed-first tests lead; then unknown (-1) before everything; otherwise longer first */
+            int before = key_failed != other_failed ? key_failed :
+                         (key < 0 && other >= 0) || (key >= 0 && other >= 0 && key > other);
+            if (!before) break;
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = current;
+    }
+}
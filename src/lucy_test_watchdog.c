@@ -0,0 +1,127 @@
+/* lucy_test_watchdog.c - Per-thread watchdog for @Timeout in the runner process
+ *
+ * Each thread that runs tests owns a CLOCK_MONOTONIC timer whose SIGALRM is
+ * delivered to that thread only. The test function is called from
+ * lucy_watchdog_run after a sigsetjmp; if the timer fires first, the handler
+ * siglongjmps back out of the test. Whatever the test held at that moment
+ * (heap blocks, open files, locks) is abandoned, which is why forked runs
+ * kill the child instead and are the safer choice for suites that time out.
+ * The one thing never jumped past is the allocator: a test stopped inside
+ * malloc would leave its lock held for every later test, so the handler
+ * reports the timeout and exits the whole process instead.
+ *
+ * Runs nest. Each watchdog remembers the one that was active when its run
+ * began, and the timer's sigev_value names the watchdog that fired, so an
+ * outer limit stays in force while an inner run is in progress.
+ *
+ * Dependencies:
+ * - lucy_test_runner.h: Watchdog and the functions defined here.
+ * - lucy_test_alloc.c: lucy_alloc_busy.
+ * - POSIX: signal.h, setjmp.h, time.h (timer_create).
+ */
+
+#define _GNU_SOURCE  // For SIGEV_THREAD_ID
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "../include/lucy_test_runner.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid  // glibc < 2.35 lacks the alias
+#endif
+
+/* Innermost watchdog whose run is in progress on this thread, or NULL between
+ * runs. initial-exec keeps the access from the handler free of calls.
+ */
+static __thread Watchdog *active_watchdog __attribute__((tls_model("initial-exec"))) = NULL;
+
+static void arm(Watchdog *watchdog, long timeout_ms) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = timeout_ms / 1000;
+    spec.it_value.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    timer_settime(watchdog->timer, 0, &spec, NULL);
+}
+
+static void on_sigalrm(int sig, siginfo_t *info, void *context) {
+    (void)sig;
+    (void)context;
+    Watchdog *fired = info->si_value.sival_ptr;
+    Watchdog *watchdog = active_watchdog;
+    while (watchdog && watchdog != fired) watchdog = watchdog->previous;
+    if (!watchdog) return;  // Expiry of a run that has already ended
+
+    fired->timed_out = 1;
+    if (lucy_alloc_busy()) {
+        ssize_t written = write(STDERR_FILENO, fired->exit_message, strlen(fired->exit_message));
+        (void)written;
+        _exit(1);
+    }
+
+    /* Runs nested inside the one that fired end with it */
+    for (watchdog = active_watchdog; watchdog != fired; watchdog = watchdog->previous) {
+        arm(watchdog, 0);
+    }
+    active_watchdog = fired->previous;
+    siglongjmp(fired->jump, 1);
+}
+
+int lucy_watchdog_init(Watchdog *watchdog) {
+    memset(watchdog, 0, sizeof(*watchdog));
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = on_sigalrm;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGALRM, &action, NULL) != 0) {
+        perror("sigaction(SIGALRM)");
+        return 1;
+    }
+
+    struct sigevent event;
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGALRM;
+    event.sigev_value.sival_ptr = watchdog;
+    event.sigev_notify_thread_id = (pid_t)syscall(SYS_gettid);
+    if (timer_create(CLOCK_MONOTONIC, &event, &watchdog->timer) != 0) {
+        perror("timer_create");
+        return 1;
+    }
+    watchdog->has_timer = 1;
+    return 0;
+}
+
+int lucy_watchdog_run(Watchdog *watchdog, TestFunc func, long timeout_ms) {
+    if (!watchdog->has_timer || timeout_ms <= 0) {
+        func();
+        return 0;
+    }
+
+    snprintf(watchdog->exit_message, sizeof(watchdog->exit_message),
+             "FAIL: %s timed out after %ld ms inside the allocator; stopping the run (--fork contains timeouts)\n",
+             watchdog->name ? watchdog->name : "test", timeout_ms);
+    watchdog->previous = active_watchdog;
+    watchdog->timed_out = 0;
+
+    /* Saving the signal mask makes the jump also unblock SIGALRM again */
+    if (sigsetjmp(watchdog->jump, 1) != 0) {
+        return 1;  // The handler has already restored active_watchdog
+    }
+    active_watchdog = watchdog;
+    arm(watchdog, timeout_ms);
+    func();
+    arm(watchdog, 0);
+    active_watchdog = watchdog->previous;
+    return 0;
+}
+
+void lucy_watchdog_free(Watchdog *watchdog) {
+    if (watchdog->has_timer) timer_delete(watchdog->timer);
+    watchdog->has_timer = 0;
+}
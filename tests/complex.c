@@ -2,6 +2,29 @@
 #include "../include/lucy_test.h"
 #include <string.h>
 
+// File fixture state, built once for the tests in this file only
+static int file_fixture_runs = 0;
+static char *file_fixture = NULL;
+
+// @BeforeAll("file")
+void complex_before_all() {
+    file_fixture_runs++;
+    file_fixture = strdup("complex fixture");
+    assertFalse(getenv("LUCY_FAIL_FILE_BEFORE_ALL") != NULL, "file before-all failed on purpose");
+}
+
+// @AfterAll("file")
+void complex_after_all() {
+    free(file_fixture);
+    file_fixture = NULL;
+}
+
+// @Test("File BeforeAll runs once before the tests of its file")
+void test_file_before_all() {
+    assertEquals(1, file_fixture_runs, "File BeforeAll should have run exactly once");
+    assertStringEquals("complex fixture", file_fixture, "File fixture should be visible to its tests");
+}
+
 // @Test("Test string inequality")
 void test_string_inequality() {
     assertStringNotEquals("hello", "world", "Strings should not match");
@@ -31,6 +31,14 @@ void test_extract_annotation_with_args() {
     assertStringEquals("TARGET_TEST, \"desc\"", arg, "Expected arguments to match input");
 }
 
+// @Benchmark("Extract annotation name and arguments")
+void bench_extract_annotation_name() {
+    char name[MAX_BUFFER_SIZE];
+    char arg[MAX_BUFFER_SIZE];
+    extract_annotation_name("// @Test(TARGET_TEST, \"desc\")", name, arg);
+    doNotOptimize(name[0]);
+}
+
 // @Test("Extract annotation with missing closing parenthesis")
 void test_extract_annotation_missing_paren() {
     char name[MAX_BUFFER_SIZE] = {0};
@@ -75,6 +83,7 @@ void test_extract_extension_no_base() {
     assertStringEquals("", base_arg, "Expected empty base arg");
 }
 
+// @NotThreadSafe
 // @Test("lucy_init resets state")
 void test_lucy_init() {
     const char *input = "test_input.c";
@@ -96,6 +105,7 @@ void test_lucy_init() {
     remove(output);
 }
 
+// @NotThreadSafe
 // @Test("lucy_process_file with @When")
 void test_lucy_process_file_when() {
     const char *input = "test_input.c";
@@ -123,6 +133,7 @@ void test_lucy_process_file_when() {
     remove(output);
 }
 
+// @NotThreadSafe
 // @Test("lucy_process_file with extension")
 void test_lucy_process_file_extension() {
     const char *input = "test_input.c";
@@ -152,6 +163,7 @@ void test_lucy_process_file_extension() {
     remove(output);
 }
 
+// @NotThreadSafe
 // @Test("lucy_generate_annotations_header")
 void test_lucy_generate_annotations_header() {
     const char *base = "./include/annotations.h";
@@ -169,6 +181,7 @@ void test_lucy_generate_annotations_header() {
     remove(output);
 }
 
+// @NotThreadSafe
 // @Test("lucy_generate_annotations_source")
 void test_lucy_generate_annotations_source() {
     const char *input = "test_input.c";
@@ -195,6 +208,41 @@ void test_lucy_generate_annotations_source() {
     remove(annotations_c);
 }
 
+// @NotThreadSafe
+// @Test("lucy_generate_annotations_source emits per-tag index lists")
+void test_lucy_generate_tag_index() {
+    const char *input = "test_input.c";
+    const char *output = "test_output.c";
+    const char *annotations_c = "test_annotations.c";
+    FILE *f = fopen(input, "w");
+    fprintf(f, "// @When(TARGET_TEST)\n// @Tag(\"fast\", \"db\")\nvoid tagged_func() {}\n");
+    fprintf(f, "// @When(TARGET_TEST)\nvoid plain_func() {}\n");
+    fprintf(f, "// @Tag(\"db\")\n// @When(TARGET_TEST)\nvoid db_func() {}\n");
+    fclose(f);
+
+    lucy_init();
+    lucy_process_file(input, output);
+    int result = lucy_generate_annotations_source(annotations_c);
+    assertEquals(0, result, "Source generation should succeed");
+
+    FILE *out = fopen(annotations_c, "r");
+    char buffer[4096] = {0};
+    fread(buffer, 1, sizeof(buffer) - 1, out);
+    fclose(out);
+    /* Annotations: 0 When(tagged), 1 Tag(tagged), 2 When(plain), 3 Tag(db_func), 4 When(db_func) */
+    assertTrue(strstr(buffer, "static const int __TAG_0[] = {0};") != NULL, "fast should index only tagged_func");
+    assertTrue(strstr(buffer, "static const int __TAG_1[] = {0, 4};") != NULL, "db should index both tagged functions");
+    assertTrue(strstr(buffer, "{\"fast\", __TAG_0, 1}") != NULL, "Expected fast tag entry");
+    assertTrue(strstr(buffer, "{\"db\", __TAG_1, 2}") != NULL, "Expected db tag entry");
+    assertTrue(strstr(buffer, "int __TAG_COUNT = 2;") != NULL, "Expected two distinct tags");
+    assertTrue(strstr(buffer, "\"test_input.c\"}") != NULL, "Annotations should record their input file");
+
+    remove(input);
+    remove(output);
+    remove(annotations_c);
+}
+
+// @NotThreadSafe
 // @Test("find_annotated_blocks finds runtime annotations")
 void test_find_annotated_blocks() {
     const char *input = "test_input.c";
@@ -225,6 +273,7 @@ void test_find_annotated_blocks() {
     remove(output);
 }
 
+// @NotThreadSafe
 // @Test("lucy_cleanup resets state")
 void test_lucy_cleanup() {
     const char *input = "test_input.c";
@@ -0,0 +1,22 @@
+/* Tests built into test_module.so and loaded by the runner with --module */
+#include "../include/lucy_test.h"
+#include <string.h>
+
+// Module fixture state, built once for the tests in this module
+static int module_fixture_runs = 0;
+
+// @BeforeAll("file")
+void module_before_all() {
+    module_fixture_runs++;
+}
+
+// @Test("Module tests run from a dlopen'd table")
+// @Tag("module")
+void test_module_loaded() {
+    assertEquals(1, module_fixture_runs, "Module BeforeAll should have run exactly once");
+}
+
+// @Test("Module tests share the runner's assertions")
+void test_module_assertions() {
+    assertStringEquals("module", "module", "Assertions should work inside a module");
+}
@@ -15,6 +15,7 @@ void teardown_counter() {
     teardown_count++;
 }
 
+// @NotThreadSafe
 // @Test("Test string equality")
 void test_string_equality() {
     const char *expected = "hello";
@@ -30,6 +31,7 @@ void test_arithmetic() {
     assertEquals(expected, actual, NULL);
 }
 
+// @NotThreadSafe
 // @Test("Verify setup and teardown counts")
 void test_setup_teardown_counts() {
     assertEquals(setup_count - 1, teardown_count, "Setup and teardown counts should match");